@@ -17,6 +17,11 @@ int Currency::num_parameters() const
     return 2;
 }
 
+bool Currency::isPure() const
+{
+    return false;
+}
+
 std::string to_upper(std::string s) {
     std::transform(s.begin(), s.end(), s.begin(),
         [](unsigned char c) { return std::toupper(c); });
@@ -66,6 +71,11 @@ int Stock::num_parameters() const
     return 1;
 }
 
+bool Stock::isPure() const
+{
+    return false;
+}
+
 std::string Stock::calculate(const std::vector<std::string>& args)
 {
     std::string in = prepare_literal(args[0]);
@@ -11,6 +11,8 @@ class MOREFUNCS_API Currency :
 public:
     Currency();
     virtual int num_parameters() const;
+    // Exchange rates change, so calls are never folded into constants.
+    virtual bool isPure() const;
 
     virtual std::string calculate(const std::vector<std::string>& args);
 };
@@ -22,6 +24,8 @@ class MOREFUNCS_API Stock :
 public:
     Stock();
     virtual int num_parameters() const;
+    // Stock prices change, so calls are never folded into constants.
+    virtual bool isPure() const;
 
     virtual std::string calculate(const std::vector<std::string>& args);
 };
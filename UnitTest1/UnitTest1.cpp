@@ -1,6 +1,18 @@
 #include "CppUnitTest.h"
 #include "RpnCalculator.h"
 #include "ExprToRpn.h"
+#include "RpnConstexpr.h"
+#include "RpnJit.h"
+#include "RpnSimd.h"
+#include "RpnVm.h"
+#include "../calc/BatchRunner.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <thread>
 
 
 
@@ -8,6 +20,11 @@ using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 namespace UnitTest1
 {
+    static_assert(RpnConstexpr::evaluate_integer("2 ** 3 ** 2 - 0x10 | 1 << 4") == 496, "");
+    static_assert(RpnConstexpr::evaluate("sqrt(16) + avg(1, 2, 6)") == 7, "");
+
+    RPN_CONSTEXPR_EXPRESSION(Quadratic, "a * x ** 2 + b * x + c");
+
 	TEST_CLASS(UnitTest1)
 	{
 	public:
@@ -48,6 +65,860 @@ namespace UnitTest1
             }
         }
 
+		TEST_METHOD(TestLexer)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            const FunctionShuntingYard& yard = calc.engine();
+            auto texts = [&](const std::string& expression) {
+                std::vector<std::string> result;
+                for (const RpnToken& token : yard.tokenize(expression, false))
+                    result.push_back(token.text(expression));
+                return result;
+            };
+            auto errorOf = [&](const std::string& expression) {
+                try {
+                    calc.calculate(expression);
+                }
+                catch (const std::runtime_error& e) {
+                    return std::string(e.what());
+                }
+                return std::string();
+            };
+
+            // Unary minus is merged into the literal at the start, after '(' and after an operator.
+            std::string expression = "-3 * (-2) - -1";
+            std::vector<RpnToken> tokens = yard.tokenize(expression, false);
+            Assert::AreEqual(7, static_cast<int>(tokens.size()));
+            Assert::IsTrue(tokens[0].kind == RpnToken::LITERAL);
+            Assert::AreEqual(std::string("-3"), tokens[0].text(expression));
+            Assert::AreEqual(std::string("-2"), tokens[3].text(expression));
+            Assert::IsTrue(tokens[5].kind == RpnToken::OPERATOR);
+            Assert::AreEqual(std::string("-1"), tokens[6].text(expression));
+            Assert::AreEqual(std::string("7.000000"), calc.calculate(expression));
+
+            // The longest registered operator wins: "**" is not read as two "*".
+            Assert::IsTrue(texts("2**3*2") == std::vector<std::string>({ "2", "**", "3", "*", "2" }));
+            Assert::AreEqual(std::string("16.000000"), calc.calculate("2**3*2"));
+
+            // Scientific notation, with either case and an optional exponent sign.
+            Assert::IsTrue(texts("1.5e3+2E-2") == std::vector<std::string>({ "1.5e3", "+", "2E-2" }));
+            Assert::AreEqual(std::string("1500.020000"), calc.calculate("1.5e3+2E-2"));
+
+            Assert::AreEqual(std::string("Unknown token: $"), errorOf("2 $ 3"));
+            Assert::AreEqual(std::string("Unterminated string literal"), errorOf("1 + \"abc"));
+
+            // A name followed by '(' is a function call, case insensitive; other names are variables.
+            expression = "SIN(x)";
+            tokens = yard.tokenize(expression, false);
+            Assert::IsTrue(tokens[0].kind == RpnToken::FUNCTION);
+            Assert::IsTrue(tokens[2].kind == RpnToken::VARIABLE);
+            Assert::AreEqual(std::string("0.000000"), calc.compile(expression, { "x" }).evaluate({ 0 }));
+            Assert::AreEqual(std::string("Unknown function: foo"), errorOf("foo(1)"));
+
+            // A slice of a larger buffer is tokenized in place, without reading past its length.
+            const char buffer[] = "12 + 34\"5\"";
+            tokens = yard.tokenize(buffer, 6, false);
+            Assert::AreEqual(3, static_cast<int>(tokens.size()));
+            Assert::AreEqual(std::string("3"), tokens[2].text(buffer));
+            Assert::AreEqual(3, static_cast<int>(yard.infixToRPN(buffer, 6).size()));
+            try {
+                yard.tokenize(buffer + 7, 2, false);
+                Assert::Fail();
+            }
+            catch (const std::runtime_error& e) {
+                Assert::AreEqual(std::string("Unterminated string literal"), std::string(e.what()));
+            }
+        }
+
+		TEST_METHOD(TestRegistryIds)
+		{
+            // Multiplies its parameter by a constant.
+            class Scale : public ITypedFunctionInfo
+            {
+                long double factor;
+            public:
+                Scale(long double _factor) : factor(_factor) {}
+                int num_parameters() const override { return 1; }
+                using ITypedFunctionInfo::calculate;
+                void calculate(const RpnValue* args, int /*count*/, RpnValue& result) override { result.set_float(args[0].as_float() * factor); }
+            };
+
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            const FunctionShuntingYard& yard = calc.engine();
+            const std::string expression = "1 + SIN(foo) * Sin(2)";
+            std::vector<RpnToken> tokens = yard.tokenize(expression, false);
+            const int plus = tokens[1].id, sine = tokens[2].id;
+
+            // Function names are looked up ignoring case; unknown names are variables without an ID.
+            Assert::AreEqual(static_cast<int>(RpnToken::OPERATOR), static_cast<int>(tokens[1].kind));
+            Assert::AreEqual(static_cast<int>(RpnToken::FUNCTION), static_cast<int>(tokens[2].kind));
+            Assert::AreEqual(sine, tokens[7].id);
+            Assert::AreEqual(static_cast<int>(RpnToken::VARIABLE), static_cast<int>(tokens[4].kind));
+            Assert::AreEqual(-1, tokens[4].id);
+            Assert::AreEqual(-1, yard.tokenize("1 2 foo", true)[2].id);
+            Assert::ExpectException<std::runtime_error>([&]() { calc.calculate("1 @ 2"); });
+            Assert::ExpectException<std::runtime_error>([&]() { calc.calculate("foo(1)"); });
+
+            // Later registrations get the next IDs and leave existing ones alone, also when the
+            // tables grow; re-registering a name keeps its ID.
+            CompiledExpression compiled = calc.compile("sin(a) + 1", { "a" });
+            for (int i = 0; i < 100; ++i)
+                calc.addFunction("scale" + std::to_string(i), std::unique_ptr<Scale>(new Scale(i)));
+            const int first = yard.tokenize("scale0", false)[0].id;
+            for (int i = 0; i < 100; i += 33)
+                Assert::AreEqual(first + i, yard.tokenize("scale" + std::to_string(i), false)[0].id);
+            calc.addFunction("Scale5", std::unique_ptr<Scale>(new Scale(-5)));
+            Assert::AreEqual(first + 5, yard.tokenize("scale5", false)[0].id);
+            Assert::AreEqual(std::string("-10.000000"), calc.calculate("scale5(2)"));
+
+            tokens = yard.tokenize(expression, false);
+            Assert::AreEqual(plus, tokens[1].id);
+            Assert::AreEqual(sine, tokens[2].id);
+            Assert::AreEqual(std::string("1.000000"), compiled.evaluate({ 0 }));
+            Assert::AreEqual(std::string("7.000000"), calc.calculate("1 + sin(0) + scale3(2)"));
+        }
+
+		TEST_METHOD(TestCompiledExpression)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+
+            std::vector<std::string> expressions = {
+                "25 + avg(1, 2, 3, 4, 5) + 15",
+                "sqrt(pow(3, 2) + pow(4, 2))",
+                "0x5<<1",
+            };
+            for (const std::string& expr : expressions) {
+                CompiledExpression compiled = calc.compile(expr);
+                std::string expected = calc.calculate(expr);
+                Assert::AreEqual(expected, compiled.evaluate());
+                Assert::AreEqual(expected, compiled.evaluate());
+            }
+            Assert::AreEqual(calc.calculate_rpn("1 2 3 3 avg"), calc.compile_rpn("1 2 3 3 avg").evaluate());
+        }
+
+		TEST_METHOD(TestVariables)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+
+            struct Row { long double price, qty, disc; };
+            CompiledExpression compiled = calc.compile("price * qty * (1 - disc)", { "price", "qty", "disc" });
+            Assert::AreEqual(1, compiled.slot("qty"));
+            Assert::AreEqual(std::string("28.350000"), compiled.evaluate_row(Row{ 10.5L, 3, 0.1L }));
+            Assert::AreEqual(std::string("20.000000"), compiled.evaluate({ 10, 2, 0 }));
+            Assert::ExpectException<std::runtime_error>([&]() { compiled.evaluate(); });
+        }
+
+		TEST_METHOD(TestConstantFolding)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+
+            CompiledExpression compiled = calc.compile("(2 + 3) * (x + 1) * (4 - 1)", { "x" });
+            Assert::AreEqual(7, static_cast<int>(compiled.instruction_count()));
+            Assert::AreEqual(std::string("45.000000"), compiled.evaluate({ 2 }));
+            Assert::AreEqual(1, static_cast<int>(calc.compile("avg(1, 2, 3) * sin(0)").instruction_count()));
+            // Errors found while folding are still reported on evaluation.
+            Assert::ExpectException<std::runtime_error>([&]() { calc.calculate("1 % 0"); });
+        }
+
+		TEST_METHOD(TestCommonSubexpressions)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+
+            CompiledExpression compiled = calc.compile("sqrt(a*a+b*b) + sqrt(a*a+b*b) * 2 - 1/sqrt(a*a+b*b)", { "a", "b" });
+            Assert::AreEqual(8, static_cast<int>(compiled.nodes_saved()));
+            Assert::AreEqual(std::string("14.800000"), compiled.evaluate({ 3, 4 }));
+            Assert::AreEqual(0, static_cast<int>(calc.compile("a * b + b * a", { "a", "b" }).nodes_saved()));
+        }
+
+		TEST_METHOD(TestEvaluateBatch)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+
+            const size_t rows = 1000;
+            std::vector<long double> a(rows), b(rows);
+            for (size_t i = 0; i < rows; ++i) {
+                a[i] = i * 0.5L;
+                b[i] = 1 + i % 7;
+            }
+            // hex has only the string interface, so the last expression is evaluated row by row.
+            const char* expressions[] = { "a * b - sqrt(a) / b", "avg(a, b, 3) + a % 4", "pow(a, 2) - hex(b)" };
+            for (const char* expression : expressions) {
+                CompiledExpression compiled = calc.compile(expression, { "a", "b" });
+                std::vector<long double> results = compiled.evaluate_batch({ a.data(), b.data() }, rows);
+                for (size_t i = 0; i < rows; i += 37)
+                    Assert::AreEqual(std::stod(compiled.evaluate({ a[i], b[i] })), static_cast<double>(results[i]), 1e-6);
+            }
+        }
+
+		TEST_METHOD(TestSimdKernels)
+		{
+            // Distance in ULP between two doubles of the same sign; 0 if both are NaN.
+            auto ulps = [](double a, double b) -> double {
+                if (std::isnan(a) || std::isnan(b))
+                    return std::isnan(a) && std::isnan(b) ? 0 : 1e300;
+                if (a == b)
+                    return 0;
+                if ((a < 0) != (b < 0))
+                    return 1e300;
+                long long ia, ib;
+                std::memcpy(&ia, &a, sizeof(a));
+                std::memcpy(&ib, &b, sizeof(b));
+                return std::fabs(static_cast<double>(ia - ib));
+            };
+
+            // Documented bound plus 1 ULP for the error of the C library reference.
+            const double bounds[RpnSimd::FUNCTION_COUNT] = { 3, 3, 4, 3, 3, 2, 2, 3, 3, 1, 0, 0, 0, 4, 4 };
+            const double specials[] = { 0.0, -0.0, 1, -1, 0.5, -0.5, 1e-310, 1e300, -1e300, 710, -746,
+                std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                std::numeric_limits<double>::quiet_NaN() };
+            const size_t count = 100000;
+            std::mt19937_64 random(2025);
+            std::vector<double> x(count), y(count), expected(count), actual(count);
+
+            for (int function = 0; function < RpnSimd::FUNCTION_COUNT; ++function) {
+                for (size_t i = 0; i < count; ++i) {
+                    double u = std::uniform_real_distribution<double>(-1, 1)(random);
+                    switch (function) {
+                    case RpnSimd::ASIN:
+                    case RpnSimd::ACOS:
+                        x[i] = u;
+                        break;
+                    case RpnSimd::LN:
+                    case RpnSimd::LG:
+                    case RpnSimd::SQRT:
+                        x[i] = std::exp(u * 690);
+                        break;
+                    case RpnSimd::EXPN:
+                        x[i] = u * 740;
+                        break;
+                    case RpnSimd::POW:
+                        x[i] = std::exp(u * 6);
+                        y[i] = std::uniform_real_distribution<double>(-16, 16)(random);
+                        break;
+                    case RpnSimd::LOG:
+                        x[i] = std::exp(u * 200);
+                        y[i] = std::exp(std::uniform_real_distribution<double>(-6, 6)(random));
+                        break;
+                    default:
+                        x[i] = i % 2 ? u * 1e4 : u * 4;
+                        break;
+                    }
+                }
+                for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]); ++i)
+                    x[i] = specials[i];
+
+                RpnSimd::Function f = static_cast<RpnSimd::Function>(function);
+                RpnSimd::kernel(f, RpnSimd::SCALAR)(x.data(), y.data(), count, expected.data());
+                for (int level = RpnSimd::SSE2; level <= RpnSimd::detect(); ++level) {
+                    RpnSimd::kernel(f, static_cast<RpnSimd::Level>(level))(x.data(), y.data(), count, actual.data());
+                    for (size_t i = 0; i < count; ++i)
+                        Assert::IsTrue(ulps(expected[i], actual[i]) <= bounds[function]);
+                }
+            }
+        }
+
+		TEST_METHOD(TestJit)
+		{
+            RpnCalculator interpreter, calc;
+            for (RpnCalculator* c : { &interpreter, &calc }) {
+                c->addStandardFunctions();
+                c->addStandardOperators();
+            }
+            calc.enableJit(true);
+
+            const char* expressions[] = { "a * b - sqrt(a) / b", "avg(a, b, 3) + a ** 2", "abs(a - b) * floor(a) + ceil(b)",
+                "sqrt(a*a+b*b) + sqrt(a*a+b*b) * 2 - 1/sqrt(a*a+b*b)", "sin(a) + cos(b) * tan(a / b) - log(a + 1, b)" };
+            for (const char* expression : expressions) {
+                CompiledExpression expected = interpreter.compile(expression, { "a", "b" });
+                CompiledExpression compiled = calc.compile(expression, { "a", "b" });
+                Assert::AreEqual(RpnJit::available(), compiled.jit_compiled());
+                for (int i = 0; i < 100; ++i) {
+                    long double values[] = { i * 1.25L, 2.0L + i % 7 };
+                    Assert::AreEqual(std::stod(expected.evaluate(values, 2)), std::stod(compiled.evaluate(values, 2)), 1e-5);
+                }
+            }
+            // Integer operators and string functions stay on the interpreter.
+            Assert::IsFalse(calc.compile("a % 4", { "a" }).jit_compiled());
+            Assert::IsFalse(calc.compile("hex(a)", { "a" }).jit_compiled());
+            Assert::AreEqual(std::string("3"), calc.compile("a % 4", { "a" }).evaluate({ 7 }));
+
+            // Exact integer sub-expressions feeding floating point arithmetic stay on the interpreter too.
+            interpreter.enableOptimization(false);
+            calc.enableOptimization(false);
+            const char* integral = "(2**62 + 1 - 2**62) * a";
+            CompiledExpression exact = calc.compile(integral, { "a" });
+            Assert::IsFalse(exact.jit_compiled());
+            Assert::AreEqual(std::string("1.000000"), interpreter.compile(integral, { "a" }).evaluate({ 1 }));
+            Assert::AreEqual(interpreter.compile(integral, { "a" }).evaluate({ 1 }), exact.evaluate({ 1 }));
+        }
+
+		TEST_METHOD(TestRegisterVm)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+
+            const char* expressions[] = { "25 + avg(1, 2, 3, 4, 5) + 15", "0x5<<1", "sin(g2r(90))", "abs(-5) + floor(3.7)",
+                "(a + b) * (a - b) / 3", "sqrt(a*a+b*b) + sqrt(a*a+b*b) * 2", "hex(a) + b", "avg(a, b, a * b) % 3" };
+            const long double values[] = { 7.5L, 2 };
+            for (bool optimize : { false, true }) {
+                calc.enableOptimization(optimize);
+                for (const char* expression : expressions) {
+                    CompiledExpression compiled = calc.compile(expression, { "a", "b" });
+                    const CompiledProgram& program = compiled.compiled_program();
+                    Assert::IsTrue(program.bytecode != nullptr);
+                    Assert::AreEqual(RpnVm::interpret(program, values).to_string(), RpnVm::run(program, values).to_string());
+                }
+            }
+            // Parameter counts only known at run time are left to the stack interpreter.
+            Assert::IsTrue(calc.compile_rpn("1 2 a avg", { "a" }).compiled_program().bytecode == nullptr);
+            Assert::AreEqual(std::string("1.500000"), calc.compile_rpn("1 2 a avg", { "a" }).evaluate({ 2 }));
+        }
+
+		TEST_METHOD(TestCache)
+		{
+            // Impure function counting its calls, so its results must not be cached.
+            class Counter : public ITypedFunctionInfo
+            {
+            public:
+                int num_parameters() const override { return 1; }
+                bool isPure() const override { return false; }
+                using ITypedFunctionInfo::calculate;
+                void calculate(const RpnValue* args, int /*count*/, RpnValue& result) override { result.set_integer(args[0].as_integer() + ++calls); }
+                int calls = 0;
+            };
+
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            Counter* counter = new Counter();
+            calc.addFunction("counter", std::unique_ptr<Counter>(counter));
+            calc.setCacheBudget(1 << 20);
+
+            Assert::AreEqual(std::string("3.000000"), calc.calculate("1 + 2"));
+            Assert::AreEqual(std::string("3.000000"), calc.calculate(" 1+2 "));
+            Assert::AreEqual(std::string("3.000000"), calc.calculate_rpn("1  2 +"));
+            Assert::AreEqual(std::string("11"), calc.calculate("counter(10)"));
+            Assert::AreEqual(std::string("12"), calc.calculate("counter( 10 )"));
+
+            RpnCacheStats stats = calc.cacheStats();
+            Assert::AreEqual(1, static_cast<int>(stats.resultHits));
+            Assert::AreEqual(1, static_cast<int>(stats.planHits));
+            Assert::AreEqual(0, static_cast<int>(stats.planEvictions + stats.resultEvictions));
+
+            // Shrinking the budget evicts the least recently used entries.
+            calc.setCacheBudget(stats.bytes / 2);
+            stats = calc.cacheStats();
+            Assert::IsTrue(stats.bytes <= stats.budget);
+            Assert::IsTrue(stats.planEvictions + stats.resultEvictions > 0);
+        }
+
+		TEST_METHOD(TestConcurrentCalculate)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            calc.freeze();
+            Assert::ExpectException<std::runtime_error>([&]() { calc.addStandardFunctions(); });
+
+            const int perThread = 2000;
+            auto expression = [](int i) { return "sqrt(" + std::to_string(i) + ") * avg(1, 2, " + std::to_string(i % 7) + ") + 0x5 << 1"; };
+            std::vector<std::string> expected;
+            for (int i = 0; i < perThread; ++i)
+                expected.push_back(calc.calculate(expression(i)));
+
+            // Every thread evaluates the same expressions through the shared instance.
+            unsigned threadCount = std::max(2u, std::thread::hardware_concurrency());
+            std::atomic<int> mismatches(0);
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < threadCount; ++t) {
+                threads.emplace_back([&, t]() {
+                    for (int i = 0; i < perThread; ++i) {
+                        int k = (i + static_cast<int>(t) * 97) % perThread;
+                        if (calc.calculate(expression(k)) != expected[k])
+                            ++mismatches;
+                    }
+                });
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+            Assert::AreEqual(0, mismatches.load());
+        }
+
+		TEST_METHOD(TestCalculateMany)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+
+            std::vector<std::string> inputs;
+            for (int i = 0; i < 5000; ++i) {
+                if (i % 499 == 0)
+                    inputs.push_back("1 +* 2");
+                else if (i % 1000 == 1) {
+                    // A few long expressions among short ones.
+                    std::string sum = "1";
+                    for (int k = 0; k < 500; ++k)
+                        sum += " + sin(" + std::to_string(k) + ")";
+                    inputs.push_back(sum);
+                }
+                else
+                    inputs.push_back("sqrt(" + std::to_string(i) + ") * avg(1, 2, " + std::to_string(i % 7) + ")");
+            }
+
+            for (unsigned workers : { 1u, 3u, 0u }) {
+                calc.setWorkerCount(workers);
+                std::vector<RpnBatchResult> results = calc.calculate_many(inputs);
+                Assert::AreEqual(static_cast<int>(inputs.size()), static_cast<int>(results.size()));
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    if (i % 499 == 0) {
+                        Assert::IsTrue(results[i].failed);
+                        Assert::IsFalse(results[i].error.empty());
+                    }
+                    else {
+                        Assert::IsFalse(results[i].failed);
+                        Assert::AreEqual(calc.calculate(inputs[i]), results[i].value);
+                    }
+                }
+            }
+
+            std::string rpn[] = { "2 3 +", "4 0 /x", "2 3 4 * +" };
+            RpnBatchResult rpnResults[3];
+            calc.calculate_rpn_many(rpn, 3, rpnResults);
+            Assert::AreEqual(calc.calculate_rpn(rpn[0]), rpnResults[0].value);
+            Assert::IsTrue(rpnResults[1].failed);
+            Assert::AreEqual(calc.calculate_rpn(rpn[2]), rpnResults[2].value);
+        }
+
+		TEST_METHOD(TestBatchRunner)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            calc.setWorkerCount(2);
+            calc.enableStats(true);
+
+            // More lines than one block, with blank lines and errors on both sides of the boundary.
+            const size_t lineCount = BatchRunner::BATCH_LINES + 5000;
+            std::vector<std::string> lines;
+            std::string input;
+            size_t blanks = 0;
+            size_t failures = 0;
+            for (size_t i = 0; i < lineCount; ++i) {
+                if (i % 1000 == 999) {
+                    lines.push_back(i % 2 ? "" : " \t");
+                    ++blanks;
+                }
+                else if (i % 20000 == 7 || i == BatchRunner::BATCH_LINES) {
+                    lines.push_back("1 +* 2");
+                    ++failures;
+                }
+                else
+                    lines.push_back(std::to_string(i) + " / 4");
+                input += lines.back() + (i % 3 ? "\n" : "\r\n");
+            }
+
+            FILE* in = tmpfile();
+            FILE* out = tmpfile();
+            FILE* summary = tmpfile();
+            fwrite(input.data(), 1, input.size(), in);
+            rewind(in);
+            BatchRunner runner(calc, false, out);
+            runner.runStream(in);
+            runner.finish();
+            // Blank lines are neither counted nor evaluated.
+            Assert::AreEqual(lineCount - blanks, runner.expressions);
+            Assert::AreEqual(failures, runner.errors);
+            Assert::AreEqual(static_cast<unsigned long long>(lineCount - blanks), static_cast<unsigned long long>(calc.stats().expressions));
+
+            std::string output(static_cast<size_t>(ftell(out)), '\0');
+            rewind(out);
+            Assert::AreEqual(output.size(), fread(&output[0], 1, output.size(), out));
+            size_t start = 0;
+            for (size_t i = 0; i < lineCount; ++i) {
+                size_t end = output.find('\n', start);
+                Assert::IsTrue(end != std::string::npos);
+                std::string line = output.substr(start, end - start);
+                start = end + 1;
+                if (lines[i].find_first_not_of(" \t") == std::string::npos)
+                    Assert::AreEqual(std::string(), line);
+                else if (lines[i] == "1 +* 2")
+                    Assert::AreEqual(0, static_cast<int>(line.find("Error: ")));
+                else
+                    Assert::AreEqual(calc.calculate(lines[i]), line);
+            }
+            Assert::AreEqual(output.size(), start);
+
+            runner.printSummary(summary, 2, 2.0);
+            std::string text(static_cast<size_t>(ftell(summary)), '\0');
+            rewind(summary);
+            fread(&text[0], 1, text.size(), summary);
+            std::string expected = "c: " + std::to_string(lineCount - blanks) + " expressions, " + std::to_string(failures) +
+                " errors, 2 workers, 2.000 s, " + std::to_string((lineCount - blanks) / 2) + " expressions/s, ";
+            Assert::AreEqual(expected, text.substr(0, expected.size()));
+            fclose(in);
+            fclose(out);
+            fclose(summary);
+        }
+
+		TEST_METHOD(TestNumericLiterals)
+		{
+            // Radix literals keep all 64 bits.
+            RpnValue max = RpnValue::from_literal("0x7FFFFFFFFFFFFFFF");
+            Assert::IsTrue(max.kind == RpnValue::INTEGER);
+            Assert::IsTrue(max.i == 9223372036854775807LL);
+            Assert::IsTrue(RpnValue::from_literal("0xFFFFFFFFFFFFFFFF").i == -1);
+            Assert::IsTrue(RpnValue::from_literal("0x123456789ABCDEF0").i == 0x123456789ABCDEF0LL);
+            Assert::IsTrue(RpnValue::from_literal("0o1777777777777777777777").i == -1);
+            Assert::IsTrue(RpnValue::from_literal("0b1010").i == 10);
+            Assert::IsTrue(RpnValue::from_literal("0x1b").i == 27);
+            Assert::IsTrue(RpnValue::from_literal("1Fh").i == 31);
+            Assert::IsTrue(RpnValue::from_literal("17o").i == 15);
+            Assert::IsTrue(RpnValue::from_literal("101b").i == 5);
+            Assert::IsTrue(RpnValue::from_literal("-0x10").i == -16);
+            Assert::ExpectException<std::runtime_error>([]() { RpnValue::from_literal("0x10000000000000000"); });
+
+            Assert::IsTrue(RpnValue::from_literal("9223372036854775807").kind == RpnValue::INTEGER);
+            Assert::IsTrue(RpnValue::from_literal("9223372036854775808").kind == RpnValue::FLOAT);
+            RpnValue min = RpnValue::from_literal("-9223372036854775808");
+            Assert::IsTrue(min.kind == RpnValue::INTEGER);
+            Assert::IsTrue(min.i == std::numeric_limits<long long>::min());
+            Assert::IsTrue(RpnValue::from_literal("-9223372036854775809").kind == RpnValue::FLOAT);
+            Assert::IsTrue(RpnValue::from_literal("1.").kind == RpnValue::FLOAT);
+            Assert::IsTrue(RpnValue::from_literal(".5").f == 0.5L);
+            Assert::IsTrue(RpnValue::from_literal("1.5E+3").f == 1500.0L);
+            Assert::IsTrue(RpnValue::from_literal("0.1").f == std::strtold("0.1", nullptr));
+            Assert::IsTrue(RpnValue::from_literal("123456789.123456789e-7").f == std::strtold("123456789.123456789e-7", nullptr));
+            Assert::ExpectException<std::runtime_error>([]() { RpnValue::from_literal("1e"); });
+
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            Assert::AreEqual(std::string("7"), calc.calculate("0b101 | 0o7"));
+            Assert::AreEqual(std::string("15"), calc.calculate("0xFF & 0x0F | 0b1010 ^ 0o17"));
+        }
+
+		TEST_METHOD(TestIntegerArithmetic)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            // By default, results of +, -, * and ** print as floating point values did
+            // before they were kept exact, but with exact digits.
+            Assert::AreEqual(std::string("3.000000"), calc.calculate("1 + 2"));
+            Assert::AreEqual(std::string("1024.000000"), calc.calculate("2 ** 10"));
+            Assert::AreEqual(std::string("1311768467463790321.000000"), calc.calculate("0x123456789ABCDEF0 + 1"));
+            Assert::AreEqual(std::string("3"), calc.calculate("(1 + 2) & 7"));
+            calc.setResultFormat(RpnFormat::Scientific(2));
+            Assert::AreEqual(std::string("1.02e+03"), calc.calculate("2 ** 10"));
+            calc.setResultFormat(RpnFormat::Shortest());
+            Assert::AreEqual(std::string("3"), calc.calculate("1 + 2"));
+
+            // 64-bit values stay exact through +, -, *, ** and the bitwise operators.
+            calc.setResultFormat(RpnFormat().withExactIntegers());
+            Assert::AreEqual(std::string("1311768467463790321"), calc.calculate("0x123456789ABCDEF0 + 1"));
+            Assert::AreEqual(std::string("1311768467463790320"), calc.calculate("(0x123456789ABCDEF1 | 0xF) & 0xFFFFFFFFFFFFFFF0"));
+            Assert::AreEqual(std::string("-9223372036854775808"), calc.calculate("0x7FFFFFFFFFFFFFFF ^ -1"));
+            Assert::AreEqual(std::string("4611686018427387904"), calc.calculate("2 ** 62"));
+            Assert::AreEqual(std::string("9223372036854775806"), calc.calculate("4611686018427387903 * 2"));
+            Assert::AreEqual(std::string("0.500000"), calc.calculate("2 ** -1"));
+            Assert::AreEqual(std::string("3.500000"), calc.calculate("7 / 2"));
+            // Overflow falls back to floating point.
+            Assert::AreEqual(std::string("9223372036854775808.000000"), calc.calculate("9223372036854775807 + 1"));
+            Assert::AreEqual(std::string("18446744073709551616.000000"), calc.calculate("2 ** 64"));
+            // Shifts and modulo are defined for all counts and operands.
+            Assert::AreEqual(std::string("0"), calc.calculate("1 << 64"));
+            Assert::AreEqual(std::string("-1"), calc.calculate("-8 >> 70"));
+            Assert::AreEqual(std::string("-4"), calc.calculate("-8 >> 1"));
+            Assert::AreEqual(std::string("4"), calc.calculate("1 >> -2"));
+            Assert::AreEqual(std::string("0"), calc.calculate("0x8000000000000000 % -1"));
+            // hex, oct and bin format the 64-bit pattern.
+            Assert::AreEqual(std::string("ffffffffffffffff"), calc.calculate("hex(-1)"));
+            Assert::AreEqual(std::string("7fffffffffffffff"), calc.calculate("hex(0x7FFFFFFFFFFFFFFF)"));
+            Assert::AreEqual(std::string("1777777777777777777777"), calc.calculate("oct(0xFFFFFFFFFFFFFFFF)"));
+            Assert::AreEqual(std::string("0"), calc.calculate("hex(0)"));
+            std::string bits = calc.calculate("bin(13)");
+            Assert::AreEqual(64, static_cast<int>(bits.size()));
+            Assert::AreEqual(std::string("1101"), bits.substr(60));
+
+            // The register VM and the interpreter agree; native code is not used for integers.
+            calc.enableJit(true);
+            calc.enableOptimization(false);
+            Assert::AreEqual(std::string("1311768467463790321"), calc.calculate("0x123456789ABCDEF0 + 1"));
+            Assert::AreEqual(std::string("6.000000"), calc.compile("a * 2 - b", { "a", "b" }).evaluate({ 4, 2 }));
+        }
+
+		TEST_METHOD(TestOperatorDispatch)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            calc.setResultFormat(RpnFormat().withExactIntegers());
+
+            // Each built-in operator on integer and floating point operands gives the results
+            // it gave before operators were dispatched by opcode.
+            const char* cases[][2] = {
+                { "7 | 2", "7" }, { "7.5 | 2", "7" }, { "-7 | 2.5", "-5" },
+                { "7 ^ 2", "5" }, { "7.5 ^ 2", "5" }, { "-7 ^ 2.5", "-5" },
+                { "7 & 2", "2" }, { "7.5 & 2", "2" }, { "-7 & 2.5", "0" },
+                { "7 << 2", "28" }, { "7.5 << 2", "28" }, { "-7 << 2.5", "-28" },
+                { "7 >> 2", "1" }, { "7.5 >> 2", "1" }, { "-7 >> 2.5", "-2" },
+                { "7 + 2", "9" }, { "7.5 + 2", "9.500000" }, { "-7 + 2.5", "-4.500000" },
+                { "7 - 2", "5" }, { "7.5 - 2", "5.500000" }, { "-7 - 2.5", "-9.500000" },
+                { "7 * 2", "14" }, { "7.5 * 2", "15.000000" }, { "-7 * 2.5", "-17.500000" },
+                { "7 / 2", "3.500000" }, { "7.5 / 2", "3.750000" }, { "-7 / 2.5", "-2.800000" },
+                { "7 % 2", "1" }, { "7.5 % 2", "1" }, { "-7 % 2.5", "-1" },
+                { "7 ** 2", "49" }, { "7.5 ** 2", "56.250000" }, { "2 ** -1", "0.500000" },
+            };
+            for (auto& c : cases)
+                Assert::AreEqual(std::string(c[1]), calc.calculate(c[0]));
+            Assert::ExpectException<std::runtime_error>([&]() { calc.calculate("7 % 0"); });
+            Assert::ExpectException<std::runtime_error>([&]() { calc.calculate("7.5 % 0.0"); });
+
+            // The register VM, the stack interpreter and the block kernels agree.
+            const char* symbols[] = { "|", "^", "&", "<<", ">>", "+", "-", "*", "/", "%", "**" };
+            std::vector<long double> a = { 7, 7.5L, 0.5L }, b = { 2, 2, -2.5L };
+            for (const char* symbol : symbols) {
+                CompiledExpression compiled = calc.compile(std::string("a ") + symbol + " b", { "a", "b" });
+                std::vector<long double> results = compiled.evaluate_batch({ a.data(), b.data() }, a.size());
+                for (size_t i = 0; i < a.size(); ++i) {
+                    const long double values[] = { a[i], b[i] };
+                    const CompiledProgram& program = compiled.compiled_program();
+                    Assert::AreEqual(RpnVm::interpret(program, values).to_string(), RpnVm::run(program, values).to_string());
+                    Assert::AreEqual(std::stod(compiled.evaluate(values, 2)), static_cast<double>(results[i]), 1e-6);
+                }
+            }
+            Assert::ExpectException<std::runtime_error>([&]() { calc.compile("a % b", { "a", "b" }).evaluate({ 7, 0 }); });
+
+            // An operator registered over a built-in symbol is called through its own calculate
+            // everywhere, including native code.
+            class Concatenate : public ITypedOperatorInfo
+            {
+            public:
+                int precedence() override { return 5; }
+                bool isRightAssociative() override { return false; }
+                int num_parameters() override { return 2; }
+                using ITypedOperatorInfo::calculate;
+                void calculate(const RpnValue* args, RpnValue& result) override { result.set_float(args[0].as_float() * 10 + args[1].as_float()); }
+            };
+            RpnCalculator custom;
+            custom.addStandardFunctions();
+            custom.addStandardOperators();
+            custom.addOperator("+", std::unique_ptr<Concatenate>(new Concatenate()));
+            custom.enableJit(true);
+            Assert::AreEqual(std::string("12.000000"), custom.calculate("1 + 2"));
+            Assert::AreEqual(std::string("61.000000"), custom.calculate("2 * 3 + 1"));
+            CompiledExpression compiled = custom.compile("a + b", { "a", "b" });
+            Assert::IsFalse(compiled.jit_compiled());
+            Assert::AreEqual(std::string("12.000000"), compiled.evaluate({ 1, 2 }));
+            Assert::AreEqual(std::string("12.000000"), RpnVm::run(compiled.compiled_program(), std::vector<long double>{ 1, 2 }.data()).to_string());
+            std::vector<long double> ones(3, 1), twos(3, 2);
+            Assert::AreEqual(12.0, static_cast<double>(compiled.evaluate_batch({ ones.data(), twos.data() }, 3)[2]));
+        }
+
+		TEST_METHOD(TestReregistration)
+		{
+            // Subtraction, or negation with one parameter, with configurable parser properties.
+            class Difference : public ITypedOperatorInfo
+            {
+                int level;
+                bool right;
+                int parameters;
+            public:
+                Difference(int _level, bool _right, int _parameters) : level(_level), right(_right), parameters(_parameters) {}
+                int precedence() override { return level; }
+                bool isRightAssociative() override { return right; }
+                int num_parameters() override { return parameters; }
+                using ITypedOperatorInfo::calculate;
+                void calculate(const RpnValue* args, RpnValue& result) override
+                {
+                    result.set_float(parameters == 1 ? -args[0].as_float() : args[0].as_float() - args[1].as_float());
+                }
+            };
+            // Sum of its parameters.
+            class Sum : public ITypedFunctionInfo
+            {
+                int parameters;
+            public:
+                Sum(int _parameters) : parameters(_parameters) {}
+                int num_parameters() const override { return parameters; }
+                using ITypedFunctionInfo::calculate;
+                void calculate(const RpnValue* args, int count, RpnValue& result) override
+                {
+                    long double sum = 0;
+                    for (int i = 0; i < count; ++i)
+                        sum += args[i].as_float();
+                    result.set_float(sum);
+                }
+            };
+
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            const FunctionShuntingYard& yard = calc.engine();
+            auto rpnOf = [&](const std::string& expression) {
+                std::string result;
+                for (const RpnToken& token : yard.infixToRPN(expression))
+                    result += (result.empty() ? "" : " ") + token.text(expression);
+                return result;
+            };
+
+            // Precedence and associativity are read again when an operator is re-registered.
+            calc.addOperator("#", std::unique_ptr<Difference>(new Difference(1, false, 2)));
+            Assert::AreEqual(std::string("1 2 3 * #"), rpnOf("1 # 2 * 3"));
+            Assert::AreEqual(std::string("5.000000"), calc.calculate("8 # 2 # 1"));
+            calc.addOperator("#", std::unique_ptr<Difference>(new Difference(7, true, 2)));
+            Assert::AreEqual(std::string("1 2 # 3 *"), rpnOf("1 # 2 * 3"));
+            Assert::AreEqual(std::string("7.000000"), calc.calculate("8 # 2 # 1"));
+
+            // So is the number of parameters.
+            Assert::ExpectException<std::runtime_error>([&]() { calc.calculate_rpn("5 #"); });
+            calc.addOperator("#", std::unique_ptr<Difference>(new Difference(7, true, 1)));
+            Assert::AreEqual(std::string("-5.000000"), calc.calculate_rpn("5 #"));
+
+            // And the parameter count of a function, which decides whether calls pass their count.
+            calc.addFunction("total", std::unique_ptr<Sum>(new Sum(1)));
+            Assert::AreEqual(std::string("1 2 3 total"), rpnOf("total(1, 2, 3)"));
+            Assert::AreEqual(std::string("4.000000"), calc.calculate("total(4)"));
+            calc.addFunction("TOTAL", std::unique_ptr<Sum>(new Sum(-1)));
+            Assert::AreEqual(std::string("1 2 3 3 total"), rpnOf("total(1, 2, 3)"));
+            Assert::AreEqual(std::string("6.000000"), calc.calculate("total(1, 2, 3)"));
+        }
+
+		TEST_METHOD(TestResultFormat)
+		{
+            Assert::AreEqual(std::string("0.000000"), RpnFormat().format(1e-9L));
+            Assert::AreEqual(std::string("1e-9"), RpnFormat::Shortest().format(1e-9L));
+            Assert::AreEqual(std::string("0.1"), RpnFormat::Shortest().format(0.1));
+            Assert::AreEqual(std::string("42"), RpnFormat::Shortest().format(42.0L));
+            Assert::AreEqual(std::string("1.5e+21"), RpnFormat::Shortest().format(1.5e21));
+            Assert::AreEqual(std::string("-0.000123"), RpnFormat::Shortest().format(-0.000123));
+            Assert::AreEqual(std::string("3.14"), RpnFormat::Fixed(2).format(3.14159L));
+            Assert::AreEqual(std::string("2"), RpnFormat::Fixed(0).format(2.5L));
+            Assert::AreEqual(std::string("1.250e+02"), RpnFormat::Scientific(3).format(125.0L));
+            Assert::AreEqual(std::string("inf"), RpnFormat::Shortest().format(std::numeric_limits<long double>::infinity()));
+
+            // Fixed 6 is the output of std::to_string; shortest reads back to the same double.
+            std::mt19937_64 random(7);
+            for (int i = 0; i < 10000; ++i) {
+                long double value = std::ldexp(static_cast<long double>(random() >> 11), static_cast<int>(random() % 120) - 90);
+                Assert::AreEqual(std::to_string(value), RpnFormat().format(value));
+                double d = static_cast<double>(value);
+                Assert::IsTrue(std::strtod(RpnFormat::Shortest().format(d).c_str(), nullptr) == d);
+            }
+
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            Assert::AreEqual(std::string("0.333333"), calc.calculate("1/3"));
+            calc.setResultFormat(RpnFormat::Shortest());
+            Assert::AreEqual(std::string("0.3333333333333333"), calc.calculate("1/3"));
+            Assert::AreEqual(std::string("2"), calc.calculate("5 % 3"));
+            std::vector<RpnBatchResult> results = calc.calculate_many(std::vector<std::string>{ "1/4", "2e-9*1" });
+            Assert::AreEqual(std::string("0.25"), results[0].value);
+            Assert::AreEqual(std::string("2e-9"), results[1].value);
+            calc.setResultFormat(RpnFormat::Scientific(2));
+            Assert::AreEqual(std::string("3.33e-01"), calc.calculate_rpn("1 3 /"));
+            calc.freeze();
+            Assert::ExpectException<std::runtime_error>([&]() { calc.setResultFormat(RpnFormat()); });
+        }
+
+		TEST_METHOD(TestConstexpr)
+		{
+            static_assert(Quadratic::program().variableCount == 4 && Quadratic::program().slot("x") == 1, "");
+            Assert::AreEqual(6.0, static_cast<double>(RpnConstexpr::Evaluator<Quadratic>::evaluate(1, 2, 3, -4)));
+            const long double values[] = { 2, 0.5, -1, 0 };
+            Assert::AreEqual(0.0, static_cast<double>(RpnConstexpr::Evaluator<Quadratic>::evaluate(values)));
+            Assert::AreEqual(0.0, static_cast<double>(Quadratic::program().evaluate(values).as_float()));
+
+            // Same results as the runtime parser, to within the precision of the math functions.
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            calc.setResultFormat(RpnFormat::Shortest());
+            std::vector<std::string> expressions = {
+                "25 + avg(1, 2, 3, 4, 5) + 15", "-1+2+3", "-1E+3+21 - 1", "2 ** -2 ** 2", "7 - 3 - 2",
+                "9223372036854775807 + 1", "-9223372036854775808 + 1", "0FFh ^ 0b1010 & 7 << 2 >> 1", "-7 % 3 * 10 / 4", "[1 + {2 * (3 - 4)}]",
+                "sin(1) + cos(2) * tan(0.5)", "asin(0.3) - acos(0.3) + atan(-7)", "ln(10) + lg(2) + expn(3.5)",
+                "sqrt(2) + abs(-1.5) + floor(-2.5) + ceil(2.5)", "g2r(45) + r2g(1) + c2f(37) + f2c(100)",
+                "log(1000, 10) + pow(2, 0.5) + pow(3, -4)", "sin(1e12) + cos(-3 ** 30)", "1 / 0", "(-8) ** 0.5",
+            };
+            for (const std::string& expression : expressions) {
+                RpnConstexpr::Value value = RpnConstexpr::compile<128>(expression.c_str(), expression.size()).evaluate();
+                std::string expected = calc.calculate(expression);
+                if (value.integral)
+                    Assert::AreEqual(expected, std::to_string(value.i));
+                else if (!std::isfinite(value.f))
+                    Assert::AreEqual(expected, RpnFormat::Shortest().format(value.f));
+                else
+                    Assert::AreEqual(std::strtod(expected.c_str(), nullptr), static_cast<double>(value.f), 1e-15 * std::fabs(static_cast<double>(value.f)));
+            }
+
+            for (const char* invalid : { "1 +", "(1", "[1)", "sin()", "foo(1)", "1 2", "\"s\"", "5 % 0" })
+                Assert::ExpectException<std::runtime_error>([&]() { RpnConstexpr::compile<16>(invalid, std::strlen(invalid)).evaluate(); });
+            Assert::ExpectException<std::runtime_error>([]() { Quadratic::program().evaluate(); });
+        }
+
+		TEST_METHOD(TestStats)
+		{
+            RpnCalculator calc;
+            calc.addStandardFunctions();
+            calc.addStandardOperators();
+            // Without constant folding every operator and function runs when evaluated.
+            calc.enableOptimization(false);
+
+            calc.calculate("1 + 2");
+            Assert::AreEqual(0, static_cast<int>(calc.stats().expressions));
+
+            calc.enableStats(true);
+            Assert::AreEqual(std::string("3.000000"), calc.calculate("1 + 2"));
+            Assert::AreEqual(std::string("5.000000"), calc.calculate_rpn("2 3 +"));
+            Assert::AreEqual(std::string("0.841471"), calc.calculate("sin(avg(0, 1, 2)) * 1"));
+            Assert::ExpectException<std::runtime_error>([&]() { calc.calculate("1 +* 2"); });
+
+            RpnStats stats = calc.stats();
+            Assert::AreEqual(4, static_cast<int>(stats.expressions));
+            Assert::AreEqual(1, static_cast<int>(stats.errors));
+            // 3 + 3 + 13 tokens, and the 4 of the failed expression.
+            Assert::AreEqual(23, static_cast<int>(stats.tokens));
+            Assert::AreEqual(3, static_cast<int>(stats.operatorsApplied));
+            Assert::AreEqual(2, static_cast<int>(stats.functionCalls));
+            Assert::IsTrue(stats.totalNanoseconds >= stats.tokenizeNanoseconds + stats.parseNanoseconds + stats.compileNanoseconds + stats.evaluateNanoseconds);
+            Assert::IsTrue(stats.maxNanoseconds > 0 && stats.percentile(1.0) > stats.maxNanoseconds);
+
+            // Counters are shared by the workers of calculate_many.
+            calc.resetStats();
+            calc.setWorkerCount(4);
+            std::vector<std::string> inputs(1000, "sqrt(4) + 1");
+            calc.calculate_many(inputs);
+            stats = calc.stats();
+            Assert::AreEqual(1000, static_cast<int>(stats.expressions));
+            Assert::AreEqual(6000, static_cast<int>(stats.tokens));
+            Assert::AreEqual(1000, static_cast<int>(stats.functionCalls));
+            uint64_t histogram = 0;
+            for (uint64_t count : stats.latency)
+                histogram += count;
+            Assert::AreEqual(1000, static_cast<int>(histogram));
+
+            calc.enableStats(false);
+            calc.calculate("1 + 2");
+            Assert::AreEqual(1000, static_cast<int>(calc.stats().expressions));
+        }
+
 		//TEST_METHOD(TestMethod2)
 		//{
 		//	RpnCalculator calculator;
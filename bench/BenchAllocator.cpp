@@ -0,0 +1,173 @@
+// BenchAllocator.cpp : Replacement of the global operator new and delete for bench.
+//
+// Every form is replaced: single and array, nothrow, sized and, where the compiler has them,
+// aligned. All of them go through allocate and release, so each allocation is counted once,
+// whichever form made it, and goes back to free. The operators live in their own translation
+// unit so that they are not inlined into the benchmarks, where GCC 12 would report the free
+// of a pointer returned by operator new as a mismatch (-Wmismatched-new-delete).
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include "BenchAllocator.h"
+
+namespace
+{
+    std::atomic<size_t> allocations(0);
+
+    void* allocate(size_t size) noexcept
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size ? size : 1);
+    }
+
+    void release(void* p) noexcept
+    {
+        std::free(p);
+    }
+
+    void* allocateOrThrow(size_t size)
+    {
+        if (void* p = allocate(size))
+            return p;
+        throw std::bad_alloc();
+    }
+
+#ifdef __cpp_aligned_new
+    // Aligned blocks come from malloc as well: the block is over-allocated and the pointer
+    // malloc returned is kept right in front of the aligned address.
+    void* allocateAligned(size_t size, std::align_val_t alignment) noexcept
+    {
+        size_t align = static_cast<size_t>(alignment) < sizeof(void*) ? sizeof(void*) : static_cast<size_t>(alignment);
+        if (size > SIZE_MAX - align - sizeof(void*))
+            return nullptr;
+        void* block = allocate(size + align + sizeof(void*));
+        if (!block)
+            return nullptr;
+        uintptr_t address = (reinterpret_cast<uintptr_t>(block) + sizeof(void*) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+        reinterpret_cast<void**>(address)[-1] = block;
+        return reinterpret_cast<void*>(address);
+    }
+
+    void* allocateAlignedOrThrow(size_t size, std::align_val_t alignment)
+    {
+        if (void* p = allocateAligned(size, alignment))
+            return p;
+        throw std::bad_alloc();
+    }
+
+    void releaseAligned(void* p) noexcept
+    {
+        if (p)
+            release(static_cast<void**>(p)[-1]);
+    }
+#endif
+}
+
+size_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void* operator new[](size_t size)
+{
+    return allocateOrThrow(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    release(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    release(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+    release(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+    release(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    release(p);
+}
+
+#ifdef __cpp_aligned_new
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return allocateAlignedOrThrow(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return allocateAlignedOrThrow(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    releaseAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    releaseAligned(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    releaseAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    releaseAligned(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+    releaseAligned(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+    releaseAligned(p);
+}
+#endif
@@ -0,0 +1,8 @@
+#pragma once
+// BenchAllocator.h : Allocation counter of the benchmarks.
+
+#include <cstddef>
+
+// Returns the number of calls of operator new, of any form, made so far by the process.
+// BenchAllocator.cpp replaces the global operator new and delete to count them.
+size_t allocationCount();
@@ -0,0 +1,707 @@
+// bench.cpp : Throughput benchmarks for the rpn library.
+//
+// The rpn sources are compiled directly into this executable so internal classes
+// such as FunctionShuntingYard can be measured without going through the DLL interface.
+// Without Visual Studio, e.g. on Linux, build it from the repository root with
+//
+//   g++ -std=c++14 -O2 -pthread -Irpn/include rpn/src/*.cpp bench/*.cpp -o rpn_bench
+//
+// "rpn_bench" prints a readable report. "rpn_bench --phases" times tokenize, infixToRPN,
+// evaluateRPN and calculate separately over several corpora and prints one JSON object
+// per line, for tracking regressions:
+//
+//   {"phase":"tokenize","corpus":"short","expressions":8,"ns_per_op":310.2,"allocs_per_op":1.00,"ops_per_s":3223726,"mb_per_s":51.3}
+//
+// An op is one expression of the corpus; allocations are calls of operator new, counted by
+// BenchAllocator.cpp.
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BenchAllocator.h"
+#include "ExprToRpn.h"
+#include "Numeric.h"
+#include "RpnFormat.h"
+#include "RpnCalculator.h"
+#include "RpnConstexpr.h"
+#include "RpnSimd.h"
+#include "RpnVm.h"
+
+RPN_CONSTEXPR_EXPRESSION(ArithmeticExpression, "(a + b) * (a - b) / (a * b + 1) - b / (a + 2) * (a - 1) + a * a * b - (b - a) / 3");
+
+namespace
+{
+    // Keeps the optimizer from discarding benchmarked work.
+    volatile size_t sink = 0;
+
+    const std::vector<std::string> corpus = {
+        "25 + avg(1, 2, 3, 4, 5) + 15",
+        "-1+2+3",
+        "-1E+3+21 - 1",
+        "1+1*[3*(2+3*{1+3})]",
+        "0x5<<1",
+        "sin(3.14159 / 2)",
+        "sin(g2r(90))",
+        "cos(0) + sin(1.5708)",
+        "sqrt(pow(3, 2) + pow(4, 2))",
+        "ln(expn(1))",
+        "abs(-5) + floor(3.7)",
+        "pow(2, 3) + sqrt(16)",
+        "3 + sin(0) * 2",
+        "0xFF & 0x0F | 0b1010 ^ 0o17",
+        "(1.5 + 2.25) * (3.125 - 4.0625) / (5.03125 + 6.015625)",
+    };
+
+    // Repeats fn until at least minSeconds have elapsed and returns seconds per call.
+    template <class Fn>
+    double measure(Fn fn, double minSeconds = 0.5)
+    {
+        typedef std::chrono::steady_clock clock;
+        size_t iterations = 0;
+        size_t batch = 1;
+        clock::time_point start = clock::now();
+        double elapsed = 0;
+        while (elapsed < minSeconds)
+        {
+            for (size_t i = 0; i < batch; ++i)
+                fn();
+            iterations += batch;
+            batch *= 2;
+            elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        }
+        return elapsed / iterations;
+    }
+
+    void printRate(const char* name, double rate, const char* unit)
+    {
+        std::cout << std::left << std::setw(20) << name
+            << std::right << std::setw(14) << std::fixed << std::setprecision(0)
+            << rate << " " << unit << std::endl;
+    }
+
+    void benchTokenize()
+    {
+        FunctionShuntingYard yard;
+        // Register the standard operators so that multi-character symbols are lexed as in production.
+        const char* ops[] = { "+", "-", "*", "**", "/", "%", "|", "&", "^", ">>", "<<" };
+        for (const char* op : ops)
+            yard.add_operator(op, operator_ptr_t());
+
+        std::vector<std::string> accepted;
+        size_t tokensPerPass = 0;
+        for (const std::string& expr : corpus)
+        {
+            try
+            {
+                tokensPerPass += yard.tokenize(expr, false).size();
+                accepted.push_back(expr);
+            }
+            catch (const std::exception&)
+            {
+            }
+        }
+
+        double seconds = measure([&]() {
+            for (const std::string& expr : accepted)
+                sink += yard.tokenize(expr, false).size();
+        });
+        printRate("tokenize", tokensPerPass / seconds, "tokens/s");
+    }
+
+    // Operator with fixed parser properties, for benchmarks of the parser alone.
+    class ChainOperator : public IOperatorInfo
+    {
+        int m_precedence;
+        bool m_rightAssociative;
+
+    public:
+        ChainOperator(int precedence, bool rightAssociative) : m_precedence(precedence), m_rightAssociative(rightAssociative)
+        {
+        }
+        int precedence() override { return m_precedence; }
+        bool isRightAssociative() override { return m_rightAssociative; }
+        int num_parameters() override { return 2; }
+        std::string calculate(const std::vector<std::string>& args) override { return args[0]; }
+    };
+
+    // infixToRPN over long chains of operators of mixed precedence, which keep the
+    // operator-popping loop of the shunting-yard algorithm busy.
+    void benchParse()
+    {
+        FunctionShuntingYard yard;
+        const char* symbols[] = { "|", "^", "&", "<<", ">>", "+", "-", "*", "/", "%", "**" };
+        const int precedences[] = { 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 7 };
+        for (int i = 0; i < 11; ++i)
+            yard.add_operator(symbols[i], operator_ptr_t(new ChainOperator(precedences[i], i == 10)));
+
+        std::string expression = "1";
+        unsigned long long state = 1;
+        while (expression.size() < (1 << 20))
+        {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            expression += ' ';
+            expression += symbols[(state >> 33) % 11];
+            expression += (state >> 40) % 8 == 0 ? " (2 * 3 - 4)" : " 7";
+        }
+        size_t tokens = yard.tokenize(expression, false).size();
+
+        // infixToRPN includes tokenize; the difference between the two is the shunting-yard loop.
+        double lexing = measure([&]() {
+            sink += yard.tokenize(expression, false).size();
+        }, 1.0);
+        double seconds = measure([&]() {
+            sink += yard.infixToRPN(expression).size();
+        }, 1.0);
+        printRate("tokenize chain", tokens / lexing, "tokens/s");
+        printRate("infixToRPN chain", tokens / seconds, "tokens/s");
+        printRate("infixToRPN chain", expression.size() / seconds / (1 << 20), "MB/s");
+    }
+
+    // Expressions of one kind for the phase benchmarks, in infix and RPN form.
+    struct PhaseCorpus
+    {
+        std::string name;
+        std::vector<std::string> infix;
+        std::vector<std::string> rpn;
+    };
+
+    // RPN text of an infix expression, as accepted by evaluateRPN.
+    std::string toRpn(const FunctionShuntingYard& yard, const std::string& infix)
+    {
+        std::string rpn;
+        for (const RpnToken& token : yard.infixToRPN(infix))
+        {
+            std::string text = token.text(infix);
+            // A merged unary minus may be separated from its number in infix.
+            if (token.kind == RpnToken::LITERAL)
+                text.erase(std::remove(text.begin(), text.end(), ' '), text.end());
+            rpn += rpn.empty() ? "" : " ";
+            rpn += text;
+        }
+        return rpn;
+    }
+
+    std::vector<PhaseCorpus> phaseCorpora(const RpnCalculator& calc)
+    {
+        std::vector<PhaseCorpus> corpora(5);
+        corpora[0].name = "short";
+        corpora[0].infix = {
+            "1 + 2 * 3", "(4 - 1) / 3 + 2 ** 3", "17 % 5 * 3 - 2", "0xFF & 0x0F | 3 << 2",
+            "-1.5 + 2.25 * 4", "10 / 4 - 7 % 3", "2 ** 10 - 1000", "(1 + 2) * (3 + 4)",
+        };
+
+        corpora[1].name = "nesting";
+        const char* opening = "([{";
+        const char* closing = ")]}";
+        const char* ops[] = { " + ", " * ", " - ", " / " };
+        for (int depth : { 8, 16, 32, 64 })
+        {
+            std::string expression = "1";
+            for (int i = 0; i < depth; ++i)
+                expression = opening[i % 3] + expression + ops[i % 4] + std::to_string(i % 9 + 1) + closing[i % 3];
+            corpora[1].infix.push_back(expression);
+        }
+
+        corpora[2].name = "functions";
+        corpora[2].infix = {
+            "sin(0.5) + cos(0.25) * sqrt(2) - ln(3) / abs(-4) + floor(2.5) + ceil(1.2)",
+            "atan(1) + expn(0.1) - lg(100) * tan(0.3) + asin(0.5) - acos(0.5)",
+            "sqrt(pow(3, 2) + pow(4, 2)) + log(8, 2) + r2g(g2r(45))",
+            "c2f(f2c(212)) + sin(cos(sin(cos(1)))) + sqrt(sqrt(sqrt(256)))",
+        };
+
+        corpora[3].name = "avg";
+        std::string wide = "avg(1";
+        for (int i = 2; i <= 32; ++i)
+            wide += ", " + std::to_string(i);
+        corpora[3].infix = {
+            "avg(1, 2, 3, 4, 5, 6, 7, 8)",
+            "avg(avg(1, 2), avg(3, 4, 5), avg(6, 7, 8, 9))",
+            "avg(1.5, 2.5) * avg(10, 20, 30) + avg(5)",
+            wide + ")",
+        };
+
+        corpora[4].name = "long";
+        std::string expression = "1";
+        for (size_t i = 0; expression.size() < (64 << 10); ++i)
+        {
+            switch (i % 6)
+            {
+            case 0: expression += " + 2.5 * " + std::to_string(i % 97); break;
+            case 1: expression += " - sin(0." + std::to_string(i % 10) + ")"; break;
+            case 2: expression += " + (3 - " + std::to_string(i % 13) + ") / 7"; break;
+            case 3: expression += " * 1"; break;
+            case 4: expression += " + avg(1, 2, " + std::to_string(i % 5) + ")"; break;
+            case 5: expression += " - 0x1F % 5"; break;
+            }
+        }
+        corpora[4].infix.push_back(expression);
+
+        for (PhaseCorpus& corpus : corpora)
+            for (const std::string& infix : corpus.infix)
+            {
+                corpus.rpn.push_back(toRpn(calc.engine(), infix));
+                if (calc.engine().evaluateRPN(corpus.rpn.back()) != calc.calculate(infix))
+                    throw std::runtime_error("RPN form differs: " + corpus.rpn.back());
+            }
+        return corpora;
+    }
+
+    // Times fn, one pass over inputs, and prints the JSON line of the phase.
+    template <class Fn>
+    void printPhase(const char* phase, const PhaseCorpus& corpus, const std::vector<std::string>& inputs, Fn fn)
+    {
+        size_t bytes = 0;
+        for (const std::string& input : inputs)
+            bytes += input.size();
+        auto pass = [&]() {
+            for (const std::string& input : inputs)
+                fn(input);
+        };
+
+        double seconds = measure(pass, 0.3);
+        size_t before = allocationCount();
+        pass();
+        double allocationsPerPass = static_cast<double>(allocationCount() - before);
+
+        double count = static_cast<double>(inputs.size());
+        char line[512];
+        snprintf(line, sizeof(line),
+            "{\"phase\":\"%s\",\"corpus\":\"%s\",\"expressions\":%zu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"ops_per_s\":%.0f,\"mb_per_s\":%.1f}",
+            phase, corpus.name.c_str(), inputs.size(), seconds * 1e9 / count, allocationsPerPass / count,
+            count / seconds, bytes / seconds / (1 << 20));
+        std::cout << line << std::endl;
+    }
+
+    // The phases of calculate one by one: tokenize, infixToRPN (which includes tokenize),
+    // evaluateRPN of the equivalent RPN text, and calculate end to end without the cache,
+    // with statistics off and on.
+    void benchPhases()
+    {
+        RpnCalculator calc;
+        calc.addStandardFunctions();
+        calc.addStandardOperators();
+        const FunctionShuntingYard& yard = calc.engine();
+        RpnCalculator measured;
+        measured.addStandardFunctions();
+        measured.addStandardOperators();
+        measured.enableStats(true);
+
+        for (const PhaseCorpus& corpus : phaseCorpora(calc))
+        {
+            printPhase("tokenize", corpus, corpus.infix, [&](const std::string& input) {
+                sink += yard.tokenize(input, false).size();
+            });
+            printPhase("infixToRPN", corpus, corpus.infix, [&](const std::string& input) {
+                sink += yard.infixToRPN(input).size();
+            });
+            printPhase("evaluateRPN", corpus, corpus.rpn, [&](const std::string& input) {
+                sink += yard.evaluateRPN(input).size();
+            });
+            printPhase("calculate", corpus, corpus.infix, [&](const std::string& input) {
+                sink += calc.calculate(input).size();
+            });
+            printPhase("calculate_stats", corpus, corpus.infix, [&](const std::string& input) {
+                sink += measured.calculate(input).size();
+            });
+        }
+    }
+
+    // Numeric::parse over a mixed-radix literal corpus, and strtold over its decimal part.
+    void benchLiterals()
+    {
+        std::vector<std::string> literals;
+        std::vector<std::string> decimals;
+        for (unsigned i = 1; literals.size() < 4096; ++i)
+        {
+            unsigned long long bits = 0x9E3779B97F4A7C15ull * i;
+            char text[64];
+            switch (i % 8)
+            {
+            case 0: snprintf(text, sizeof(text), "%u", static_cast<unsigned>(bits >> 40)); break;
+            case 1: snprintf(text, sizeof(text), "%u.%03u", static_cast<unsigned>(bits >> 50), i % 1000); break;
+            case 2: snprintf(text, sizeof(text), "%u.%ue-%u", i % 10, static_cast<unsigned>(bits >> 44), i % 30); break;
+            case 3: snprintf(text, sizeof(text), "0x%llX", bits); break;
+            case 4: snprintf(text, sizeof(text), "%llXh", bits >> 36); break;
+            case 5: snprintf(text, sizeof(text), "0o%llo", bits >> 20); break;
+            case 6: snprintf(text, sizeof(text), "0b%s", std::bitset<24>(bits >> 40).to_string().c_str()); break;
+            default: snprintf(text, sizeof(text), "%llu", bits >> 2); break;
+            }
+            literals.push_back(text);
+            if (i % 8 < 3 || i % 8 == 7)
+                decimals.push_back(text);
+        }
+
+        double seconds = measure([&]() {
+            Numeric::Literal literal;
+            for (const std::string& text : literals)
+            {
+                Numeric::parse(text.data(), text.data() + text.size(), literal);
+                sink += static_cast<size_t>(literal.integer);
+            }
+        });
+        printRate("literal parse", literals.size() / seconds, "literals/s");
+
+        seconds = measure([&]() {
+            Numeric::Literal literal;
+            for (const std::string& text : decimals)
+            {
+                Numeric::parse(text.data(), text.data() + text.size(), literal);
+                sink += static_cast<size_t>(literal.value);
+            }
+        });
+        printRate("literal parse dec", decimals.size() / seconds, "literals/s");
+
+        seconds = measure([&]() {
+            for (const std::string& text : decimals)
+                sink += static_cast<size_t>(std::strtold(text.c_str(), nullptr));
+        });
+        printRate("strtold dec", decimals.size() / seconds, "literals/s");
+    }
+
+    // Formatting results: the formatter modes against std::to_string and snprintf.
+    void benchFormat()
+    {
+        std::vector<long double> values;
+        for (unsigned i = 1; values.size() < 4096; ++i)
+        {
+            unsigned long long bits = 0x9E3779B97F4A7C15ull * i;
+            long double value = static_cast<long double>(bits >> 11) / (1ull << (i % 53));
+            values.push_back(i % 2 ? value : 1 / value);
+        }
+
+        auto run = [&](const char* name, const RpnFormat& format)
+        {
+            std::string text;
+            double seconds = measure([&]() {
+                for (long double value : values)
+                {
+                    text.clear();
+                    format.append(value, text);
+                    sink += text.size();
+                }
+            });
+            printRate(name, values.size() / seconds, "values/s");
+        };
+        run("format fixed", RpnFormat());
+        run("format shortest", RpnFormat::Shortest());
+        run("format scientific", RpnFormat::Scientific(6));
+
+        double seconds = measure([&]() {
+            for (long double value : values)
+                sink += std::to_string(value).size();
+        });
+        printRate("std::to_string", values.size() / seconds, "values/s");
+
+        seconds = measure([&]() {
+            char text[64];
+            for (long double value : values)
+                sink += snprintf(text, sizeof(text), "%.17g", static_cast<double>(value));
+        });
+        printRate("snprintf %.17g", values.size() / seconds, "values/s");
+    }
+
+    // Parsing and compiling one generated multi-megabyte expression.
+    void benchLargeExpression()
+    {
+        RpnCalculator calc;
+        calc.addStandardFunctions();
+        calc.addStandardOperators();
+        std::string expression = "1";
+        for (size_t i = 0; expression.size() < (4 << 20); ++i)
+            expression += i % 3 == 0 ? " + sin(a)" : i % 3 == 1 ? " * 2.5" : " - b";
+
+        double seconds = measure([&]() {
+            sink += calc.compile(expression, { "a", "b" }).compiled_program().code.size();
+        }, 1.0);
+        printRate("compile 4 MB", expression.size() / seconds / (1 << 20), "MB/s");
+    }
+
+    // calculate over the corpus, without and with the expression cache.
+    void benchCache()
+    {
+        RpnCalculator calc;
+        calc.addStandardFunctions();
+        calc.addStandardOperators();
+        auto pass = [&]() {
+            for (const std::string& expr : corpus)
+            {
+                try
+                {
+                    sink += calc.calculate(expr).size();
+                }
+                catch (const std::exception&)
+                {
+                }
+            }
+        };
+
+        double seconds = measure(pass);
+        printRate("calculate", corpus.size() / seconds, "expressions/s");
+        calc.setCacheBudget(1 << 20);
+        seconds = measure(pass);
+        printRate("calculate cached", corpus.size() / seconds, "expressions/s");
+    }
+
+    // Compares row-at-a-time evaluation of a compiled formula, interpreted and as native code,
+    // with columnar batch evaluation.
+    void benchBatch()
+    {
+        RpnCalculator calc;
+        calc.addStandardFunctions();
+        calc.addStandardOperators();
+        CompiledExpression compiled = calc.compile("price * qty * (1 - disc) + sqrt(price)", { "price", "qty", "disc" });
+
+        const size_t rows = 100000;
+        std::vector<long double> price(rows), qty(rows), disc(rows), results(rows);
+        for (size_t i = 0; i < rows; ++i)
+        {
+            price[i] = 10 + i % 97;
+            qty[i] = 1 + i % 13;
+            disc[i] = (i % 5) / 10.0L;
+        }
+        const long double* columns[] = { price.data(), qty.data(), disc.data() };
+
+        double seconds = measure([&]() {
+            long double row[3];
+            for (size_t i = 0; i < rows; ++i)
+            {
+                row[0] = price[i];
+                row[1] = qty[i];
+                row[2] = disc[i];
+                sink += compiled.evaluate(row, 3).size();
+            }
+        });
+        printRate("evaluate", rows / seconds, "rows/s");
+
+        calc.enableJit(true);
+        CompiledExpression jitted = calc.compile("price * qty * (1 - disc) + sqrt(price)", { "price", "qty", "disc" });
+        seconds = measure([&]() {
+            long double row[3];
+            for (size_t i = 0; i < rows; ++i)
+            {
+                row[0] = price[i];
+                row[1] = qty[i];
+                row[2] = disc[i];
+                sink += jitted.evaluate(row, 3).size();
+            }
+        });
+        printRate(jitted.jit_compiled() ? "evaluate jit" : "evaluate (no jit)", rows / seconds, "rows/s");
+
+        seconds = measure([&]() {
+            compiled.evaluate_batch(columns, 3, rows, results.data());
+            sink += static_cast<size_t>(results[rows - 1]);
+        });
+        printRate("evaluate_batch", rows / seconds, "rows/s");
+    }
+
+    // Dispatch cost of the stack interpreter and the register VM, on programs compiled
+    // without optimization so that constant expressions keep all their instructions.
+    void benchDispatch(const char* name, const std::vector<std::string>& expressions)
+    {
+        RpnCalculator calc;
+        calc.addStandardFunctions();
+        calc.addStandardOperators();
+        calc.enableOptimization(false);
+
+        std::vector<CompiledExpression> compiled;
+        size_t instructions = 0;
+        size_t bytecodes = 0;
+        for (const std::string& expr : expressions)
+        {
+            try
+            {
+                compiled.push_back(calc.compile(expr, { "a", "b" }));
+            }
+            catch (const std::exception&)
+            {
+                continue;
+            }
+            instructions += compiled.back().compiled_program().code.size();
+            bytecodes += compiled.back().compiled_program().bytecode->code.size();
+        }
+
+        const long double values[] = { 1.5L, 2.5L };
+        double interpreted = measure([&]() {
+            for (const CompiledExpression& expr : compiled)
+                sink += static_cast<size_t>(RpnVm::interpret(expr.compiled_program(), values).as_float());
+        });
+        double registers = measure([&]() {
+            for (const CompiledExpression& expr : compiled)
+                sink += static_cast<size_t>(RpnVm::run(expr.compiled_program(), values).as_float());
+        });
+        std::cout << std::setprecision(1)
+            << "dispatch " << name << ": " << compiled.size() << " expressions, " << instructions
+            << " stack instructions, " << bytecodes << " register instructions" << std::endl
+            << "  stack interpreter   " << interpreted * 1e9 / compiled.size() << " ns/expression, "
+            << interpreted * 1e9 / instructions << " ns/instruction" << std::endl
+            << "  register vm         " << registers * 1e9 / compiled.size() << " ns/expression, "
+            << registers * 1e9 / bytecodes << " ns/instruction" << std::endl;
+    }
+
+    // The expression of benchDispatch compiled at compile time, against the register VM.
+    void benchConstexpr()
+    {
+        RpnCalculator calc;
+        calc.addStandardFunctions();
+        calc.addStandardOperators();
+        CompiledExpression compiled = calc.compile(ArithmeticExpression::program().source, { "a", "b" });
+        const auto program = ArithmeticExpression::program();
+
+        const size_t count = 1000;
+        std::vector<long double> values(2 * count);
+        for (size_t i = 0; i < values.size(); ++i)
+            values[i] = 1.5L + i % 17;
+        double vm = measure([&]() {
+            for (size_t i = 0; i < count; ++i)
+                sink += static_cast<size_t>(RpnVm::run(compiled.compiled_program(), &values[2 * i]).as_float());
+        });
+        double interpreted = measure([&]() {
+            for (size_t i = 0; i < count; ++i)
+                sink += static_cast<size_t>(program.evaluate(&values[2 * i]).as_float());
+        });
+        double specialized = measure([&]() {
+            for (size_t i = 0; i < count; ++i)
+                sink += static_cast<size_t>(RpnConstexpr::Evaluator<ArithmeticExpression>::evaluate(&values[2 * i]));
+        });
+        std::cout << std::setprecision(1)
+            << "constexpr: " << program.size << " instructions" << std::endl
+            << "  register vm         " << vm * 1e9 / count << " ns/expression" << std::endl
+            << "  constexpr program   " << interpreted * 1e9 / count << " ns/expression" << std::endl
+            << "  specialized         " << specialized * 1e9 / count << " ns/expression" << std::endl;
+    }
+
+    // calculate and evaluate from several threads sharing one frozen calculator.
+    void benchThreads()
+    {
+        RpnCalculator calc;
+        calc.addStandardFunctions();
+        calc.addStandardOperators();
+        calc.freeze();
+        CompiledExpression compiled = calc.compile("price * qty * (1 - disc) + sqrt(price)", { "price", "qty", "disc" });
+
+        const size_t perThread = 2000;
+        unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        double single = 0;
+        for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+        {
+            auto run = [&](bool compiledOnly) {
+                std::vector<std::thread> threads;
+                for (unsigned t = 0; t < threadCount; ++t)
+                {
+                    threads.emplace_back([&]() {
+                        size_t local = 0;
+                        long double row[] = { 10.5L, 3, 0.1L };
+                        for (size_t i = 0; i < perThread; ++i)
+                        {
+                            if (compiledOnly)
+                                local += compiled.evaluate(row, 3).size();
+                            else
+                                local += calc.calculate(corpus[i % corpus.size()]).size();
+                        }
+                        sink += local;
+                    });
+                }
+                for (std::thread& thread : threads)
+                    thread.join();
+            };
+            double calculateRate = threadCount * perThread / measure([&]() { run(false); }, 0.2);
+            double evaluateRate = threadCount * perThread / measure([&]() { run(true); }, 0.2);
+            if (threadCount == 1)
+                single = calculateRate;
+            std::cout << std::setprecision(0) << "threads " << threadCount
+                << ": calculate " << calculateRate << " expressions/s (" << std::setprecision(2)
+                << calculateRate / single << "x), evaluate " << std::setprecision(0) << evaluateRate << " rows/s" << std::endl;
+        }
+    }
+
+    // A batch of generated expressions through a calculate loop and through calculate_many.
+    void benchMany()
+    {
+        RpnCalculator calc;
+        calc.addStandardFunctions();
+        calc.addStandardOperators();
+        std::vector<std::string> inputs;
+        for (size_t i = 0; i < 100000; ++i)
+            inputs.push_back("sqrt(" + std::to_string(i) + ") * avg(1, 2, " + std::to_string(i % 7) + ") + " + std::to_string(i % 13));
+        std::vector<RpnBatchResult> results(inputs.size());
+
+        double seconds = measure([&]() {
+            for (const std::string& input : inputs)
+                sink += calc.calculate(input).size();
+        }, 0.2);
+        printRate("calculate loop", inputs.size() / seconds, "expressions/s");
+
+        unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned workers = 1; workers <= maxThreads; workers *= 2)
+        {
+            calc.setWorkerCount(workers);
+            seconds = measure([&]() {
+                calc.calculate_many(inputs.data(), inputs.size(), results.data());
+                sink += results.back().value.size();
+            }, 0.2);
+            std::string name = "calculate_many x" + std::to_string(workers);
+            printRate(name.c_str(), inputs.size() / seconds, "expressions/s");
+        }
+    }
+
+    // Throughput of the math kernels for every instruction set the processor supports.
+    void benchSimd()
+    {
+        const char* names[] = { "sin", "cos", "tan", "asin", "acos", "atan", "ln", "lg", "expn",
+            "sqrt", "abs", "floor", "ceil", "pow", "log" };
+        const char* levels[] = { "scalar", "sse2", "avx2" };
+        const size_t count = 4096;
+        std::vector<double> x(count), y(count), result(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            x[i] = 0.001 + 0.999 * i / count;
+            y[i] = 0.5 + 3.0 * i / count;
+        }
+
+        for (int function = 0; function < RpnSimd::FUNCTION_COUNT; ++function)
+        {
+            for (int level = RpnSimd::SCALAR; level <= RpnSimd::detect(); ++level)
+            {
+                RpnSimd::Kernel kernel = RpnSimd::kernel(static_cast<RpnSimd::Function>(function), static_cast<RpnSimd::Level>(level));
+                double seconds = measure([&]() {
+                    kernel(x.data(), y.data(), count, result.data());
+                    sink += static_cast<size_t>(result[count - 1]);
+                }, 0.1);
+                std::string name = std::string(names[function]) + " " + levels[level];
+                printRate(name.c_str(), count / seconds, "values/s");
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--phases") == 0)
+    {
+        benchPhases();
+        return 0;
+    }
+    benchTokenize();
+    benchParse();
+    benchLargeExpression();
+    benchLiterals();
+    benchFormat();
+    benchCache();
+    benchDispatch("corpus", corpus);
+    benchDispatch("arithmetic", { "(a + b) * (a - b) / (a * b + 1) - b / (a + 2) * (a - 1) + a * a * b - (b - a) / 3" });
+    benchConstexpr();
+    benchBatch();
+    benchThreads();
+    benchMany();
+    benchSimd();
+    return 0;
+}
@@ -0,0 +1,181 @@
+// BatchRunner.cpp : Line-oriented batch evaluation behind "c -b".
+//
+
+#include <cstring>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "BatchRunner.h"
+
+namespace
+{
+    // Output is written once this many bytes are buffered.
+    const size_t OUTPUT_BUFFER = 1 << 20;
+    // Block size for reading input that cannot be mapped, such as a pipe.
+    const size_t INPUT_BUFFER = 1 << 20;
+}
+
+BatchRunner::BatchRunner(const RpnCalculator& _calc, bool _rpn, FILE* _output) : calc(_calc), rpn(_rpn), output(_output)
+{
+    inputs.reserve(BATCH_LINES);
+    text.reserve(OUTPUT_BUFFER + 4096);
+}
+
+void BatchRunner::add(const char* begin, const char* end)
+{
+    if (end > begin && end[-1] == '\r')
+        --end;
+    inputBytes += end - begin + 1;
+    const char* p = begin;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+    blank.push_back(p == end);
+    if (p != end)
+        inputs.emplace_back(begin, end);
+    if (blank.size() == BATCH_LINES)
+        evaluate();
+}
+
+void BatchRunner::finish()
+{
+    evaluate();
+    flush();
+}
+
+void BatchRunner::printSummary(FILE* summary, unsigned workers, double seconds) const
+{
+    fprintf(summary, "c: %zu expressions, %zu errors, %u workers, %.3f s, %.0f expressions/s, %.1f MB/s\n",
+        expressions, errors, workers, seconds,
+        seconds > 0 ? expressions / seconds : 0.0,
+        seconds > 0 ? inputBytes / seconds / (1 << 20) : 0.0);
+}
+
+void BatchRunner::evaluate()
+{
+    results.resize(inputs.size());
+    if (rpn)
+        calc.calculate_rpn_many(inputs.data(), inputs.size(), results.data());
+    else
+        calc.calculate_many(inputs.data(), inputs.size(), results.data());
+
+    size_t next = 0;
+    for (bool isBlank : blank) {
+        if (!isBlank) {
+            const RpnBatchResult& result = results[next++];
+            ++expressions;
+            if (result.failed) {
+                ++errors;
+                text += "Error: ";
+                text += result.error;
+            }
+            else
+                text += result.value;
+        }
+        text += '\n';
+        if (text.size() >= OUTPUT_BUFFER)
+            flush();
+    }
+    inputs.clear();
+    blank.clear();
+}
+
+void BatchRunner::flush()
+{
+    fwrite(text.data(), 1, text.size(), output);
+    text.clear();
+}
+
+const char* BatchRunner::addLines(const char* begin, const char* end)
+{
+    for (;;) {
+        const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+        if (!newline)
+            return begin;
+        add(begin, newline);
+        begin = newline + 1;
+    }
+}
+
+bool BatchRunner::runMapped(const char* path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return true;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const char* data = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!data) {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    const char* end = data + static_cast<size_t>(size.QuadPart);
+    const char* rest = addLines(data, end);
+    if (rest != end)
+        add(rest, end);
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return true;
+#else
+    int file = open(path, O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(file);
+        return false;
+    }
+    if (info.st_size == 0) {
+        close(file);
+        return true;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapped == MAP_FAILED)
+        return false;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    const char* data = static_cast<const char*>(mapped);
+    const char* rest = addLines(data, data + size);
+    if (rest != data + size)
+        add(rest, data + size);
+    munmap(mapped, size);
+    return true;
+#endif
+}
+
+void BatchRunner::runStream(FILE* input)
+{
+    std::vector<char> buffer(INPUT_BUFFER);
+    size_t used = 0;
+    for (;;) {
+        if (used == buffer.size())
+            buffer.resize(buffer.size() * 2);   // a line longer than the buffer
+        size_t read = fread(buffer.data() + used, 1, buffer.size() - used, input);
+        if (read == 0)
+            break;
+        used += read;
+        const char* rest = addLines(buffer.data(), buffer.data() + used);
+        used = buffer.data() + used - rest;
+        memmove(buffer.data(), rest, used);
+    }
+    if (used)
+        add(buffer.data(), buffer.data() + used);
+}
@@ -0,0 +1,57 @@
+// BatchRunner.h : Line-oriented batch evaluation behind "c -b".
+//
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "RpnCalculator.h"
+
+// Collects input lines into blocks, evaluates every block in parallel and writes one output
+// line per input line, in input order. Blank lines are not evaluated and stay blank in the
+// output; a failed expression gives "Error: <message>" on its line.
+class BatchRunner
+{
+public:
+    // Lines evaluated by one calculate_many call.
+    static const size_t BATCH_LINES = 1 << 16;
+
+    BatchRunner(const RpnCalculator& _calc, bool _rpn, FILE* _output = stdout);
+
+    // Adds one line, without its terminator.
+    void add(const char* begin, const char* end);
+
+    // Feeds the lines of a regular file through a read-only memory mapping.
+    // Returns false if the file is not a regular file or cannot be mapped.
+    bool runMapped(const char* path);
+
+    // Feeds the lines of a stream, read in large blocks.
+    void runStream(FILE* input);
+
+    // Evaluates the remaining lines and writes all buffered output.
+    void finish();
+
+    // Writes the one line summary of the run, e.g. to stderr.
+    void printSummary(FILE* summary, unsigned workers, double seconds) const;
+
+    size_t expressions = 0;
+    size_t errors = 0;
+    size_t inputBytes = 0;
+
+private:
+    // Splits [begin, end) into lines. Returns the start of an unterminated last line.
+    const char* addLines(const char* begin, const char* end);
+
+    void evaluate();
+    void flush();
+
+    const RpnCalculator& calc;
+    bool rpn;
+    FILE* output;
+    // Whether each pending line is blank; the others are in inputs, in the same order.
+    std::vector<bool> blank;
+    std::vector<std::string> inputs;
+    std::vector<RpnBatchResult> results;
+    std::string text;
+};
@@ -1,7 +1,14 @@
 // calc.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
 
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
+#include "BatchRunner.h"
 #include "RpnCalculator.h" // Include your RPN logic
 #include "RpnDef.h"
 #include "../MoreFuncs/CurrencyAndStock.h"
@@ -22,27 +29,109 @@ bool enumerate_func_callback(std::string const& name, IFunctionInfo const * info
     return false;
 }
 
+namespace
+{
+    // Parses the -f argument: shortest, fixed, fixed:N, sci or sci:N.
+    bool parseFormat(const std::string& spec, RpnFormat& format)
+    {
+        size_t colon = spec.find(':');
+        std::string mode = spec.substr(0, colon);
+        int digits = colon == std::string::npos ? 6 : atoi(spec.c_str() + colon + 1);
+        if (mode == "shortest" && colon == std::string::npos)
+            format = RpnFormat::Shortest();
+        else if (mode == "fixed" && digits >= 0)
+            format = RpnFormat::Fixed(digits);
+        else if (mode == "sci" && digits >= 0)
+            format = RpnFormat::Scientific(digits);
+        else
+            return false;
+        return true;
+    }
+
+    // c -b [-r] [-j workers] [file]: evaluates one expression per line of the file, or of
+    // stdin if no file or "-" is given. Returns the exit code: 0, or 1 if any expression
+    // failed or the input cannot be read.
+    int runBatch(RpnCalculator& calc, int argc, char* argv[])
+    {
+        bool rpn = false;
+        const char* path = nullptr;
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "-r")
+                rpn = true;
+            else if (arg == "-j" && i + 1 < argc)
+                calc.setWorkerCount(static_cast<unsigned>(atoi(argv[++i])));
+            else if (arg != "-")
+                path = argv[i];
+        }
+        calc.freeze();
+
+        typedef std::chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+        BatchRunner runner(calc, rpn);
+        if (path && !runner.runMapped(path)) {
+            FILE* input = fopen(path, "rb");
+            if (!input) {
+                fprintf(stderr, "c: cannot open %s\n", path);
+                return 1;
+            }
+            runner.runStream(input);
+            fclose(input);
+        }
+        else if (!path)
+            runner.runStream(stdin);
+        runner.finish();
+        fflush(stdout);
+
+        runner.printSummary(stderr, calc.workerCount(), std::chrono::duration<double>(clock::now() - start).count());
+        return runner.errors ? 1 : 0;
+    }
+}
+
 
 int main(int argc, char *argv[])
 {
-    if (argc <= 1)
-        printf("Command line: c <infix expression> or c -r <RPN expression\n"
-               "c -l for list of supported functions.");
+    if (argc <= 1) {
+        printf("Command line: c <infix expression> or c -r <RPN expression>\n"
+               "c -l for list of supported functions.\n"
+               "c -b [-r] [-j workers] [file] evaluates one expression per line of file or stdin.\n"
+               "Prefix with -f shortest|fixed:N|sci:N to select the number format (default fixed:6).\n");
+        return 1;
+    }
     RpnCalculator *calc = new RpnCalculator();
     calc->addStandardFunctions();
     calc->addStandardOperators();
     calc->addFunction("currency", std::unique_ptr<Currency>(new Currency()));
     calc->addFunction("stock", std::unique_ptr<Stock>(new Stock()));
-    int cmdIndex = 1; 
-    std::string result;
-    if (std::string(argv[1]) != "-l")
-        calc->enumerateFunctions(enumerate_func_callback);
-    else if (std::string(argv[1])!="-r")
-        result = calc->calculate(argv[1]);
-    else
-        result = calc->calculate_rpn(argv[2]);
+    int status = 0;
+    if (argc > 3 && strcmp(argv[1], "-f") == 0) {
+        RpnFormat format;
+        if (!parseFormat(argv[2], format)) {
+            fprintf(stderr, "c: unknown format %s\n", argv[2]);
+            delete calc;
+            return 1;
+        }
+        calc->setResultFormat(format);
+        // The remaining arguments are read as if -f had not been given.
+        argc -= 2;
+        argv += 2;
+    }
+    std::string option = argv[1];
+    try {
+        if (option == "-l")
+            calc->enumerateFunctions(enumerate_func_callback);
+        else if (option == "-b")
+            status = runBatch(*calc, argc, argv);
+        else if (option == "-r" && argc > 2)
+            std::cout << calc->calculate_rpn(argv[2]) << "\n";
+        else
+            std::cout << calc->calculate(argv[1]) << "\n";
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        status = 1;
+    }
 
     delete calc;
-    std::cout << result <<"\n";
+    return status;
 }
-
@@ -0,0 +1,207 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "RpnDef.h"
+
+#if !defined(_WIN32)
+#define RPN_API
+#elif defined(RPN_EXPORTS)
+#define RPN_API __declspec(dllexport)
+#else
+#define RPN_API __declspec(dllimport)
+#endif
+
+// One step of a compiled RPN program.
+struct RpnInstruction
+{
+    enum Kind : unsigned char
+    {
+        PUSH_CONSTANT,      // push constants[index]
+        PUSH_VARIABLE,      // push the value bound to variable slot index
+        APPLY_OPERATOR,     // pop arity operands, push the result of operators[index]
+        CALL_FUNCTION,      // pop arity parameters, push the result of functions[index]
+        STORE_TEMPORARY,    // copy the top of the stack to temporary index, leaving it on the stack
+        PUSH_TEMPORARY,     // push temporary index
+    };
+
+    Kind kind;
+    // Number of stack entries consumed. -1 for a variadic call whose parameter count
+    // is only known at run time (it is then taken from the top of the stack).
+    int arity;
+    // Index into the constant, variable, operator, function or temporary table of the program.
+    int index;
+};
+
+class RpnJit;
+struct RpnBytecodeProgram;
+
+// Fully resolved form of an RPN expression. Literals are classified, and operator and
+// function names are resolved to their implementations, so that running the program
+// needs no tokenizing and no name lookups.
+struct CompiledProgram
+{
+    struct OperatorEntry
+    {
+        std::string name;
+        ITypedOperatorInfo* info;
+    };
+    struct FunctionEntry
+    {
+        std::string name;
+        ITypedFunctionInfo* info;
+    };
+
+    std::vector<RpnInstruction> code;
+    std::vector<RpnValue> constants;
+    // Variable names, indexed by slot.
+    std::vector<std::string> variables;
+    std::vector<OperatorEntry> operators;
+    std::vector<FunctionEntry> functions;
+    // Maximal stack depth reached while running the program.
+    size_t maxDepth = 0;
+    // Number of temporaries holding common sub-expressions.
+    size_t temporaries = 0;
+    // Number of operator and function applications removed by common sub-expression elimination.
+    size_t nodesSaved = 0;
+    // Operators applied and functions called by one run of the program.
+    size_t operatorApplications = 0;
+    size_t functionCalls = 0;
+    // Register bytecode run by RpnVm; nullptr for programs the stack interpreter runs.
+    std::shared_ptr<const RpnBytecodeProgram> bytecode;
+    // Native code for the program, if RpnCalculator::enableJit is set and RpnJit supports it.
+    std::shared_ptr<const RpnJit> native;
+};
+
+// Immutable handle to a compiled expression, returned by RpnCalculator::compile and
+// RpnCalculator::compile_rpn. Copies share the same program and may be evaluated repeatedly.
+// The handle refers to the operators and functions registered in the calculator that
+// compiled it, so it must not outlive that calculator.
+class CompiledExpression
+{
+private:
+    std::shared_ptr<const CompiledProgram> program;
+
+    // Runs the program with variables bound by slot and returns the typed result.
+    RpnValue execute(const long double* values) const;
+
+    // Checks the bindings and runs the program, in native code if available.
+    RpnValue run(const long double* values, size_t count) const;
+
+public:
+    CompiledExpression() = default;
+    explicit CompiledExpression(std::shared_ptr<const CompiledProgram> _program) : program(std::move(_program))
+    {
+    }
+
+    // Returns true if the handle holds a program.
+    bool valid() const
+    {
+        return program != nullptr;
+    }
+
+    // Returns the number of instructions of the program, after optimization.
+    size_t instruction_count() const
+    {
+        return program->code.size();
+    }
+
+    // Returns how many operator and function applications are saved per evaluation by
+    // computing repeated sub-expressions only once.
+    size_t nodes_saved() const
+    {
+        return program->nodesSaved;
+    }
+
+    // Returns true if evaluate runs native code generated by RpnJit.
+    bool jit_compiled() const
+    {
+        return program->native != nullptr;
+    }
+
+    // Returns the compiled program, e.g. for benchmarks comparing evaluators.
+    const CompiledProgram& compiled_program() const
+    {
+        return *program;
+    }
+
+    // Prints the program in RPN form to the standard output.
+    RPN_API void print() const;
+
+    // Returns the variable names of the expression, indexed by slot.
+    const std::vector<std::string>& variables() const
+    {
+        return program->variables;
+    }
+
+    // Returns the slot of the named variable, or -1 if the expression does not use it.
+    // Resolve slots once and bind values by index on every evaluation.
+    RPN_API int slot(const std::string& name) const;
+
+    // Runs the program and returns the result as a string.
+    // Fails if the expression uses variables.
+    RPN_API std::string evaluate() const;
+
+    // Runs the program with variables bound by slot: values[i] is the value of variables()[i].
+    // count: number of entries in values, at least variables().size().
+    RPN_API std::string evaluate(const long double* values, size_t count) const;
+
+    // As above, with a floating point result formatted as given (see RpnFormat.h).
+    RPN_API std::string evaluate(const long double* values, size_t count, const RpnFormat& format) const;
+
+    std::string evaluate(const std::vector<long double>& values) const
+    {
+        return evaluate(values.data(), values.size());
+    }
+
+    // Runs the program with variables bound from a row struct whose members are
+    // long double values declared in slot order.
+    template <class Row>
+    std::string evaluate_row(const Row& row) const
+    {
+        static_assert(std::is_standard_layout<Row>::value && sizeof(Row) % sizeof(long double) == 0,
+            "Row must be a struct of long double members");
+        return evaluate(reinterpret_cast<const long double*>(&row), sizeof(Row) / sizeof(long double));
+    }
+
+    // Runs the program over many rows. Input is columnar: columns[i] holds the rows values
+    // of variables()[i]. Each instruction is applied to a block of rows at a time, so
+    // built-in operators and functions run as tight loops over arrays. Programs using
+    // operators or functions without a block implementation run one row at a time.
+    // columnCount: number of entries in columns, at least variables().size().
+    // results: receives the rows numeric results.
+    RPN_API void evaluate_batch(const long double* const* columns, size_t columnCount, size_t rows, long double* results) const;
+
+    std::vector<long double> evaluate_batch(const std::vector<const long double*>& columns, size_t rows) const
+    {
+        std::vector<long double> results(rows);
+        evaluate_batch(columns.data(), columns.size(), rows, results.data());
+        return results;
+    }
+};
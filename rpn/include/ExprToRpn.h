@@ -30,14 +30,62 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
-#include <regex>
 #include <cmath>
 #include <algorithm>
 #include <memory>
 #include <cctype>
+#include <cstdint>
 #include <functional>
 #include <stdexcept>
 #include "RpnDef.h"
+#include "CompiledExpression.h"
+
+// Element of an expression classified once, with operator and function names resolved
+// to their registry IDs so that later phases need no string hashing or case folding.
+// Tokens do not own their text: offset and length locate it in the expression string,
+// which must outlive the tokens.
+struct RpnToken
+{
+    enum Kind : unsigned char
+    {
+        LITERAL,        // numeric or quoted string literal
+        VARIABLE,       // any other name
+        OPERATOR,       // id is the operator ID
+        FUNCTION,       // id is the function ID
+        LEFT_BRACKET,
+        RIGHT_BRACKET,
+        SEPARATOR,      // ','
+        COUNT,          // id is the parameter count of the following variadic call; no text
+    };
+
+    Kind kind;
+    // Registry ID for operators and functions, parameter count for COUNT, -1 otherwise.
+    int id;
+    // Position of the token in the expression. A literal with a merged unary minus
+    // starts at the '-' and may contain whitespace in front of the number.
+    uint32_t offset;
+    uint32_t length;
+
+    const char* begin(const char* source) const
+    {
+        return source + offset;
+    }
+
+    const char* begin(const std::string& source) const
+    {
+        return begin(source.data());
+    }
+
+    std::string text(const char* source) const
+    {
+        return kind == COUNT ? std::to_string(id) : std::string(source + offset, length);
+    }
+
+    std::string text(const std::string& source) const
+    {
+        return text(source.data());
+    }
+};
 
 // Class implementing the Shunting Yard algorithm for parsing mathematical expressions.
 // FunctionShuntingYard supports custom operators and functions, allowing conversion
@@ -49,14 +97,47 @@
 // - Convert infix expressions to RPN using the Shunting Yard algorithm.
 // - Evaluate RPN expressions using registered operators and functions.
 // - Print and list available functions.
+//
+// Registration is not synchronized. The const member functions only read the registries,
+// so once registration is over they may be called from several threads at once.
 class FunctionShuntingYard {
 private:
-    // Map of operator names to their operator information (precedence, associativity, etc.).
-    std::unordered_map<std::string, operator_ptr_t> operators;
-    // Map of function names to their function information (arity, calculation logic, etc.).
-    std::unordered_map<std::string, function_ptr_t> functions;
-    // Set of right-associative operator symbols (e.g., "^").
-    //std::unordered_set<std::string> rightAssociative = { "^" };
+    // Registered operator or function together with its typed entry point: the implementation
+    // itself, or an adapter when it only implements the string interface.
+    template <class Info, class TypedInfo>
+    struct Registration
+    {
+        std::string name;
+        std::unique_ptr<Info> info;
+        std::unique_ptr<TypedInfo> adapter;
+        TypedInfo* typed = nullptr;
+    };
+    typedef Registration<IOperatorInfo, ITypedOperatorInfo> OperatorRegistration;
+    typedef Registration<IFunctionInfo, ITypedFunctionInfo> FunctionRegistration;
+
+    // Parser properties of a registered operator, read once by add_operator so that the
+    // shunting-yard loop needs no virtual calls.
+    struct OperatorTraits
+    {
+        int precedence;
+        bool rightAssociative;
+        int parameters;
+    };
+
+    // Registered operators indexed by operator ID (precedence, associativity, etc.).
+    std::vector<OperatorRegistration> operators;
+    // Precedence, associativity and arity indexed by operator ID.
+    std::vector<OperatorTraits> operatorTraits;
+    // Operator symbols to operator IDs; only used when classifying tokens.
+    std::unordered_map<std::string, int> operatorIds;
+    // Registered functions indexed by function ID (arity, calculation logic, etc.).
+    std::vector<FunctionRegistration> functions;
+    // Parameter counts indexed by function ID, -1 for variable parameters.
+    std::vector<int> functionArities;
+    // Lower case function names to function IDs; only used when classifying tokens.
+    std::unordered_map<std::string, int> functionIds;
+    // Length of the longest registered operator symbol, used by the lexer for longest-match scanning.
+    size_t maxOperatorLength = 0;
 
     static std::string to_lower(std::string s) {
         std::transform(s.begin(), s.end(), s.begin(),
@@ -64,45 +145,33 @@ private:
         return s;
     }
 
-    // helpers
-    static bool isLeftBracket(const std::string& s) {
-        return s == "(" || s == "[" || s == "{";
-    }
-    static bool isRightBracket(const std::string& s) {
-        return s == ")" || s == "]" || s == "}";
-    }
-    static std::string matchingOpening(const std::string& closing) {
-        if (closing == ")") return "(";
-        if (closing == "]") return "[";
-        if (closing == "}") return "{";
-        return "";
-    }
-    bool isString(const std::string& token) const {
-        if (token[0] == '"' && token[token.length() - 1] == '"')
-            return true;
-        return false;
+    static char matchingOpening(char closing) {
+        if (closing == ')') return '(';
+        if (closing == ']') return '[';
+        if (closing == '}') return '{';
+        return 0;
     }
 
-    bool isOperator(const std::string& token) const {
-        return operators.find(token) != operators.end();
-    }
-    bool isFunction(const std::string& token) const 
+    // Stores info under name and returns its ID.
+    template <class Info, class TypedInfo, class Adapter>
+    static int registerEntry(std::vector<Registration<Info, TypedInfo>>& table, std::unordered_map<std::string, int>& ids,
+        std::string const& name, std::unique_ptr<Info> info)
     {
-        std::string name = to_lower(token);
-        return functions.find(name) != functions.end();
-    }
-    int getPrecedence(const std::string& op) const {
-        auto it = operators.find(op);
-        return (it != operators.end()) ? it->second.get()->precedence() : 0;
-    }
-    bool isRightAssociative(const std::string& op) const {
-        auto it = operators.find(op);
-        return (it != operators.end()) ? it->second.get()->isRightAssociative() : false;
-    }
-    int getFunctionArity(const std::string& func) const {
-        std::string name = to_lower(func);
-        auto it = functions.find(name);
-        return (it != functions.end()) ? it->second.get()->num_parameters() : 0;
+        auto it = ids.find(name);
+        if (it == ids.end()) {
+            it = ids.emplace(name, static_cast<int>(table.size())).first;
+            table.emplace_back();
+            table.back().name = name;
+        }
+        Registration<Info, TypedInfo>& registration = table[it->second];
+        registration.info = std::move(info);
+        registration.typed = dynamic_cast<TypedInfo*>(registration.info.get());
+        registration.adapter.reset();
+        if (registration.info && !registration.typed) {
+            registration.adapter.reset(new Adapter(registration.info.get()));
+            registration.typed = registration.adapter.get();
+        }
+        return it->second;
     }
 
 
@@ -116,26 +185,55 @@ public:
     }
 
     // Registers a new operator with the given name and operator information.
+    // Re-registering a name keeps its operator ID. Precedence, associativity and the number
+    // of parameters are read here, once; re-register the operator to change them.
     void add_operator(std::string const & name, operator_ptr_t operator_info)
     {
-        operators[name] = std::move(operator_info);
+        OperatorTraits traits = { -1, false, 2 };
+        if (operator_info)
+            traits = { operator_info->precedence(), operator_info->isRightAssociative(), operator_info->num_parameters() };
+        int id = registerEntry<IOperatorInfo, ITypedOperatorInfo, StringOperatorAdapter>(operators, operatorIds, name, std::move(operator_info));
+        operatorTraits.resize(operators.size());
+        operatorTraits[id] = traits;
+        maxOperatorLength = std::max(maxOperatorLength, name.length());
     }
 
     // Registers a new function with the given name and function information.
+    // Re-registering a name keeps its function ID. The number of parameters is read here, once.
     void add_function(std::string const & _name, function_ptr_t function_info)
     {
-        std::string name = to_lower(_name);
-        functions[name] = std::move(function_info);
+        int arity = function_info ? function_info->num_parameters() : 0;
+        int id = registerEntry<IFunctionInfo, ITypedFunctionInfo, StringFunctionAdapter>(functions, functionIds, to_lower(_name), std::move(function_info));
+        functionArities.resize(functions.size());
+        functionArities[id] = arity;
     }
 
-    // Tokenizes an infix expression string into a vector of tokens.
-    std::vector<std::string> tokenize(const std::string& expression, bool rpn_input);
-    // Converts an infix expression string to a vector of RPN tokens.
-    std::vector<std::string> infixToRPN(const std::string& infix);
+    // Tokenizes an infix or RPN expression string into classified tokens in a single pass,
+    // resolving operator and function IDs. Unary minus directly preceding a numeric literal
+    // is merged into the literal. The tokens refer to expression, which must outlive them.
+    std::vector<RpnToken> tokenize(const std::string& expression, bool rpn_input) const;
+    // Tokenizes the length characters at data, which need not be null-terminated,
+    // e.g. a line of a memory-mapped file. The tokens refer to data.
+    std::vector<RpnToken> tokenize(const char* data, size_t length, bool rpn_input) const;
+    // Converts an infix expression string to RPN with operator and function IDs resolved.
+    // The tokens refer to infix.
+    std::vector<RpnToken> infixToRPN(const std::string& infix) const;
+    std::vector<RpnToken> infixToRPN(const char* data, size_t length) const;
+    // Converts the tokens of an infix expression, as returned by tokenize, to RPN.
+    std::vector<RpnToken> infixToRPN(const std::string& infix, const std::vector<RpnToken>& tokens) const;
+    std::vector<RpnToken> infixToRPN(const char* infix, const std::vector<RpnToken>& tokens) const;
+    // Tokenizes an RPN expression string, rejecting brackets and separators.
+    std::vector<RpnToken> resolveRPN(const std::string& rpn) const;
+    // Builds a program that can be evaluated repeatedly without re-parsing.
+    // source: the expression the tokens refer to.
+    // Names that are neither operators nor functions become variables. Those listed in
+    // variables get the slots 0..n-1 in that order, others are appended in order of appearance.
+    std::shared_ptr<const CompiledProgram> compile(const std::string& source, const std::vector<RpnToken>& rpn,
+        const std::vector<std::string>& variables) const;
     // Evaluates an RPN expression and returns the result as a string.
-    std::string evaluateRPN(const std::vector<std::string>& rpn) const;
+    std::string evaluateRPN(const std::string& rpn) const;
     // Prints the RPN expression to the standard output.
-    void printRPN(const std::vector<std::string>& rpn) const;
+    void printRPN(const std::string& source, const std::vector<RpnToken>& rpn) const;
     // enumerate all registered functions to the standard output.
     void enumerateFunctions(bool (*func)(std::string const& name, IFunctionInfo const *)) const;
 };
@@ -30,6 +30,27 @@
 class Numeric
 {
 public:
+    // Value of a numeric literal read by parse.
+    struct Literal
+    {
+        // Whether the literal is an integer; integer then holds its exact value.
+        bool integral = false;
+        long long integer = 0;
+        // The value as floating point, also set for integers.
+        long double value = 0;
+    };
+
+    // Classifies and converts a numeric literal in a single pass without copying it.
+    // Accepted forms, with an optional leading sign:
+    // - 0x1F, 0o17, 0b101 and 1Fh/1Fx, 17o, 101b: integers of up to 64 bits, kept exactly;
+    //   values from 2^63 on keep their bit pattern, i.e. 0xFFFFFFFFFFFFFFFF is -1.
+    // - 12, 1.5, .5, 1., 1e-9, 1.5E+3: decimal integers that fit in 64 bits are integral,
+    //   everything else is converted to the nearest long double.
+    // - inf, infinity and nan, as written by printf.
+    // Returns false if [begin, end) is not one of these forms.
+    // Throws std::runtime_error if a radix literal does not fit in 64 bits.
+    static bool parse(const char* begin, const char* end, Literal& literal);
+
     static bool isString(const std::string& _token);
     static bool isNumber(const std::string& token) ;
     static long double str_to_ld(std::string _token) ;
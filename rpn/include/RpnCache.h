@@ -0,0 +1,123 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "CompiledExpression.h"
+
+// Counters of the expression cache of RpnCalculator.
+struct RpnCacheStats
+{
+    // Compiled programs by normalized expression text.
+    size_t planHits = 0;
+    size_t planMisses = 0;
+    size_t planEvictions = 0;
+    // Results of pure expressions by normalized expression text.
+    size_t resultHits = 0;
+    size_t resultMisses = 0;
+    size_t resultEvictions = 0;
+    // Current content and its estimated size in bytes.
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t budget = 0;
+};
+
+// Size-bounded LRU cache with two tiers: normalized expression text to compiled program,
+// and normalized expression text to result. Both tiers share one list and one memory
+// budget, so the least recently used entry of either tier is evicted first.
+// All member functions are safe to call concurrently.
+class RpnCache
+{
+public:
+    enum Tier
+    {
+        PLAN,
+        RESULT,
+    };
+
+    explicit RpnCache(size_t budget);
+
+    RpnCache(const RpnCache&) = delete;
+    RpnCache& operator=(const RpnCache&) = delete;
+
+    // Returns a key for the expression that is the same for texts differing only in
+    // whitespace that does not separate tokens. String literals are kept as they are.
+    // rpn: whether the text is in RPN form, where whitespace separates every token; the
+    // key tells both forms apart.
+    static std::string normalize(const std::string& text, bool rpn);
+
+    // Returns whether all operators and functions of the program are pure, so its result
+    // can be cached.
+    static bool isPure(const CompiledProgram& program);
+
+    // Looks up a compiled program and marks it as recently used.
+    bool findPlan(const std::string& key, CompiledExpression& plan);
+
+    // Looks up a result and marks it as recently used.
+    bool findResult(const std::string& key, std::string& result);
+
+    void storePlan(const std::string& key, const CompiledExpression& plan);
+    void storeResult(const std::string& key, const std::string& result);
+
+    // Returns whether the budget is nonzero. Callers skip the cache otherwise.
+    bool enabled() const
+    {
+        return active;
+    }
+
+    // Changes the memory budget in bytes, evicting entries that no longer fit.
+    void setBudget(size_t budget);
+
+    // Removes all entries; counters are kept.
+    void clear();
+
+    RpnCacheStats stats() const;
+
+private:
+    struct Entry
+    {
+        // Tier tag followed by the normalized text.
+        std::string key;
+        Tier tier;
+        CompiledExpression plan;
+        std::string result;
+        size_t bytes;
+    };
+
+    void store(Entry entry);
+    void evict();
+
+    mutable std::mutex mutex;
+    // Most recently used entries first.
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    RpnCacheStats counters;
+    std::atomic<bool> active;
+};
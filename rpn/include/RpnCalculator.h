@@ -27,8 +27,13 @@
 
 #include <string>
 #include "ExprToRpn.h"
+#include "CompiledExpression.h"
+#include "RpnCache.h"
+#include "RpnStats.h"
 
-#ifdef RPN_EXPORTS
+#if !defined(_WIN32)
+#define RPN_API
+#elif defined(RPN_EXPORTS)
 #define RPN_API __declspec(dllexport)
 #else
 #define RPN_API __declspec(dllimport)
@@ -40,10 +45,22 @@
 // Usage:
 //   - Add custom or standard functions/operators.
 //   - Evaluate expressions in infix or RPN format.
+//   - Call freeze() before sharing the instance between threads.
 //
 // Members:
 //   calc: Pointer to the internal FunctionShuntingYard engine.
-//   verbose: Controls verbosity of output (e.g., prints RPN steps if enabled).
+//   verbose: Controls verbosity of output (e.g., prints RPN steps and the optimized program if enabled).
+class RpnThreadPool;
+
+// Outcome of one expression of RpnCalculator::calculate_many: the result, or the message of
+// the exception thrown while evaluating it.
+struct RpnBatchResult
+{
+    std::string value;
+    std::string error;
+    bool failed = false;
+};
+
 class RPN_API RpnCalculator
 {
 private:
@@ -51,6 +68,42 @@ private:
     FunctionShuntingYard *calc;
     // Verbosity flag for debugging or detailed output.
     int verbose = 0;
+    // Whether compiled expressions get native code.
+    bool jit = false;
+    // Whether compiled expressions are optimized.
+    bool optimization = true;
+    // Plans and results of calculate and calculate_rpn, empty unless a budget is set.
+    RpnCache *cache;
+    // Set by freeze; registration and compile options are then rejected.
+    bool frozen = false;
+    // Workers of calculate_many and calculate_rpn_many, started on first use.
+    RpnThreadPool *pool;
+    // Format of floating point results of calculate and the batch functions.
+    RpnFormat format;
+    // Per-phase statistics of calculate and the batch functions, recorded once enabled.
+    RpnStatsCounters *phaseCounters;
+
+    // Throws if the calculator is frozen.
+    void checkNotFrozen(const char* what) const;
+
+    // Runs the optimization passes over a freshly compiled program and translates it to
+    // register bytecode, and to native code if the JIT is enabled.
+    std::shared_ptr<const CompiledProgram> optimize(const CompiledProgram& program) const;
+
+    // Evaluates an expression through the cache, if it is enabled, and records its
+    // statistics, if they are enabled.
+    std::string calculateCached(const std::string& input, bool rpn) const;
+
+    // Evaluates an expression through the cache. Phase timings and counts go to sample
+    // unless it is nullptr.
+    std::string calculateCached(const std::string& input, bool rpn, RpnStatsSample* sample) const;
+
+    // Compiles an expression for calculateCached, timing tokenize, infix to RPN conversion
+    // and compilation separately if sample is not nullptr.
+    CompiledExpression compilePlan(const std::string& input, bool rpn, RpnStatsSample* sample) const;
+
+    // Evaluates a batch on the pool; see calculate_many.
+    void calculateBatch(const std::string* inputs, size_t count, RpnBatchResult* results, bool rpn) const;
 
 public:
     // Constructs an RpnCalculator instance.
@@ -86,6 +139,103 @@ public:
     // Returns: The result as a string.
     std::string calculate(const std::string & input) const; 
 
+    // Evaluates independent infix expressions in parallel.
+    // inputs: count expressions.
+    // results: count entries, filled in input order. An expression that fails to parse or
+    //          evaluate sets failed and error of its entry; the others are not affected.
+    // Expressions are spread over the workers of an internal work-stealing pool (see
+    // RpnThreadPool.h and setWorkerCount), with the calling thread as one of them. All
+    // registered functions and operators must be safe to call concurrently.
+    void calculate_many(const std::string* inputs, size_t count, RpnBatchResult* results) const;
+    std::vector<RpnBatchResult> calculate_many(const std::vector<std::string> & inputs) const;
+
+    // Evaluates independent RPN expressions in parallel, as calculate_many.
+    void calculate_rpn_many(const std::string* inputs, size_t count, RpnBatchResult* results) const;
+
+    // Sets the number of threads used by calculate_many and calculate_rpn_many, including
+    // the calling thread; 0 (the default) uses one per hardware thread and 1 evaluates on
+    // the calling thread only.
+    void setWorkerCount(unsigned workers);
+
+    // Returns the number of threads used by calculate_many.
+    unsigned workerCount() const;
+
+    // Selects how calculate, calculate_rpn and the batch functions format floating point
+    // results: fixed with 6 decimals (the default, as std::to_string), fixed with another
+    // number of decimals, the shortest text that reads back to the same double, or
+    // scientific notation. See RpnFormat.h. Clears the cache; throws after freeze.
+    void setResultFormat(const RpnFormat& resultFormat);
+
+    // Returns the format of floating point results.
+    RpnFormat resultFormat() const;
+
+    // Compiles an infix expression into a reusable program.
+    // input: The infix expression as a string.
+    // variables: Optional variable names that get the slots 0..n-1 in this order. Other names
+    //            found in the expression are appended in order of appearance.
+    // Returns: An immutable handle that evaluates the expression without re-parsing it.
+    CompiledExpression compile(const std::string & input, const std::vector<std::string> & variables = std::vector<std::string>()) const;
+
+    // Compiles an RPN expression into a reusable program.
+    // input_rpn: The RPN expression as a string.
+    // variables: Optional variable names, as for compile.
+    // Returns: An immutable handle that evaluates the expression without re-parsing it.
+    CompiledExpression compile_rpn(const std::string & input_rpn, const std::vector<std::string> & variables = std::vector<std::string>()) const;
+
+    // Selects whether compile and compile_rpn generate native x86-64 code (RpnJit) for
+    // expressions made of the built-in floating point operators and functions. Other
+    // expressions, and all expressions on other platforms, keep using the interpreter.
+    // Off by default; see RpnJit.h for the precision of native code.
+    void enableJit(bool enabled);
+
+    // Selects whether compile and compile_rpn run constant folding and common sub-expression
+    // elimination. On by default; turning it off helps to debug the optimizer and to
+    // measure evaluation of unmodified programs.
+    void enableOptimization(bool enabled);
+
+    // Freezes the registered operators and functions and the compile options into an
+    // immutable snapshot. Afterwards calculate, calculate_rpn, compile and compile_rpn may be
+    // called concurrently from any number of threads without locks (except in the cache, if
+    // enabled), and addFunction, addOperator, enableJit, enableOptimization and setResultFormat throw.
+    // Hand the calculator to other threads only after freeze returns.
+    void freeze();
+
+    // Returns whether freeze was called.
+    bool isFrozen() const;
+
+    // Sets the memory budget of the expression cache used by calculate and calculate_rpn,
+    // in bytes; 0 (the default) disables the cache. The cache maps expression text,
+    // normalized for whitespace, to the compiled program and, for expressions whose
+    // operators and functions are all pure, to the result. Least recently used entries are
+    // evicted when the estimated size exceeds the budget. Adding functions or operators
+    // and changing compile options clears it.
+    void setCacheBudget(size_t bytes);
+
+    // Returns the hit, miss and eviction counters of the cache and its current size.
+    RpnCacheStats cacheStats() const;
+
+    // Removes all cached plans and results.
+    void clearCache();
+
+    // Selects whether calculate, calculate_rpn and the batch functions record the time spent
+    // in each phase (tokenize, infix to RPN, compile, evaluate), end to end latencies and
+    // the numbers of tokens, operator applications and function calls. Off by default;
+    // while off, the only cost is one test of a flag per expression. May be called at any
+    // time, also after freeze and while other threads calculate. Throws if the library was
+    // built with RPN_STATS set to 0.
+    void enableStats(bool enabled);
+
+    // Returns a snapshot of the statistics counters; see RpnStats.h.
+    RpnStats stats() const;
+
+    // Sets all statistics counters to zero.
+    void resetStats();
+
+    // Returns the shunting yard engine behind calculate, e.g. to run or time its phases
+    // (tokenize, infixToRPN, evaluateRPN) separately. Register functions and operators
+    // through addFunction and addOperator.
+    const FunctionShuntingYard& engine() const;
+
     // creates list of supported functions
     void enumerateFunctions(bool (*scan_func)(std::string const& name, IFunctionInfo const *)) const;
 
@@ -0,0 +1,1139 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <climits>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Compile-time front end for expressions embedded in C++ code (C++14 constexpr, header only).
+//
+// Expressions known when the program is built are tokenized, converted to RPN and, without
+// variables, evaluated by the compiler, so no parsing happens at startup:
+//
+//   constexpr long double area = RpnConstexpr::evaluate("3 * 2 ** 4 + sqrt(16)");
+//   static_assert(RpnConstexpr::evaluate_integer("0xFF & 0x0F | 1 << 4") == 31, "");
+//
+// Expressions with variables are compiled into a constant program that is run with values
+// supplied at run time. Evaluator runs it as straight-line code generated for the one
+// expression: each instruction, its operands' stack positions and the operator to apply
+// are template constants, so no opcode dispatch is left after inlining.
+//
+//   RPN_CONSTEXPR_EXPRESSION(Quadratic, "a * x ** 2 + b * x + c");
+//   long double y = RpnConstexpr::Evaluator<Quadratic>::evaluate(a, x, b, c);
+//
+// Variables get slots in order of first appearance; Program::slot looks them up by name.
+//
+// The language is the infix language of RpnCalculator with the standard operators and the
+// pure standard functions (sin, asin, cos, acos, tan, atan, ln, lg, expn, sqrt, abs, floor,
+// ceil, g2r, r2g, c2f, f2c, log, pow, avg). Precedence, associativity and the integer rules
+// are those of the runtime: integers stay exact 64-bit values through |, &, ^, <<, >>, %
+// and through +, -, *, ** unless the result overflows. String literals, custom operators
+// and functions and hex, oct and bin are not available. An invalid expression is a
+// compile error when evaluated in a constant expression, and throws std::runtime_error
+// otherwise.
+//
+// The math functions are evaluated by series expansions in long double. Results agree with
+// the C library to within a few units in the last place, but are not always bit for bit
+// equal, and sin, cos and tan of arguments beyond 2^63 differ entirely. Decimal literals with
+// more than 19 digits or exponents beyond 10^27 may differ in the last bit from the runtime
+// parser.
+class RpnConstexpr
+{
+public:
+    // Typed value, as RpnValue without strings.
+    struct Value
+    {
+        bool integral = false;
+        long long i = 0;
+        long double f = 0;
+
+        static constexpr Value Integer(long long value)
+        {
+            Value v;
+            v.integral = true;
+            v.i = value;
+            return v;
+        }
+
+        static constexpr Value Float(long double value)
+        {
+            Value v;
+            v.f = value;
+            return v;
+        }
+
+        constexpr long double as_float() const
+        {
+            return integral ? static_cast<long double>(i) : f;
+        }
+
+        // Truncates as RpnValue; NaN and values out of range give LLONG_MIN, as on x86.
+        constexpr long long as_integer() const
+        {
+            return integral ? i : f > -9223372036854775808.0L && f < 9223372036854775808.0L ? static_cast<long long>(f) : LLONG_MIN;
+        }
+    };
+
+    enum Opcode : unsigned char
+    {
+        PUSH_CONSTANT,      // operand is the constant index
+        PUSH_VARIABLE,      // operand is the variable slot
+        // Operators
+        OR, XOR, AND, SHIFT_LEFT, SHIFT_RIGHT, ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULO, POWER,
+        // Functions
+        SIN, ASIN, COS, ACOS, TAN, ATAN, LN, LG, EXPN, SQRT, ABS, FLOOR, CEIL, G2R, R2G, C2F, F2C,
+        LOG, POW, AVG,
+        OPCODE_COUNT
+    };
+
+    struct Instruction
+    {
+        Opcode opcode = PUSH_CONSTANT;
+        int operand = 0;
+        // Values popped from the stack.
+        int arity = 0;
+    };
+
+    // Precedence of an operator; higher binds tighter. The table of ArithmeticOperator.
+    static constexpr int precedence(Opcode opcode)
+    {
+        switch (opcode) {
+        case OR: return 1;
+        case XOR: return 2;
+        case AND: return 3;
+        case SHIFT_LEFT: case SHIFT_RIGHT: return 4;
+        case ADD: case SUBTRACT: return 5;
+        case MULTIPLY: case DIVIDE: case MODULO: return 6;
+        case POWER: return 7;
+        default: return -1;
+        }
+    }
+
+    static constexpr bool isRightAssociative(Opcode opcode)
+    {
+        return opcode == POWER;
+    }
+
+    // Expression compiled to RPN. N bounds the number of instructions, constants and
+    // variables; compile uses the length of the source.
+    template <size_t N>
+    struct Program
+    {
+        const char* source = nullptr;
+        Instruction code[N] = {};
+        // Stack depth in front of each instruction.
+        size_t depth[N] = {};
+        Value constants[N] = {};
+        // Position of the name of each variable in source.
+        size_t variableOffset[N] = {};
+        size_t variableLength[N] = {};
+        size_t size = 0;
+        size_t constantCount = 0;
+        size_t variableCount = 0;
+        size_t maxDepth = 0;
+
+        // Returns the slot of the named variable, or -1 if the expression does not use it.
+        constexpr int slot(const char* name) const
+        {
+            for (size_t v = 0; v < variableCount; ++v) {
+                size_t k = 0;
+                while (k < variableLength[v] && name[k] == source[variableOffset[v] + k])
+                    ++k;
+                if (k == variableLength[v] && name[k] == 0)
+                    return static_cast<int>(v);
+            }
+            return -1;
+        }
+
+        // Runs the program with values[i] bound to slot i; also usable in constant expressions.
+        constexpr Value evaluate(const long double* values = nullptr) const
+        {
+            if (variableCount > 0 && values == nullptr)
+                throw std::runtime_error("Variable is not bound");
+            Value stack[N] = {};
+            size_t top = 0;
+            for (size_t k = 0; k < size; ++k) {
+                const Instruction& instruction = code[k];
+                if (instruction.opcode == PUSH_CONSTANT)
+                    stack[top++] = constants[instruction.operand];
+                else if (instruction.opcode == PUSH_VARIABLE)
+                    stack[top++] = Value::Float(values[instruction.operand]);
+                else {
+                    top -= instruction.arity;
+                    stack[top] = apply(instruction.opcode, stack + top, instruction.arity);
+                    ++top;
+                }
+            }
+            return stack[0];
+        }
+    };
+
+    // Compiles an infix expression given as a string literal.
+    template <size_t N>
+    static constexpr Program<N> compile(const char (&source)[N])
+    {
+        return compile<N>(source, N - 1);
+    }
+
+    // Compiles length characters of source; N must be larger than length.
+    template <size_t N>
+    static constexpr Program<N> compile(const char* source, size_t length);
+
+    // Evaluates an expression without variables.
+    template <size_t N>
+    static constexpr long double evaluate(const char (&source)[N])
+    {
+        return compile(source).evaluate().as_float();
+    }
+
+    // Evaluates an expression without variables whose result is an integer.
+    template <size_t N>
+    static constexpr long long evaluate_integer(const char (&source)[N])
+    {
+        const Value result = compile(source).evaluate();
+        if (!result.integral)
+            throw std::runtime_error("Result is not an integer");
+        return result.i;
+    }
+
+    // Applies an operator or function to count arguments. OpcodeType is Opcode, or a
+    // std::integral_constant of it, for which the switch is resolved at compile time and
+    // only the code of that one opcode remains.
+    template <class OpcodeType>
+    static constexpr Value apply(OpcodeType opcode, const Value* args, int count);
+
+    // Runs the program of Expression, a type with a static constexpr function program()
+    // returning a Program (see RPN_CONSTEXPR_EXPRESSION), as code specialized for it.
+    template <class Expression>
+    class Evaluator
+    {
+        static constexpr size_t instructionCount = Expression::program().size;
+        static constexpr size_t stackSize = Expression::program().maxDepth;
+
+        template <size_t I>
+        static void step(Value* stack, const long double* values)
+        {
+            constexpr Instruction instruction = Expression::program().code[I];
+            constexpr size_t top = Expression::program().depth[I];
+            constexpr Value constant = Expression::program().constants[instruction.opcode == PUSH_CONSTANT ? instruction.operand : 0];
+            if (instruction.opcode == PUSH_CONSTANT)
+                stack[top] = constant;
+            else if (instruction.opcode == PUSH_VARIABLE)
+                stack[top] = Value::Float(values[instruction.operand]);
+            else
+                stack[top - instruction.arity] = apply(std::integral_constant<Opcode, instruction.opcode>(),
+                    stack + top - instruction.arity, instruction.arity);
+        }
+
+        template <size_t... I>
+        static Value run(const long double* values, std::index_sequence<I...>)
+        {
+            Value stack[stackSize];
+            const int steps[] = { 0, (step<I>(stack, values), 0)... };
+            (void)steps;
+            return stack[0];
+        }
+
+    public:
+        // Runs the program with values[i] bound to slot i; values may only be null for
+        // expressions without variables.
+        static Value evaluate_value(const long double* values)
+        {
+            return run(values, std::make_index_sequence<instructionCount>());
+        }
+
+        static long double evaluate(const long double* values = nullptr)
+        {
+            return evaluate_value(values).as_float();
+        }
+
+        // Runs the program with the arguments bound to the slots in order.
+        template <class... Args>
+        static long double evaluate(long double first, Args... rest)
+        {
+            const long double values[] = { first, static_cast<long double>(rest)... };
+            return evaluate_value(values).as_float();
+        }
+    };
+
+private:
+    // Math functions
+
+    static constexpr long double pi()
+    {
+        return 3.141592653589793238462643383279502884L;
+    }
+
+    static constexpr long double ln2()
+    {
+        return 0.693147180559945309417232121458176568L;
+    }
+
+    static constexpr long double infinity()
+    {
+        return std::numeric_limits<long double>::infinity();
+    }
+
+    static constexpr long double nan()
+    {
+        return std::numeric_limits<long double>::quiet_NaN();
+    }
+
+    static constexpr bool isNan(long double x)
+    {
+        return x != x;
+    }
+
+    static constexpr bool isInfinite(long double x)
+    {
+        return x == infinity() || x == -infinity();
+    }
+
+    // x * 2^exponent, for a finite result.
+    static constexpr long double scale(long double x, long exponent)
+    {
+        long double factor = exponent < 0 ? 0.5L : 2.0L;
+        unsigned long count = static_cast<unsigned long>(exponent < 0 ? -exponent : exponent);
+        while (count != 0) {
+            if (count & 1)
+                x *= factor;
+            count >>= 1;
+            if (count != 0)
+                factor *= factor;
+        }
+        return x;
+    }
+
+    // Splits a positive finite x into m * 2^exponent with m in [1, 2).
+    static constexpr long double split(long double x, long& exponent)
+    {
+        exponent = 0;
+        while (x >= 4294967296.0L) {
+            x *= 2.3283064365386962890625e-10L;
+            exponent += 32;
+        }
+        while (x < 2.3283064365386962890625e-10L) {
+            x *= 4294967296.0L;
+            exponent -= 32;
+        }
+        while (x >= 2) {
+            x *= 0.5L;
+            ++exponent;
+        }
+        while (x < 1) {
+            x *= 2;
+            --exponent;
+        }
+        return x;
+    }
+
+    static constexpr long double floor(long double x)
+    {
+        if (isNan(x) || x >= 4611686018427387904.0L || x <= -4611686018427387904.0L)
+            return x;
+        long double truncated = static_cast<long double>(static_cast<long long>(x));
+        return truncated > x ? truncated - 1 : truncated;
+    }
+
+    static constexpr long double ceil(long double x)
+    {
+        return -floor(-x);
+    }
+
+    static constexpr long double abs(long double x)
+    {
+        return x < 0 ? -x : x;
+    }
+
+    static constexpr long double sqrt(long double x)
+    {
+        if (isNan(x) || x < 0)
+            return nan();
+        if (x == 0 || isInfinite(x))
+            return x;
+        long exponent = 0;
+        long double m = split(x, exponent);
+        if (exponent & 1) {
+            m *= 2;
+            --exponent;
+        }
+        // m in [1, 4): Newton's iteration from 1.5 converges to full precision in 6 steps.
+        long double root = 1.5L;
+        for (int k = 0; k < 7; ++k)
+            root = (root + m / root) / 2;
+        return scale(root, exponent / 2);
+    }
+
+    static constexpr long double exp(long double x)
+    {
+        if (isNan(x))
+            return x;
+        const long double limit = std::numeric_limits<long double>::max_exponent * ln2();
+        if (x >= limit)
+            return infinity();
+        if (x <= -limit - std::numeric_limits<long double>::digits * ln2())
+            return 0;
+        // x = k ln2 + r with |r| <= ln2 / 2; e^x = 2^k e^r.
+        const long double k = floor(x / ln2() + 0.5L);
+        const long double r = x - k * 0.693145751953125L - k * 1.428606820309417232121458176568e-6L;
+        long double sum = 1, term = 1;
+        for (int n = 1; n < 30 && term != 0; ++n) {
+            term *= r / n;
+            sum += term;
+        }
+        return scale(sum, static_cast<long>(k));
+    }
+
+    static constexpr long double ln(long double x)
+    {
+        if (isNan(x) || x < 0)
+            return nan();
+        if (x == 0)
+            return -infinity();
+        if (isInfinite(x))
+            return x;
+        long exponent = 0;
+        long double m = split(x, exponent);
+        if (m > 1.41421356237309504880L) {
+            m /= 2;
+            ++exponent;
+        }
+        // ln m = 2 atanh(s) with s = (m - 1) / (m + 1), |s| <= 0.172.
+        const long double s = (m - 1) / (m + 1);
+        const long double s2 = s * s;
+        long double sum = 0, power = s;
+        for (int n = 1; n < 60; n += 2) {
+            sum += power / n;
+            power *= s2;
+        }
+        return exponent * 0.693145751953125L + (2 * sum + exponent * 1.428606820309417232121458176568e-6L);
+    }
+
+    // Sine and cosine of |r| <= pi/4.
+    static constexpr long double sinSeries(long double r)
+    {
+        long double sum = r, term = r;
+        for (int n = 2; n < 40; n += 2) {
+            term *= -r * r / (n * (n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static constexpr long double cosSeries(long double r)
+    {
+        long double sum = 1, term = 1;
+        for (int n = 1; n < 40; n += 2) {
+            term *= -r * r / (n * (n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Remainder of x modulo 2 pi, for |x| >= 2^28. The division by C, 2 pi rounded to 53 bits
+    // so that it is exact in double as well, is exact; the quotient then corrects for the
+    // difference between C and 2 pi. Beyond 2^63 the quotient no longer fits and the result
+    // is only the remainder modulo C.
+    static constexpr long double reduceLarge(long double x)
+    {
+        const long double C = 6.28318530717958623199592693708837032318115234375L;
+        const long double D = 2.44929359829470635445213186455000211641949889184615633e-16L;
+        const bool negative = x < 0;
+        long double rest = negative ? -x : x;
+        long double divisor = C;
+        int k = 0;
+        while (divisor <= rest / 2) {
+            divisor *= 2;
+            ++k;
+        }
+        unsigned long long quotient = 0;
+        for (; k >= 0; --k) {
+            quotient <<= 1;
+            // rest < 2 * divisor, so the subtraction is exact.
+            if (rest >= divisor) {
+                rest -= divisor;
+                quotient |= 1;
+            }
+            divisor /= 2;
+        }
+        rest -= static_cast<long double>(quotient) * D;
+        return negative ? -rest : rest;
+    }
+
+    // sin(x) for quadrantOffset 0 and cos(x) for 1: reduces x by multiples of pi/2.
+    static constexpr long double sinCos(long double x, int quadrantOffset)
+    {
+        if (isNan(x) || isInfinite(x))
+            return nan();
+        if (x >= 268435456.0L || x <= -268435456.0L)
+            x = reduceLarge(x);
+        const long double n = floor(x / (pi() / 2) + 0.5L);
+        // pi/2 in three parts; n times each of the first two is exact.
+        const long double r = ((x - n * 1.5707962512969970703125L) - n * 7.549789415861596353352069854736328125e-8L) -
+            n * 5.39030285815811905289473530344968755291048747229615e-15L;
+        const long double quadrant = n - 4 * floor(n / 4);
+        switch ((static_cast<int>(quadrant) + quadrantOffset) & 3) {
+        case 0: return sinSeries(r);
+        case 1: return cosSeries(r);
+        case 2: return -sinSeries(r);
+        default: return -cosSeries(r);
+        }
+    }
+
+    static constexpr long double atan(long double x)
+    {
+        if (isNan(x))
+            return x;
+        if (x < 0)
+            return -atan(-x);
+        if (x > 1)
+            return isInfinite(x) ? pi() / 2 : pi() / 2 - atan(1 / x);
+        // atan x = pi/6 + atan((x sqrt3 - 1) / (x + sqrt3)) brings x below tan(pi/12).
+        const long double sqrt3 = 1.73205080756887729352744634150587237L;
+        long double offset = 0;
+        if (x > 0.26794919243112270647L) {
+            x = (x * sqrt3 - 1) / (x + sqrt3);
+            offset = pi() / 6;
+        }
+        long double sum = 0, power = x;
+        for (int n = 1; n < 60; n += 2) {
+            sum += (n & 2 ? -power : power) / n;
+            power *= x * x;
+        }
+        return offset + sum;
+    }
+
+    static constexpr long double asin(long double x)
+    {
+        if (isNan(x) || x > 1 || x < -1)
+            return nan();
+        if (x == 1 || x == -1)
+            return x * (pi() / 2);
+        return atan(x / sqrt((1 - x) * (1 + x)));
+    }
+
+    static constexpr long double pow(long double x, long double y)
+    {
+        if (y == 0 || x == 1)
+            return 1;
+        if (isNan(x) || isNan(y))
+            return nan();
+        if (isInfinite(y))
+            return abs(x) == 1 ? 1 : (abs(x) > 1) == (y > 0) ? infinity() : 0;
+        const bool integralExponent = floor(y) == y;
+        const bool oddExponent = integralExponent && abs(y) < 9223372036854775808.0L && (static_cast<long long>(y) & 1) != 0;
+        if (x == 0 || isInfinite(x)) {
+            const bool large = (x != 0) == (y > 0);
+            const long double magnitude = large ? infinity() : 0;
+            return x < 0 && oddExponent ? -magnitude : magnitude;
+        }
+        if (x < 0 && !integralExponent)
+            return nan();
+        if (integralExponent && abs(y) <= 1024) {
+            // Repeated squaring is exact or nearly so for small exponents.
+            long double result = 1, base = x;
+            for (long long n = static_cast<long long>(abs(y)); n != 0; n >>= 1) {
+                if (n & 1)
+                    result *= base;
+                if (n > 1)
+                    base *= base;
+            }
+            return y < 0 ? 1 / result : result;
+        }
+        const long double magnitude = exp(y * ln(abs(x)));
+        return x < 0 && oddExponent ? -magnitude : magnitude;
+    }
+
+    // Integer operations, as RpnValue and ArithmeticOperator.
+
+    static constexpr bool multiplyExact(long long a, long long b, long long& product)
+    {
+        const long long small = 1LL << 31;
+        if ((a < small && a >= -small && b < small && b >= -small) ||
+            a == 0 || b == 0 ||
+            (a > 0 ? (b > 0 ? a <= LLONG_MAX / b : b >= LLONG_MIN / a) :
+                     (b > 0 ? a >= LLONG_MIN / b : a >= LLONG_MAX / b))) {
+            product = static_cast<long long>(static_cast<unsigned long long>(a) * static_cast<unsigned long long>(b));
+            return true;
+        }
+        return false;
+    }
+
+    static constexpr bool integerPower(long long base, long long exponent, long long& power)
+    {
+        if (exponent < 0)
+            return false;
+        power = 1;
+        while (exponent > 0) {
+            if ((exponent & 1) && !multiplyExact(power, base, power))
+                return false;
+            exponent >>= 1;
+            if (exponent > 0 && !multiplyExact(base, base, base))
+                return false;
+        }
+        return true;
+    }
+
+    static constexpr long long shiftRight(long long value, long long count);
+
+    static constexpr long long shiftLeft(long long value, long long count)
+    {
+        if (count < 0)
+            return shiftRight(value, count == LLONG_MIN ? LLONG_MAX : -count);
+        return count >= 64 ? 0 : static_cast<long long>(static_cast<unsigned long long>(value) << count);
+    }
+
+    static constexpr long double divide(long double a, long double b)
+    {
+        if (b != 0 || isNan(b))
+            return a / b;
+        return isNan(a) || a == 0 ? nan() : a > 0 ? infinity() : -infinity();
+    }
+
+    // Lexer
+
+    static constexpr bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static constexpr bool isAlpha(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    static constexpr bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    static constexpr char lower(char c)
+    {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    // Value of c as a digit in base 36, or 36 if it is not a digit.
+    static constexpr unsigned digitValue(char c)
+    {
+        return isDigit(c) ? static_cast<unsigned>(c - '0') :
+            lower(c) >= 'a' && lower(c) <= 'z' ? static_cast<unsigned>(lower(c) - 'a' + 10) : 36;
+    }
+
+    // End of the numeric literal starting at pos, or pos; the rules of the runtime lexer.
+    static constexpr size_t scanNumber(const char* s, size_t n, size_t pos)
+    {
+        const size_t i = pos;
+        if (s[i] == '0' && i + 2 < n) {
+            const char p = lower(s[i + 1]);
+            const unsigned radix = p == 'x' ? 16 : p == 'o' ? 8 : p == 'b' ? 2 : 0;
+            if (radix != 0) {
+                size_t j = i + 2;
+                while (j < n && digitValue(s[j]) < radix)
+                    ++j;
+                if (j > i + 2)
+                    return j;
+            }
+        }
+        if (isDigit(s[i])) {
+            const char suffixes[] = { 'h', 'o', 'b' };
+            const unsigned radixes[] = { 16, 8, 2 };
+            for (int r = 0; r < 3; ++r) {
+                size_t j = i;
+                while (j < n && digitValue(s[j]) < radixes[r])
+                    ++j;
+                if (j < n && lower(s[j]) == suffixes[r])
+                    return j + 1;
+            }
+        }
+        size_t j = i;
+        while (j < n && isDigit(s[j]))
+            ++j;
+        bool hasDigits = j > i;
+        if (j < n && s[j] == '.') {
+            size_t k = j + 1;
+            while (k < n && isDigit(s[k]))
+                ++k;
+            hasDigits = hasDigits || k > j + 1;
+            j = k;
+        }
+        if (!hasDigits)
+            return pos;
+        if (j < n && lower(s[j]) == 'e') {
+            size_t k = j + 1;
+            if (k < n && (s[k] == '+' || s[k] == '-'))
+                ++k;
+            if (k < n && isDigit(s[k])) {
+                while (k < n && isDigit(s[k]))
+                    ++k;
+                j = k;
+            }
+        }
+        return j;
+    }
+
+    // Value of the numeric literal [begin, end) found by scanNumber; the rules of Numeric::parse.
+    static constexpr Value parseNumber(const char* s, size_t begin, size_t end, bool negative)
+    {
+        size_t p = begin;
+        unsigned shift = 0;
+        size_t digits = p, digitsEnd = end;
+        if (end - p > 2 && s[p] == '0') {
+            const char prefix = lower(s[p + 1]);
+            shift = prefix == 'x' ? 4 : prefix == 'o' ? 3 : prefix == 'b' ? 1 : 0;
+            digits = p + 2;
+        }
+        if (shift == 0) {
+            const char suffix = lower(s[end - 1]);
+            shift = suffix == 'h' || suffix == 'x' ? 4 : suffix == 'o' ? 3 : suffix == 'b' ? 1 : 0;
+            digits = p;
+            digitsEnd = end - 1;
+        }
+        if (shift != 0) {
+            unsigned long long bits = 0;
+            for (size_t k = digits; k < digitsEnd; ++k) {
+                if (bits >> (64 - shift))
+                    throw std::runtime_error("Numeric literal does not fit in 64 bits");
+                bits = bits << shift | digitValue(s[k]);
+            }
+            return Value::Integer(static_cast<long long>(negative ? 0 - bits : bits));
+        }
+
+        unsigned long long mantissa = 0;
+        int significant = 0;
+        long exponent = 0;
+        bool integral = true;
+        for (; p < end && isDigit(s[p]); ++p) {
+            const unsigned digit = static_cast<unsigned>(s[p] - '0');
+            if (mantissa == 0 && digit == 0)
+                continue;
+            if (significant < 19) {
+                mantissa = mantissa * 10 + digit;
+                ++significant;
+            }
+            else
+                ++exponent;
+        }
+        if (p < end && s[p] == '.') {
+            integral = false;
+            for (++p; p < end && isDigit(s[p]); ++p) {
+                const unsigned digit = static_cast<unsigned>(s[p] - '0');
+                if (significant < 19 && (mantissa != 0 || digit != 0)) {
+                    mantissa = mantissa * 10 + digit;
+                    ++significant;
+                    --exponent;
+                }
+                else if (mantissa == 0)
+                    --exponent;
+            }
+        }
+        if (p < end && lower(s[p]) == 'e') {
+            integral = false;
+            ++p;
+            bool negativeExponent = false;
+            if (s[p] == '-' || s[p] == '+')
+                negativeExponent = s[p++] == '-';
+            long written = 0;
+            for (; p < end; ++p)
+                written = written < 100000 ? written * 10 + (s[p] - '0') : written;
+            exponent += negativeExponent ? -written : written;
+        }
+        if (integral && exponent == 0 && mantissa <= static_cast<unsigned long long>(LLONG_MAX) + negative)
+            return Value::Integer(static_cast<long long>(negative ? 0 - mantissa : mantissa));
+
+        long double value = static_cast<long double>(mantissa);
+        if (mantissa != 0) {
+            // One multiplication or division by an exact power of ten rounds correctly;
+            // larger exponents are applied in steps.
+            const long maxExactPower = std::numeric_limits<long double>::digits >= 64 ? 27 : 22;
+            long remaining = exponent < 0 ? -exponent : exponent;
+            while (remaining > 0 && value != 0 && !isInfinite(value)) {
+                const long step = remaining < maxExactPower ? remaining : maxExactPower;
+                long double power = 1;
+                for (long k = 0; k < step; ++k)
+                    power *= 10;
+                if (exponent < 0)
+                    value /= power;
+                else if (value > std::numeric_limits<long double>::max() / power)
+                    value = infinity();
+                else
+                    value *= power;
+                remaining -= step;
+            }
+        }
+        return Value::Float(negative ? -value : value);
+    }
+
+    // Operator starting at s[i]; returns its length, or 0.
+    static constexpr size_t scanOperator(const char* s, size_t n, size_t i, Opcode& opcode)
+    {
+        const char c = s[i];
+        const char next = i + 1 < n ? s[i + 1] : 0;
+        if (c == '*' && next == '*') { opcode = POWER; return 2; }
+        if (c == '<' && next == '<') { opcode = SHIFT_LEFT; return 2; }
+        if (c == '>' && next == '>') { opcode = SHIFT_RIGHT; return 2; }
+        switch (c) {
+        case '+': opcode = ADD; return 1;
+        case '-': opcode = SUBTRACT; return 1;
+        case '*': opcode = MULTIPLY; return 1;
+        case '/': opcode = DIVIDE; return 1;
+        case '%': opcode = MODULO; return 1;
+        case '|': opcode = OR; return 1;
+        case '&': opcode = AND; return 1;
+        case '^': opcode = XOR; return 1;
+        default: return 0;
+        }
+    }
+
+    static constexpr const char* functionName(int opcode)
+    {
+        switch (opcode) {
+        case SIN: return "sin";
+        case ASIN: return "asin";
+        case COS: return "cos";
+        case ACOS: return "acos";
+        case TAN: return "tan";
+        case ATAN: return "atan";
+        case LN: return "ln";
+        case LG: return "lg";
+        case EXPN: return "expn";
+        case SQRT: return "sqrt";
+        case ABS: return "abs";
+        case FLOOR: return "floor";
+        case CEIL: return "ceil";
+        case G2R: return "g2r";
+        case R2G: return "r2g";
+        case C2F: return "c2f";
+        case F2C: return "f2c";
+        case LOG: return "log";
+        case POW: return "pow";
+        case AVG: return "avg";
+        default: return "";
+        }
+    }
+
+    // Parameter count of a function, -1 for avg.
+    static constexpr int functionArity(Opcode opcode)
+    {
+        return opcode == AVG ? -1 : opcode == LOG || opcode == POW ? 2 : 1;
+    }
+
+    // Function named s[begin, end), ignoring case; OPCODE_COUNT if there is none.
+    static constexpr Opcode findFunction(const char* s, size_t begin, size_t end)
+    {
+        for (int opcode = SIN; opcode < OPCODE_COUNT; ++opcode) {
+            const char* name = functionName(opcode);
+            size_t k = 0;
+            while (begin + k < end && name[k] != 0 && lower(s[begin + k]) == name[k])
+                ++k;
+            if (begin + k == end && name[k] == 0)
+                return static_cast<Opcode>(opcode);
+        }
+        return OPCODE_COUNT;
+    }
+
+    // Pending entry of the shunting-yard operator stack.
+    struct Pending
+    {
+        enum Kind : unsigned char { OPERATOR, FUNCTION, BRACKET };
+        Kind kind = OPERATOR;
+        Opcode opcode = PUSH_CONSTANT;
+        char bracket = 0;
+    };
+
+    template <size_t N>
+    static constexpr void emit(Program<N>& program, Opcode opcode, int operand, int arity)
+    {
+        if (program.size == N)
+            throw std::runtime_error("Invalid expression");
+        Instruction& instruction = program.code[program.size];
+        instruction.opcode = opcode;
+        instruction.operand = operand;
+        instruction.arity = arity;
+        program.size++;
+    }
+
+    template <size_t N>
+    static constexpr void emitPending(Program<N>& program, const Pending& pending)
+    {
+        if (pending.kind == Pending::OPERATOR)
+            emit(program, pending.opcode, 0, 2);
+        else if (functionArity(pending.opcode) < 0)
+            throw std::runtime_error("Invalid expression");
+        else
+            emit(program, pending.opcode, 0, functionArity(pending.opcode));
+    }
+};
+
+template <size_t N>
+constexpr RpnConstexpr::Program<N> RpnConstexpr::compile(const char* s, size_t n)
+{
+    if (n >= N)
+        throw std::runtime_error("Expression is too long");
+    Program<N> program;
+    program.source = s;
+    Pending pending[N] = {};
+    size_t pendingCount = 0;
+    // Parameter counts of the open function calls.
+    int arities[N] = {};
+    size_t arityCount = 0;
+    bool operandExpected = true;
+
+    size_t i = 0;
+    while (i < n) {
+        const char c = s[i];
+        const size_t start = i;
+        if (isSpace(c)) {
+            ++i;
+            continue;
+        }
+        if (isDigit(c) || c == '.') {
+            i = scanNumber(s, n, i);
+            if (i == start)
+                throw std::runtime_error("Unknown token");
+            program.constants[program.constantCount] = parseNumber(s, start, i, false);
+            emit(program, PUSH_CONSTANT, static_cast<int>(program.constantCount++), 0);
+            operandExpected = false;
+            continue;
+        }
+        if (isAlpha(c)) {
+            while (i < n && (isAlpha(s[i]) || isDigit(s[i])))
+                ++i;
+            const Opcode function = findFunction(s, start, i);
+            if (function != OPCODE_COUNT) {
+                pending[pendingCount].kind = Pending::FUNCTION;
+                pending[pendingCount++].opcode = function;
+                arities[arityCount++] = 0;
+                operandExpected = false;
+                continue;
+            }
+            size_t next = i;
+            while (next < n && isSpace(s[next]))
+                ++next;
+            if (next < n && (s[next] == '(' || s[next] == '[' || s[next] == '{'))
+                throw std::runtime_error("Unknown function");
+            size_t slot = 0;
+            for (; slot < program.variableCount; ++slot) {
+                size_t k = 0;
+                while (k < program.variableLength[slot] && start + k < i && s[start + k] == s[program.variableOffset[slot] + k])
+                    ++k;
+                if (k == program.variableLength[slot] && k == i - start)
+                    break;
+            }
+            if (slot == program.variableCount) {
+                program.variableOffset[slot] = start;
+                program.variableLength[slot] = i - start;
+                program.variableCount++;
+            }
+            emit(program, PUSH_VARIABLE, static_cast<int>(slot), 0);
+            operandExpected = false;
+            continue;
+        }
+        if (c == '"')
+            throw std::runtime_error("String literals are not supported at compile time");
+        if (c == '(' || c == '[' || c == '{') {
+            pending[pendingCount].kind = Pending::BRACKET;
+            pending[pendingCount++].bracket = c;
+            ++i;
+            operandExpected = true;
+            continue;
+        }
+        if (c == ')' || c == ']' || c == '}') {
+            const char opening = c == ')' ? '(' : c == ']' ? '[' : '{';
+            while (pendingCount > 0 && pending[pendingCount - 1].kind != Pending::BRACKET)
+                emitPending(program, pending[--pendingCount]);
+            if (pendingCount == 0 || pending[pendingCount - 1].bracket != opening)
+                throw std::runtime_error("Mismatched parentheses/brackets/braces");
+            --pendingCount;
+            if (pendingCount > 0 && pending[pendingCount - 1].kind == Pending::FUNCTION) {
+                const Opcode function = pending[--pendingCount].opcode;
+                int parameters = 1;
+                if (arityCount > 0)
+                    parameters = arities[--arityCount] + 1;
+                emit(program, function, 0, functionArity(function) < 0 ? parameters : functionArity(function));
+            }
+            ++i;
+            operandExpected = false;
+            continue;
+        }
+        if (c == ',') {
+            while (pendingCount > 0 && pending[pendingCount - 1].kind != Pending::BRACKET)
+                emitPending(program, pending[--pendingCount]);
+            if (arityCount > 0)
+                arities[arityCount - 1]++;
+            ++i;
+            operandExpected = true;
+            continue;
+        }
+        if (c == '-' && operandExpected) {
+            // Unary minus directly in front of a number is part of the literal.
+            size_t j = i + 1;
+            while (j < n && isSpace(s[j]))
+                ++j;
+            const size_t end = j < n ? scanNumber(s, n, j) : j;
+            if (end != j) {
+                program.constants[program.constantCount] = parseNumber(s, j, end, true);
+                emit(program, PUSH_CONSTANT, static_cast<int>(program.constantCount++), 0);
+                i = end;
+                operandExpected = false;
+                continue;
+            }
+        }
+        Opcode opcode = PUSH_CONSTANT;
+        const size_t length = scanOperator(s, n, i, opcode);
+        if (length == 0)
+            throw std::runtime_error("Unknown token");
+        while (pendingCount > 0 && pending[pendingCount - 1].kind == Pending::OPERATOR) {
+            const Opcode top = pending[pendingCount - 1].opcode;
+            if (!(precedence(top) > precedence(opcode) ||
+                (precedence(top) == precedence(opcode) && !isRightAssociative(opcode))))
+                break;
+            emitPending(program, pending[--pendingCount]);
+        }
+        pending[pendingCount].kind = Pending::OPERATOR;
+        pending[pendingCount++].opcode = opcode;
+        i += length;
+        operandExpected = true;
+    }
+    while (pendingCount > 0) {
+        if (pending[pendingCount - 1].kind == Pending::BRACKET)
+            throw std::runtime_error("Mismatched parentheses/brackets/braces");
+        emitPending(program, pending[--pendingCount]);
+    }
+
+    // Check the stack effect of the program and record the depth in front of each instruction.
+    size_t top = 0;
+    for (size_t k = 0; k < program.size; ++k) {
+        const Instruction& instruction = program.code[k];
+        if (static_cast<size_t>(instruction.arity) > top || (instruction.arity == 0 && instruction.opcode > PUSH_VARIABLE))
+            throw std::runtime_error("Invalid expression");
+        program.depth[k] = top;
+        top = top - instruction.arity + 1;
+        program.maxDepth = top > program.maxDepth ? top : program.maxDepth;
+    }
+    if (top != 1)
+        throw std::runtime_error("Invalid expression");
+    return program;
+}
+
+constexpr long long RpnConstexpr::shiftRight(long long value, long long count)
+{
+    if (count < 0)
+        return shiftLeft(value, count == LLONG_MIN ? LLONG_MAX : -count);
+    if (count >= 64)
+        return value < 0 ? -1 : 0;
+    return value < 0 ? ~(~value >> count) : value >> count;
+}
+
+template <class OpcodeType>
+constexpr RpnConstexpr::Value RpnConstexpr::apply(OpcodeType opcode, const Value* args, int count)
+{
+    const Value& a = args[0];
+    const Value& b = args[count > 1 ? 1 : 0];
+    const bool integers = a.integral && b.integral;
+    long long exact = 0;
+    switch (static_cast<Opcode>(opcode)) {
+    case ADD:
+        if (integers) {
+            exact = static_cast<long long>(static_cast<unsigned long long>(a.i) + static_cast<unsigned long long>(b.i));
+            if (((a.i ^ exact) & (b.i ^ exact)) >= 0)
+                return Value::Integer(exact);
+        }
+        return Value::Float(a.as_float() + b.as_float());
+    case SUBTRACT:
+        if (integers) {
+            exact = static_cast<long long>(static_cast<unsigned long long>(a.i) - static_cast<unsigned long long>(b.i));
+            if (((a.i ^ b.i) & (a.i ^ exact)) >= 0)
+                return Value::Integer(exact);
+        }
+        return Value::Float(a.as_float() - b.as_float());
+    case MULTIPLY:
+        if (integers && multiplyExact(a.i, b.i, exact))
+            return Value::Integer(exact);
+        return Value::Float(a.as_float() * b.as_float());
+    case DIVIDE:
+        return Value::Float(divide(a.as_float(), b.as_float()));
+    case MODULO:
+        if (b.as_integer() == 0)
+            throw std::runtime_error("Division by zero");
+        return Value::Integer(b.as_integer() == -1 ? 0 : a.as_integer() % b.as_integer());
+    case OR:
+        return Value::Integer(a.as_integer() | b.as_integer());
+    case XOR:
+        return Value::Integer(a.as_integer() ^ b.as_integer());
+    case AND:
+        return Value::Integer(a.as_integer() & b.as_integer());
+    case SHIFT_LEFT:
+        return Value::Integer(shiftLeft(a.as_integer(), b.as_integer()));
+    case SHIFT_RIGHT:
+        return Value::Integer(shiftRight(a.as_integer(), b.as_integer()));
+    case POWER:
+        if (integers && integerPower(a.i, b.i, exact))
+            return Value::Integer(exact);
+        return Value::Float(pow(a.as_float(), b.as_float()));
+    case SIN: return Value::Float(sinCos(a.as_float(), 0));
+    case COS: return Value::Float(sinCos(a.as_float(), 1));
+    case TAN: return Value::Float(divide(sinCos(a.as_float(), 0), sinCos(a.as_float(), 1)));
+    case ASIN: return Value::Float(asin(a.as_float()));
+    case ACOS: return Value::Float(pi() / 2 - asin(a.as_float()));
+    case ATAN: return Value::Float(atan(a.as_float()));
+    case LN: return Value::Float(ln(a.as_float()));
+    case LG: return Value::Float(ln(a.as_float()) / 2.302585092994045684017991454684364208L);
+    case EXPN: return Value::Float(exp(a.as_float()));
+    case SQRT: return Value::Float(sqrt(a.as_float()));
+    case ABS: return Value::Float(abs(a.as_float()));
+    case FLOOR: return Value::Float(floor(a.as_float()));
+    case CEIL: return Value::Float(ceil(a.as_float()));
+    // The runtime converts with pi and 1.8 in double precision.
+    case G2R: return Value::Float(a.as_float() * 3.141592653589793 / 180.0);
+    case R2G: return Value::Float(a.as_float() * 180.0 / 3.141592653589793);
+    case C2F: return Value::Float(1.8 * a.as_float() + 32);
+    case F2C: return Value::Float((a.as_float() - 32) / 1.8);
+    case LOG: return Value::Float(divide(ln(a.as_float()), ln(b.as_float())));
+    case POW: return Value::Float(pow(a.as_float(), b.as_float()));
+    case AVG:
+    {
+        long double sum = 0;
+        for (int k = 0; k < count; ++k)
+            sum += args[k].as_float();
+        return Value::Float(sum / count);
+    }
+    default:
+        throw std::runtime_error("Invalid expression");
+    }
+}
+
+// Declares a type for RpnConstexpr::Evaluator holding the program of an expression.
+#define RPN_CONSTEXPR_EXPRESSION(name, text) \
+    struct name \
+    { \
+        static constexpr auto program() \
+        { \
+            return RpnConstexpr::compile(text); \
+        } \
+    }
@@ -27,9 +27,14 @@
 #include <string>
 #include <memory>
 #include <unordered_map>
+#include <vector>
+#include "RpnValue.h"
+#include "RpnSimd.h"
 
 
-#ifdef RPN_EXPORTS
+#if !defined(_WIN32)
+#define RPN_API
+#elif defined(RPN_EXPORTS)
 #define RPN_API __declspec(dllexport)
 #else
 #define RPN_API __declspec(dllimport)
@@ -38,6 +43,9 @@
 // Interface representing operator information for the FunctionShuntingYard class.
 // This interface defines the contract for operators, including their precedence,
 // associativity, number of parameters, and calculation logic.
+// A frozen RpnCalculator may call calculate from several threads at once, so
+// implementations must not keep per-call state in members. Precedence, associativity and
+// the number of parameters are read once, when the operator is registered.
 class RPN_API IOperatorInfo
 {
 public:
@@ -60,12 +68,84 @@ public:
     // Returns:
     // - A string representing the result of the calculation.
     virtual std::string calculate(const std::vector<std::string>& args) = 0;
+
+    // Virtual functions added after the original interface go below, so that the slots of
+    // the ones above stay where prebuilt plugins expect them.
+
+    // Returns whether the result depends only on the operands. Pure operators applied to
+    // constants are evaluated once, when the expression is compiled.
+    virtual bool isPure()
+    {
+        return true;
+    }
+};
+
+
+// Floating point operation with a fixed meaning, reported by typed operators and functions
+// so that code generators such as RpnJit can emit it directly instead of calling calculate.
+struct RpnNativeOperation
+{
+    enum Kind
+    {
+        NONE,       // no native form, calculate must be called
+        ADD, SUBTRACT, MULTIPLY, DIVIDE,
+        AVERAGE,    // sum of the parameters in source order, divided by their count
+        FUNCTION,   // the standard math function given by function
+    };
+
+    Kind kind;
+    RpnSimd::Function function;
+
+    RpnNativeOperation(Kind _kind = NONE, RpnSimd::Function _function = RpnSimd::FUNCTION_COUNT)
+        : kind(_kind), function(_function)
+    {
+    }
+};
+
+// Operator that can calculate on typed values without going through strings.
+// The evaluator uses the typed calculate; the string calculate is implemented on top of it.
+class RPN_API ITypedOperatorInfo : public IOperatorInfo
+{
+public:
+    // Performs the calculation for the operator on typed operands.
+    // Args:
+    // - args: num_parameters() operands in source order, i.e. args[0] is the left operand.
+    // - result: Receives the result of the calculation.
+    virtual void calculate(const RpnValue* args, RpnValue& result) = 0;
+
+    // Returns whether calculate_block is implemented. Expressions using operators without
+    // it are batch-evaluated one row at a time.
+    virtual bool supportsBlocks()
+    {
+        return false;
+    }
+
+    // Performs the calculation over a block of rows, used by CompiledExpression::evaluate_batch.
+    // Args:
+    // - args: num_parameters() operand columns in source order, each of count values.
+    // - count: Number of rows in the block.
+    // - result: Receives count results. May be the same array as args[0].
+    virtual void calculate_block(const long double* const* /*args*/, size_t /*count*/, long double* /*result*/)
+    {
+    }
+
+    // Returns the operation calculate performs on floating point operands, if it has a native
+    // form. Operators returning anything but NONE must produce floating point results.
+    virtual RpnNativeOperation native()
+    {
+        return RpnNativeOperation();
+    }
+
+    // String interface, converts the arguments to typed values and calls the typed calculate.
+    std::string calculate(const std::vector<std::string>& args) override;
 };
 
 
 // Interface representing function information for the FunctionShuntingYard class.
 // This interface defines the contract for functions, including their arity
 // (number of parameters) and calculation logic.
+// As for operators, calculate may be called from several threads at once, and the number
+// of parameters is read once, at registration.
 class RPN_API IFunctionInfo
 {
 public:
@@ -86,6 +166,134 @@ public:
     // Returns:
     // - A string representing the result of the calculation.
     virtual std::string calculate(const std::vector<std::string>& args) = 0;
+
+    // Virtual functions added after the original interface go below, see IOperatorInfo.
+
+    // Returns whether the result depends only on the parameters. Pure functions called with
+    // constants are evaluated once, when the expression is compiled. Functions that read
+    // external state, e.g. a stock price, must return false.
+    virtual bool isPure() const
+    {
+        return true;
+    }
+
+    // Functions are owned through function_ptr_t and deleted through this interface.
+    virtual ~IFunctionInfo() = default;
+};
+
+// Function that can calculate on typed values without going through strings.
+// Calls through this interface do not allocate for numeric arguments and results.
+// The evaluator uses the typed calculate; the string calculate is implemented on top of it.
+class RPN_API ITypedFunctionInfo : public IFunctionInfo
+{
+public:
+    // Performs the calculation for the function on typed parameters.
+    // Args:
+    // - args: The parameters in source order. Contiguous, count entries.
+    // - count: Number of parameters; equals num_parameters() unless the function is variadic.
+    // - result: Receives the result of the calculation.
+    virtual void calculate(const RpnValue* args, int count, RpnValue& result) = 0;
+
+    // Returns whether calculate_block is implemented. Expressions using functions without
+    // it are batch-evaluated one row at a time.
+    virtual bool supportsBlocks() const
+    {
+        return false;
+    }
+
+    // Performs the calculation over a block of rows, used by CompiledExpression::evaluate_batch.
+    // Args:
+    // - args: The parameter columns in source order, each of rows values.
+    // - count: Number of parameters.
+    // - rows: Number of rows in the block.
+    // - result: Receives rows results. May be the same array as args[0].
+    virtual void calculate_block(const long double* const* /*args*/, int /*count*/, size_t /*rows*/, long double* /*result*/)
+    {
+    }
+
+    // Returns the operation calculate performs on floating point parameters, if it has a
+    // native form. Functions returning anything but NONE must produce floating point results.
+    virtual RpnNativeOperation native() const
+    {
+        return RpnNativeOperation();
+    }
+
+    // String interface, converts the arguments to typed values and calls the typed calculate.
+    std::string calculate(const std::vector<std::string>& args) override;
+};
+
+
+// Exposes an operator that implements only the string interface through the typed one.
+// Operands are passed as literals, the result is kept as a string value.
+class RPN_API StringOperatorAdapter : public ITypedOperatorInfo
+{
+    IOperatorInfo* target;
+public:
+    explicit StringOperatorAdapter(IOperatorInfo* _target) : target(_target)
+    {
+    }
+
+    int precedence() override
+    {
+        return target->precedence();
+    }
+
+    bool isRightAssociative() override
+    {
+        return target->isRightAssociative();
+    }
+
+    int num_parameters() override
+    {
+        return target->num_parameters();
+    }
+
+    bool isPure() override
+    {
+        return target->isPure();
+    }
+
+    void calculate(const RpnValue* args, RpnValue& result) override;
+
+    std::string calculate(const std::vector<std::string>& args) override
+    {
+        return target->calculate(args);
+    }
+};
+
+
+// Exposes a function that implements only the string interface through the typed one,
+// so that existing plugins keep working unchanged.
+// Parameters are passed as literals, the result is kept as a string value.
+class RPN_API StringFunctionAdapter : public ITypedFunctionInfo
+{
+    IFunctionInfo* target;
+public:
+    explicit StringFunctionAdapter(IFunctionInfo* _target) : target(_target)
+    {
+    }
+
+    int num_parameters() const override
+    {
+        return target->num_parameters();
+    }
+
+    std::string description() const override
+    {
+        return target->description();
+    }
+
+    bool isPure() const override
+    {
+        return target->isPure();
+    }
+
+    void calculate(const RpnValue* args, int count, RpnValue& result) override;
+
+    std::string calculate(const std::vector<std::string>& args) override
+    {
+        return target->calculate(args);
+    }
 };
 
 typedef std::unique_ptr<IOperatorInfo> operator_ptr_t;
@@ -0,0 +1,120 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <string>
+
+#if !defined(_WIN32)
+#define RPN_API
+#elif defined(RPN_EXPORTS)
+#define RPN_API __declspec(dllexport)
+#else
+#define RPN_API __declspec(dllimport)
+#endif
+
+// Conversion of floating point results to text for the public string API.
+//
+// Modes:
+//   FIXED       precision digits after the decimal point, byte for byte the output of
+//               std::to_string (precision 6, the default) or "%.*Lf", but computed with
+//               integer arithmetic for values that fit in 64 bits when scaled.
+//   SHORTEST    the fewest significant digits that read back to the same double (Grisu2).
+//               The value is rounded to double first, so long double results that differ
+//               only beyond double precision print the same. Moderate exponents are
+//               written as plain decimals without trailing zeros, e.g. "0.1", "42",
+//               "0.000001", others in exponent form, e.g. "1e-9", "1.5e+21".
+//   SCIENTIFIC  one digit, '.', precision digits and an exponent, as "%.*Le".
+// All modes write '.' regardless of the C locale, and "inf", "-inf" and "nan" for
+// non-finite values.
+//
+// Integer results of +, -, * and ** are written like a floating point result of the same
+// value ("3.000000" in the default mode) but with all digits exact; SHORTEST and
+// exactIntegers write them as integers ("3", "1311768467463790321"). Other integer results,
+// e.g. of the bitwise operators, are always written as integers.
+struct RpnFormat
+{
+    enum Mode : unsigned char
+    {
+        FIXED,
+        SHORTEST,
+        SCIENTIFIC,
+    };
+
+    Mode mode = FIXED;
+    // Digits after the decimal point for FIXED and SCIENTIFIC; ignored by SHORTEST.
+    int precision = 6;
+    // Whether integer results of +, -, * and ** are written as integers in every mode.
+    bool exactIntegers = false;
+
+    static RpnFormat Fixed(int digits)
+    {
+        RpnFormat format;
+        format.precision = digits;
+        return format;
+    }
+
+    static RpnFormat Shortest()
+    {
+        RpnFormat format;
+        format.mode = SHORTEST;
+        return format;
+    }
+
+    static RpnFormat Scientific(int digits)
+    {
+        RpnFormat format;
+        format.mode = SCIENTIFIC;
+        format.precision = digits;
+        return format;
+    }
+
+    // Returns this format with exactIntegers set.
+    RpnFormat withExactIntegers() const
+    {
+        RpnFormat format = *this;
+        format.exactIntegers = true;
+        return format;
+    }
+
+    // Appends the text of value to out.
+    RPN_API void append(long double value, std::string& out) const;
+
+    // Appends the text of an integer result of +, -, * or ** to out. FIXED writes all
+    // 64 bits exactly, followed by the decimal point and precision zeros.
+    RPN_API void appendInteger(long long value, std::string& out) const;
+
+    std::string format(long double value) const
+    {
+        std::string text;
+        append(value, text);
+        return text;
+    }
+
+    bool operator==(const RpnFormat& other) const
+    {
+        return mode == other.mode && (mode == SHORTEST || precision == other.precision) &&
+            exactIntegers == other.exactIntegers;
+    }
+};
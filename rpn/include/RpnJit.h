@@ -0,0 +1,83 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "CompiledExpression.h"
+
+// Generates x86-64 machine code for compiled programs made only of operators and functions
+// with a native form (RpnNativeOperation): + - * / **, avg and the standard math functions.
+// The code uses SSE2 scalar double instructions; sqrt, abs and the arithmetic operators are
+// emitted inline, the other math functions are calls into the C library. Each program gets
+// its own executable page, written once and then mapped read-only.
+//
+// Accuracy: every operation is rounded to double. Where long double is double, as with MSVC,
+// results are bit for bit those of the interpreter. Where long double is wider, each
+// operation may differ from the interpreter by one rounding to double (2^-53 relative),
+// and transcendental functions by the difference between the double and long double
+// versions of the C library function, at most 1 ULP of the double result with glibc.
+class RpnJit
+{
+public:
+    // Signature of the generated code.
+    // variables: variable values by slot. constants: the constant pool of the RpnJit.
+    typedef double(*Entry)(const double* variables, const double* constants);
+
+    ~RpnJit();
+    RpnJit(const RpnJit&) = delete;
+    RpnJit& operator=(const RpnJit&) = delete;
+
+    // Returns whether native code can be generated on this platform.
+    RPN_API static bool available();
+
+    // Generates native code for a program. Returns nullptr if the platform is not supported,
+    // or if the program uses string values, operators or functions without a native form,
+    // variadic calls whose parameter count is only known at run time, or computes an integer
+    // anywhere, including sub-expressions whose value feeds floating point arithmetic.
+    static std::shared_ptr<const RpnJit> compile(const CompiledProgram& program);
+
+    // Runs the code with variables bound by slot.
+    double run(const double* variables) const
+    {
+        return entry(variables, constants.data());
+    }
+
+    // Returns the size of the generated code in bytes.
+    size_t code_size() const
+    {
+        return size;
+    }
+
+private:
+    RpnJit() = default;
+
+    void* memory = nullptr;
+    size_t size = 0;
+    size_t mapped = 0;
+    Entry entry = nullptr;
+    std::vector<double> constants;
+};
@@ -0,0 +1,47 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <memory>
+#include "CompiledExpression.h"
+
+// Optimization passes over compiled RPN programs. Each pass returns a new program that
+// evaluates to the same result as its input.
+class RpnOptimizer
+{
+public:
+    // Evaluates sub-expressions whose operands are all constants and whose operators and
+    // functions are pure, and replaces them with their result.
+    static std::shared_ptr<CompiledProgram> foldConstants(const CompiledProgram& program);
+
+    // Turns the program into a DAG, computes every repeated pure sub-expression once and
+    // reuses its value through a temporary. Sets CompiledProgram::nodesSaved.
+    // Programs with variadic calls whose parameter count is only known at run time are
+    // returned unchanged. Runs after foldConstants, which does not handle temporaries.
+    static std::shared_ptr<CompiledProgram> eliminateCommonSubexpressions(const CompiledProgram& program);
+
+    // Prints a program in RPN form to the standard output, like FunctionShuntingYard::printRPN.
+    static void print(const CompiledProgram& program);
+};
@@ -0,0 +1,150 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Set RPN_STATS to 0 when building the library to compile the statistics out of
+// RpnCalculator; enableStats then throws.
+#ifndef RPN_STATS
+#define RPN_STATS 1
+#endif
+
+// Number of latency buckets of RpnStats.
+const size_t RPN_LATENCY_BUCKETS = 40;
+
+// Counters of RpnCalculator::stats, summed over all threads since statistics were enabled
+// or last reset. Expressions answered from the result cache run no phase and count only
+// in expressions and latency; those whose compiled program is cached skip all phases but
+// evaluation.
+struct RpnStats
+{
+    // Expressions evaluated by calculate, calculate_rpn and the batch functions, and how
+    // many of them threw.
+    uint64_t expressions = 0;
+    uint64_t errors = 0;
+    // Nanoseconds spent in each phase. parse is the conversion of infix tokens to RPN,
+    // compile builds and optimizes the program, and evaluate runs it, including the
+    // operators and functions it calls.
+    uint64_t tokenizeNanoseconds = 0;
+    uint64_t parseNanoseconds = 0;
+    uint64_t compileNanoseconds = 0;
+    uint64_t evaluateNanoseconds = 0;
+    // End to end time of the expressions, and of the slowest one.
+    uint64_t totalNanoseconds = 0;
+    uint64_t maxNanoseconds = 0;
+    // Tokens produced by the tokenizer, and operators applied and functions called by the
+    // evaluated programs, after constant folding and sub-expression elimination.
+    uint64_t tokens = 0;
+    uint64_t operatorsApplied = 0;
+    uint64_t functionCalls = 0;
+    // Latency histogram: latency[i] counts the expressions that took less than 2^i
+    // nanoseconds and at least 2^(i-1); the last bucket also holds all slower ones.
+    uint64_t latency[RPN_LATENCY_BUCKETS] = {};
+
+    // Returns the upper bound in nanoseconds of the latency bucket reached by the given
+    // fraction of the expressions, e.g. 0.99 for the 99th percentile; 0 if none were recorded.
+    uint64_t percentile(double fraction) const
+    {
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * expressions)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < RPN_LATENCY_BUCKETS && expressions; ++i) {
+            seen += latency[i];
+            if (seen >= rank || i + 1 == RPN_LATENCY_BUCKETS)
+                return uint64_t(1) << i;
+        }
+        return 0;
+    }
+};
+
+// Measurements of one expression, filled in while RpnCalculator runs its phases.
+struct RpnStatsSample
+{
+    uint64_t tokenizeNanoseconds = 0;
+    uint64_t parseNanoseconds = 0;
+    uint64_t compileNanoseconds = 0;
+    uint64_t evaluateNanoseconds = 0;
+    uint64_t tokens = 0;
+    uint64_t operatorsApplied = 0;
+    uint64_t functionCalls = 0;
+};
+
+// Collects the samples of RpnCalculator in relaxed atomic counters. All member functions
+// are safe to call concurrently; a snapshot reads every counter atomically, but not all
+// of them at the same instant.
+class RpnStatsCounters
+{
+public:
+    RpnStatsCounters();
+
+    RpnStatsCounters(const RpnStatsCounters&) = delete;
+    RpnStatsCounters& operator=(const RpnStatsCounters&) = delete;
+
+    // Returns a monotonic time stamp in nanoseconds.
+    static uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Returns whether samples are recorded. Callers skip all measurements otherwise.
+    bool enabled() const
+    {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    void enable(bool enabled);
+
+    // Adds one expression that took nanoseconds end to end.
+    void record(const RpnStatsSample& sample, uint64_t nanoseconds, bool failed);
+
+    RpnStats snapshot() const;
+
+    // Sets all counters to zero.
+    void reset();
+
+private:
+    typedef std::atomic<uint64_t> Counter;
+
+    std::atomic<bool> active;
+    Counter expressions;
+    Counter errors;
+    Counter tokenizeNanoseconds;
+    Counter parseNanoseconds;
+    Counter compileNanoseconds;
+    Counter evaluateNanoseconds;
+    Counter totalNanoseconds;
+    Counter maxNanoseconds;
+    Counter tokens;
+    Counter operatorsApplied;
+    Counter functionCalls;
+    Counter latency[RPN_LATENCY_BUCKETS];
+};
@@ -0,0 +1,104 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool that runs loops over index ranges.
+//
+// Every participant, the workers and the calling thread, starts with an equal share of the
+// range and takes chunks from its front. A chunk is a fraction of what the participant has
+// left, so chunks are large at first and shrink to single items near the end. A participant
+// whose share is exhausted steals the back half of the largest remaining share, so a few
+// slow items only hold up the participant that is running them.
+class RpnThreadPool
+{
+public:
+    // workers: number of participants including the calling thread; 0 selects
+    // std::thread::hardware_concurrency(). Threads are started by the first loop.
+    explicit RpnThreadPool(unsigned workers = 0);
+    ~RpnThreadPool();
+
+    RpnThreadPool(const RpnThreadPool&) = delete;
+    RpnThreadPool& operator=(const RpnThreadPool&) = delete;
+
+    // Changes the number of participants; takes effect with the next loop.
+    void resize(unsigned workers);
+
+    // Returns the number of participants, including the calling thread.
+    unsigned size() const;
+
+    // Calls body(begin, end) for disjoint ranges that together cover [0, count) and returns
+    // when all calls have returned. The first exception thrown by body is rethrown once the
+    // loop is finished; ranges not yet started are skipped. Concurrent loops on one pool run
+    // one after another.
+    void parallel_for(size_t count, const std::function<void(size_t, size_t)>& body);
+
+private:
+    // Unprocessed part of the share of one participant, padded so that shares of
+    // different participants do not share a cache line.
+    struct Share
+    {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+        char padding[64];
+    };
+
+    void start();
+    void stop();
+    // Thread function of worker self; generation is the last loop it must not join.
+    void run(unsigned self, size_t generation);
+    // Processes ranges of the current loop until no share has any left.
+    void work(unsigned self);
+    bool take(unsigned self, size_t& begin, size_t& end);
+    bool steal(unsigned self);
+
+    // Serializes loops and resizing.
+    std::mutex loopMutex;
+    std::atomic<unsigned> requested;
+    std::vector<std::thread> threads;
+    std::unique_ptr<Share[]> shares;
+    unsigned participants = 1;
+
+    // Hand-off between the calling thread and the workers.
+    std::mutex stateMutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    size_t generation = 0;
+    unsigned busy = 0;
+    bool stopping = false;
+    const std::function<void(size_t, size_t)>* current = nullptr;
+    std::exception_ptr error;
+    std::atomic<bool> failed;
+};
@@ -0,0 +1,184 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <climits>
+#include <string>
+#include "RpnFormat.h"
+
+#if !defined(_WIN32)
+#define RPN_API
+#elif defined(RPN_EXPORTS)
+#define RPN_API __declspec(dllexport)
+#else
+#define RPN_API __declspec(dllimport)
+#endif
+
+// Tagged value held on the evaluation stack.
+// Numbers are kept in binary form between operations; strings are only produced
+// at the API boundary or for plugins that use the string interface.
+struct RpnValue
+{
+    enum Kind : unsigned char
+    {
+        FLOAT,      // f holds the value
+        INTEGER,    // i holds the value
+        STRING,     // s holds the text, e.g. a quoted literal or a string plugin result
+    };
+
+    Kind kind = FLOAT;
+    // Set on INTEGER results of +, -, * and **. These were floating point values before
+    // integer arithmetic was kept exact, so they are still written as such unless the
+    // format asks for exact integers (see RpnFormat::exactIntegers).
+    bool arithmetic = false;
+    union
+    {
+        long double f = 0;
+        long long i;
+    };
+    std::string s;
+
+    RpnValue() = default;
+
+    static RpnValue Float(long double value)
+    {
+        RpnValue v;
+        v.set_float(value);
+        return v;
+    }
+
+    static RpnValue Integer(long long value)
+    {
+        RpnValue v;
+        v.set_integer(value);
+        return v;
+    }
+
+    static RpnValue String(std::string text)
+    {
+        RpnValue v;
+        v.kind = STRING;
+        v.s = std::move(text);
+        return v;
+    }
+
+    void set_float(long double value)
+    {
+        kind = FLOAT;
+        arithmetic = false;
+        f = value;
+    }
+
+    void set_integer(long long value, bool arithmeticResult = false)
+    {
+        kind = INTEGER;
+        arithmetic = arithmeticResult;
+        i = value;
+    }
+
+    // Numeric value as floating point. Strings are parsed as numeric literals.
+    long double as_float() const
+    {
+        return kind == FLOAT ? f : kind == INTEGER ? static_cast<long double>(i) : parse_float();
+    }
+
+    // Numeric value as a 64-bit integer. Floating point values are truncated.
+    long long as_integer() const
+    {
+        return kind == INTEGER ? i : kind == FLOAT ? static_cast<long long>(f) : static_cast<long long>(parse_float());
+    }
+
+    // Arithmetic of the built-in operators. Two INTEGER operands give an exact INTEGER
+    // result, marked as arithmetic, unless it overflows 64 bits, in which case, as for any
+    // other operands, the result is computed in floating point.
+    static void add(const RpnValue& a, const RpnValue& b, RpnValue& result)
+    {
+        if (a.kind == INTEGER && b.kind == INTEGER) {
+            long long sum = static_cast<long long>(static_cast<unsigned long long>(a.i) + static_cast<unsigned long long>(b.i));
+            if (((a.i ^ sum) & (b.i ^ sum)) >= 0) {
+                result.set_integer(sum, true);
+                return;
+            }
+        }
+        result.set_float(a.as_float() + b.as_float());
+    }
+
+    static void subtract(const RpnValue& a, const RpnValue& b, RpnValue& result)
+    {
+        if (a.kind == INTEGER && b.kind == INTEGER) {
+            long long difference = static_cast<long long>(static_cast<unsigned long long>(a.i) - static_cast<unsigned long long>(b.i));
+            if (((a.i ^ b.i) & (a.i ^ difference)) >= 0) {
+                result.set_integer(difference, true);
+                return;
+            }
+        }
+        result.set_float(a.as_float() - b.as_float());
+    }
+
+    static void multiply(const RpnValue& a, const RpnValue& b, RpnValue& result)
+    {
+        long long product;
+        if (a.kind == INTEGER && b.kind == INTEGER && multiply_exact(a.i, b.i, product))
+            result.set_integer(product, true);
+        else
+            result.set_float(a.as_float() * b.as_float());
+    }
+
+    // Sets product to a * b and returns true if it fits in 64 bits.
+    static bool multiply_exact(long long a, long long b, long long& product)
+    {
+        const long long small = 1LL << 31;
+        if ((a < small && a >= -small && b < small && b >= -small) ||
+            a == 0 || b == 0 ||
+            (a > 0 ? (b > 0 ? a <= LLONG_MAX / b : b >= LLONG_MIN / a) :
+                     (b > 0 ? a >= LLONG_MIN / b : a >= LLONG_MAX / b))) {
+            product = static_cast<long long>(static_cast<unsigned long long>(a) * static_cast<unsigned long long>(b));
+            return true;
+        }
+        return false;
+    }
+
+    // Parses s as a numeric literal.
+    RPN_API long double parse_float() const;
+
+    // Formats the value for the public string API (fixed 6 decimals for floating point).
+    RPN_API std::string to_string() const;
+
+    // Formats the value with the given format for floating point and arithmetic integers
+    // (see RpnFormat.h); other integers and strings are written as to_string does.
+    RPN_API std::string to_string(const RpnFormat& format) const;
+
+    // Formats the value as a literal that reads back without loss of precision.
+    // Used to pass values to plugins implementing the string interface.
+    RPN_API std::string to_literal() const;
+
+    // Converts a numeric or quoted string literal token into a value.
+    // Integer literals (including 0x, 0o, 0b forms) become INTEGER, other numbers FLOAT.
+    RPN_API static RpnValue from_literal(const std::string& token);
+
+    // Converts the numeric literal [begin, end) into a value without copying it; see
+    // Numeric::parse for the accepted forms. Throws std::runtime_error for other text.
+    RPN_API static RpnValue from_literal(const char* begin, const char* end);
+};
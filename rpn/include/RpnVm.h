@@ -0,0 +1,85 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "CompiledExpression.h"
+
+// Instruction of the register VM. Fixed width: an opcode and three 16-bit register or
+// table operands, 8 bytes in all.
+//
+// The register file holds, in this order, the constants of the program, its variables,
+// its temporaries and one register per stack position. Constants, variables and
+// temporaries are read where they are, so pushing them costs no instruction.
+struct RpnBytecode
+{
+    enum Opcode : unsigned char
+    {
+        MOVE,               // r[target] = r[a]
+        ADD,                // r[target] = r[a] + r[b], as RpnValue::add
+        SUBTRACT,           // r[target] = r[a] - r[b], as RpnValue::subtract
+        MULTIPLY,           // r[target] = r[a] * r[b], as RpnValue::multiply
+        DIVIDE,             // r[target] = r[a] / r[b], operands converted with as_float
+        APPLY_OPERATOR,     // r[target] = operators[a](r[target], r[target + 1])
+        CALL_FUNCTION,      // r[target] = functions[a](r[target] .. r[target + b - 1])
+        RETURN,             // the result is r[a]
+        OPCODE_COUNT
+    };
+
+    Opcode opcode;
+    uint16_t target;
+    uint16_t a;
+    uint16_t b;
+};
+
+// Register form of a CompiledProgram, built by RpnVm::compile.
+struct RpnBytecodeProgram
+{
+    std::vector<RpnBytecode> code;
+    // Number of registers; the first ones are the constants of the program.
+    size_t registerCount = 0;
+    // First register of the variables.
+    size_t variableBase = 0;
+};
+
+// Evaluators of compiled programs.
+class RpnVm
+{
+public:
+    // Translates a program into register bytecode. Returns nullptr for programs it cannot
+    // represent, which are variadic calls whose parameter count is only known at run time,
+    // malformed programs and programs needing more than 65536 registers or table entries; these run on
+    // interpret.
+    RPN_API static std::shared_ptr<const RpnBytecodeProgram> compile(const CompiledProgram& program);
+
+    // Runs program.bytecode, which must be set, with variables bound by slot. Dispatch is
+    // threaded through computed gotos with GCC and Clang, a switch loop elsewhere.
+    RPN_API static RpnValue run(const CompiledProgram& program, const long double* values);
+
+    // Runs program.code on a value stack, one instruction at a time.
+    RPN_API static RpnValue interpret(const CompiledProgram& program, const long double* values);
+};
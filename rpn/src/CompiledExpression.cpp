@@ -0,0 +1,198 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <algorithm>
+#include <stdexcept>
+#include "CompiledExpression.h"
+#include "RpnJit.h"
+#include "RpnOptimizer.h"
+#include "RpnVm.h"
+
+
+int RPN_API CompiledExpression::slot(const std::string& name) const
+{
+    auto it = std::find(program->variables.begin(), program->variables.end(), name);
+    return it == program->variables.end() ? -1 : static_cast<int>(it - program->variables.begin());
+}
+
+void RPN_API CompiledExpression::print() const
+{
+    RpnOptimizer::print(*program);
+}
+
+std::string RPN_API CompiledExpression::evaluate() const
+{
+    return evaluate(nullptr, 0);
+}
+
+std::string RPN_API CompiledExpression::evaluate(const long double* values, size_t count) const
+{
+    return run(values, count).to_string();
+}
+
+std::string RPN_API CompiledExpression::evaluate(const long double* values, size_t count, const RpnFormat& format) const
+{
+    return run(values, count).to_string(format);
+}
+
+RpnValue CompiledExpression::run(const long double* values, size_t count) const
+{
+    if (!program)
+        throw std::runtime_error("Expression is not compiled");
+    if (count < program->variables.size())
+        throw std::runtime_error("Variable is not bound: " + program->variables[count]);
+
+    if (program->native) {
+        // Native code works in double precision.
+        const size_t inlineCount = 16;
+        double inlineValues[inlineCount];
+        std::vector<double> heapValues;
+        double* doubles = inlineValues;
+        size_t variableCount = program->variables.size();
+        if (variableCount > inlineCount) {
+            heapValues.resize(variableCount);
+            doubles = heapValues.data();
+        }
+        for (size_t i = 0; i < variableCount; ++i)
+            doubles[i] = static_cast<double>(values[i]);
+        return RpnValue::Float(program->native->run(doubles));
+    }
+    return execute(values);
+}
+
+RpnValue CompiledExpression::execute(const long double* values) const
+{
+    return program->bytecode ? RpnVm::run(*program, values) : RpnVm::interpret(*program, values);
+}
+
+namespace
+{
+    // Number of rows evaluate_batch runs through each instruction at a time.
+    const size_t BATCH_BLOCK = 256;
+
+    // Returns the stack depth needed to run the program over blocks, or 0 if some
+    // instruction has no block implementation or the program is not well formed.
+    size_t batchDepth(const CompiledProgram& program)
+    {
+        for (const RpnValue& constant : program.constants) {
+            if (constant.kind == RpnValue::STRING)
+                return 0;
+        }
+
+        size_t depth = 0;
+        size_t maxDepth = 0;
+        for (const RpnInstruction& instruction : program.code) {
+            switch (instruction.kind) {
+            case RpnInstruction::APPLY_OPERATOR:
+                if (!program.operators[instruction.index].info->supportsBlocks())
+                    return 0;
+                break;
+            case RpnInstruction::CALL_FUNCTION:
+                if (instruction.arity < 0 || !program.functions[instruction.index].info->supportsBlocks())
+                    return 0;
+                break;
+            case RpnInstruction::STORE_TEMPORARY:
+                if (depth == 0)
+                    return 0;
+                continue;
+            default:
+                break;
+            }
+            if (depth < static_cast<size_t>(instruction.arity))
+                return 0;
+            depth = depth - instruction.arity + 1;
+            maxDepth = std::max(maxDepth, depth);
+        }
+        return depth == 1 ? maxDepth : 0;
+    }
+}
+
+void RPN_API CompiledExpression::evaluate_batch(const long double* const* columns, size_t columnCount, size_t rows, long double* results) const
+{
+    if (!program)
+        throw std::runtime_error("Expression is not compiled");
+    if (columnCount < program->variables.size())
+        throw std::runtime_error("Variable is not bound: " + program->variables[columnCount]);
+
+    size_t maxDepth = batchDepth(*program);
+    if (maxDepth == 0) {
+        std::vector<long double> row(program->variables.size());
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t i = 0; i < row.size(); ++i)
+                row[i] = columns[i][r];
+            results[r] = execute(row.data()).as_float();
+        }
+        return;
+    }
+
+    // Constants are broadcast to full blocks. Every stack entry and temporary owns a block
+    // of registers; stack entries point to their registers, to a constant or to an input column.
+    std::vector<long double> constants(program->constants.size() * BATCH_BLOCK);
+    for (size_t i = 0; i < program->constants.size(); ++i)
+        std::fill_n(constants.begin() + i * BATCH_BLOCK, BATCH_BLOCK, program->constants[i].as_float());
+    std::vector<long double> registers((maxDepth + program->temporaries) * BATCH_BLOCK);
+    long double* temporaries = registers.data() + maxDepth * BATCH_BLOCK;
+    std::vector<const long double*> stack(maxDepth);
+
+    for (size_t first = 0; first < rows; first += BATCH_BLOCK) {
+        size_t count = std::min(BATCH_BLOCK, rows - first);
+        size_t depth = 0;
+
+        for (const RpnInstruction& instruction : program->code) {
+            switch (instruction.kind) {
+            case RpnInstruction::PUSH_CONSTANT:
+                stack[depth++] = constants.data() + instruction.index * BATCH_BLOCK;
+                break;
+
+            case RpnInstruction::PUSH_VARIABLE:
+                stack[depth++] = columns[instruction.index] + first;
+                break;
+
+            case RpnInstruction::APPLY_OPERATOR:
+            case RpnInstruction::CALL_FUNCTION:
+            {
+                size_t base = depth - instruction.arity;
+                long double* result = registers.data() + base * BATCH_BLOCK;
+                if (instruction.kind == RpnInstruction::APPLY_OPERATOR)
+                    program->operators[instruction.index].info->calculate_block(stack.data() + base, count, result);
+                else
+                    program->functions[instruction.index].info->calculate_block(stack.data() + base, instruction.arity, count, result);
+                stack[base] = result;
+                depth = base + 1;
+                break;
+            }
+
+            case RpnInstruction::STORE_TEMPORARY:
+                std::copy_n(stack[depth - 1], count, temporaries + instruction.index * BATCH_BLOCK);
+                break;
+
+            case RpnInstruction::PUSH_TEMPORARY:
+                stack[depth++] = temporaries + instruction.index * BATCH_BLOCK;
+                break;
+            }
+        }
+        std::copy_n(stack[0], count, results + first);
+    }
+}
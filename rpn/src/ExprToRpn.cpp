@@ -27,218 +27,540 @@
 #include "ExprToRpn.h"
 #include "Numeric.h"
 
+#include <cstring>
 
 
-std::vector<std::string> FunctionShuntingYard::tokenize(const std::string& expression, bool rpn_input) {
-    std::vector<std::string> tokens;
-    std::string cleanExpr = expression;
-    if (!rpn_input)
-        cleanExpr.erase(std::remove_if(cleanExpr.begin(), cleanExpr.end(), ::isspace), cleanExpr.end());
-    const std::regex tokenRegex(
-        R"((0[xX][0-9A-Fa-f]+)"        // hex prefix
-        R"(|0[oO][0-7]+)"               // octal prefix
-        R"(|0[bB][01]+)"                // binary prefix
-        R"(|[0-9A-Fa-f]+[hH])"          // hex suffix
-        R"(|[0-7]+[oO])"                // octal suffix
-        R"(|[01]+[bB])"                 // binary suffix
-        R"(|"[^"]*")"                   // quoted strings
-        R"([+-]?|\d+\.\d+|\d+\.\d*|\.\d+|\d+)" // decimal/float
-        R"(|[+-]?\d+(?:\.\d*)?[eE][+-]?\d+)"         // scientific notation with integer or decimal base
-        R"(|[+-]?\.\d+[eE][+-]?\d+)"                 // scientific notation starting with decimal point
-        R"(|[a-zA-Z_][a-zA-Z0-9_]*)"   // identifiers
-        R"(|==|!=|<=|>=|&&|\|\||<<|>>|\+\+|--|\+|-|\*|/|\^|\(|\)|,|%|<|>|=|&|\||!|\{|\}|\[|\]))"
-    );
- 
-    // First pass: tokenize
-    std::sregex_iterator iter(cleanExpr.begin(), cleanExpr.end(), tokenRegex);
-    std::sregex_iterator end;
-    while (iter != end) {
-        std::string token = iter->str();
-        if (!token.empty()) tokens.push_back(token);
-        ++iter;
+
+namespace
+{
+    // Character classes driving the single-pass lexer.
+    enum CharClass : unsigned char
+    {
+        CC_OTHER = 0,   // anything else, including operator characters
+        CC_SPACE,       // whitespace, separates tokens
+        CC_DIGIT,       // 0-9, starts a numeric literal
+        CC_ALPHA,       // letters and '_', starts an identifier
+        CC_DOT,         // '.', may start a numeric literal (.5)
+        CC_QUOTE,       // '"', starts a string literal
+        CC_BRACKET,     // ( ) [ ] { }
+        CC_COMMA,       // parameter separator
+    };
+
+    struct CharClassTable
+    {
+        unsigned char cls[256];
+
+        CharClassTable()
+        {
+            for (int c = 0; c < 256; ++c)
+                cls[c] = CC_OTHER;
+            for (int c = '0'; c <= '9'; ++c)
+                cls[c] = CC_DIGIT;
+            for (int c = 'a'; c <= 'z'; ++c)
+                cls[c] = CC_ALPHA;
+            for (int c = 'A'; c <= 'Z'; ++c)
+                cls[c] = CC_ALPHA;
+            cls['_'] = CC_ALPHA;
+            cls[' '] = cls['\t'] = cls['\n'] = cls['\r'] = cls['\v'] = cls['\f'] = CC_SPACE;
+            cls['.'] = CC_DOT;
+            cls['"'] = CC_QUOTE;
+            cls['('] = cls[')'] = cls['['] = cls[']'] = cls['{'] = cls['}'] = CC_BRACKET;
+            cls[','] = CC_COMMA;
+        }
+    };
+
+    const CharClassTable charClasses;
+
+    inline CharClass classOf(char c)
+    {
+        return static_cast<CharClass>(charClasses.cls[static_cast<unsigned char>(c)]);
     }
 
-    //// Second pass: merge unary minus into numbers
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        if (tokens[i] == "-" && i + 1 < tokens.size()) {
-            const std::string& next = tokens[i + 1];
-            // Check if next token is a number
-            bool isNumber = std::regex_match(next,
-                std::regex(R"(0[xX][0-9A-Fa-f]+|0[oO][0-7]+|0[bB][01]+|[0-9A-Fa-f]+[hH]|[0-7]+[oO]|[01]+[bB]|\d+\.\d+|\d+\.\d*|\.\d+|\d+)"));
-
-            if (isNumber) {
-                // Unary minus if at start or after operator or left parenthesis/bracket/brace
-                if (i == 0 || std::regex_match(tokens[i - 1], std::regex(R"(==|!=|<=|>=|&&|\|\||<<|>>|\+\+|--|\+|-|\*|/|\^|,|%|<|>|=|&|\||!|\(|\{|\[)")))
-                {
-                    tokens[i + 1] = "-" + tokens[i + 1]; // merge
-                    tokens.erase(tokens.begin() + i);   // remove unary minus token
-                    --i; // stay at current index
-                }
+    inline bool isDecimalDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // Returns the value of c as a digit in base 16, or 16 if it is not a hex digit.
+    inline int digitValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        c |= 0x20;
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return 16;
+    }
+
+    // Scans a numeric literal starting at pos in the n characters at s and returns the position just past it,
+    // or pos if no literal starts there.
+    // Accepted forms: 0x1F, 0o17, 0b101, 1Fh, 17o, 101b, 12, 1.5, .5, 1., 1e-9, 1.5E+3.
+    size_t scanNumber(const char* s, size_t n, size_t pos)
+    {
+        size_t i = pos;
+
+        if (s[i] == '0' && i + 2 < n)
+        {
+            char p = s[i + 1] | 0x20;
+            int radix = p == 'x' ? 16 : p == 'o' ? 8 : p == 'b' ? 2 : 0;
+            if (radix != 0)
+            {
+                size_t j = i + 2;
+                while (j < n && digitValue(s[j]) < radix)
+                    ++j;
+                if (j > i + 2)
+                    return j;
             }
         }
+
+        if (isDecimalDigit(s[i]))
+        {
+            size_t j = i;
+            while (j < n && digitValue(s[j]) < 16)
+                ++j;
+            if (j < n && (s[j] | 0x20) == 'h')
+                return j + 1;
+            j = i;
+            while (j < n && digitValue(s[j]) < 8)
+                ++j;
+            if (j < n && (s[j] | 0x20) == 'o')
+                return j + 1;
+            j = i;
+            while (j < n && digitValue(s[j]) < 2)
+                ++j;
+            if (j < n && (s[j] | 0x20) == 'b')
+                return j + 1;
+        }
+
+        size_t j = i;
+        while (j < n && isDecimalDigit(s[j]))
+            ++j;
+        bool hasDigits = j > i;
+        if (j < n && s[j] == '.')
+        {
+            size_t k = j + 1;
+            while (k < n && isDecimalDigit(s[k]))
+                ++k;
+            hasDigits = hasDigits || k > j + 1;
+            j = k;
+        }
+        if (!hasDigits)
+            return pos;
+        if (j < n && (s[j] | 0x20) == 'e')
+        {
+            size_t k = j + 1;
+            if (k < n && (s[k] == '+' || s[k] == '-'))
+                ++k;
+            if (k < n && isDecimalDigit(s[k]))
+            {
+                while (k < n && isDecimalDigit(s[k]))
+                    ++k;
+                j = k;
+            }
+        }
+        return j;
     }
 
-    return tokens;
+    // Text of a literal token, without whitespace between a merged unary minus and the number.
+    std::string literalText(const std::string& source, const RpnToken& token)
+    {
+        const char* begin = token.begin(source);
+        const char* end = begin + token.length;
+        if (*begin != '-')
+            return std::string(begin, end);
+        const char* digits = begin + 1;
+        while (digits < end && classOf(*digits) == CC_SPACE)
+            ++digits;
+        std::string text(1, '-');
+        text.append(digits, end);
+        return text;
+    }
 }
-std::vector<std::string> FunctionShuntingYard::infixToRPN(const std::string& infix) {
-    std::vector<std::string> tokens = tokenize(infix, false);
-    std::vector<std::string> output;
-    std::stack<std::string> operatorStack;
-    std::stack<int> arityStack;
 
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        const std::string& token = tokens[i];
+std::vector<RpnToken> FunctionShuntingYard::tokenize(const std::string& expression, bool rpn_input) const {
+    return tokenize(expression.data(), expression.length(), rpn_input);
+}
+
+std::vector<RpnToken> FunctionShuntingYard::tokenize(const char* expression, size_t n, bool rpn_input) const {
+    if (n > UINT32_MAX)
+        throw std::runtime_error("Expression is too long");
+    std::vector<RpnToken> tokens;
+    // True when the next token is expected to be an operand, i.e. a '-' here is unary.
+    bool operandExpected = true;
+    // Reused for lookups, so classifying a token allocates nothing.
+    std::string key;
+    Numeric::Literal literal;
+
+    size_t i = 0;
+    while (i < n) {
+        const char c = expression[i];
+        const size_t start = i;
+        RpnToken::Kind kind;
+        int id = -1;
+
+        switch (classOf(c)) {
+        case CC_SPACE:
+            ++i;
+            continue;
+
+        case CC_DIGIT:
+        case CC_DOT:
+            i = scanNumber(expression, n, i);
+            if (i == start)
+                ++i;
+            if (!Numeric::parse(expression + start, expression + i, literal))
+                throw std::runtime_error("Unknown token: " + std::string(expression + start, i - start));
+            kind = RpnToken::LITERAL;
+            operandExpected = false;
+            break;
 
-        if (!isOperator(token) && ((Numeric::isNumber(token))||Numeric::isString(token)))
+        case CC_ALPHA:
         {
-            output.push_back(token);
+            while (i < n && (classOf(expression[i]) == CC_ALPHA || classOf(expression[i]) == CC_DIGIT))
+                ++i;
+            // Function names are case insensitive, operator names are not.
+            key.assign(expression + start, i - start);
+            for (char& ch : key)
+                ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+            auto function = functionIds.find(key);
+            if (function != functionIds.end()) {
+                kind = RpnToken::FUNCTION;
+                id = function->second;
+            }
+            else {
+                key.assign(expression + start, i - start);
+                auto op = operatorIds.find(key);
+                kind = op != operatorIds.end() ? RpnToken::OPERATOR : RpnToken::VARIABLE;
+                if (op != operatorIds.end())
+                    id = op->second;
+            }
+            operandExpected = kind == RpnToken::OPERATOR;
+            break;
         }
-        else if (isFunction(token)) 
+
+        case CC_QUOTE:
         {
-            operatorStack.push(token);
-            arityStack.push(0);
+            const void* quote = std::memchr(expression + i + 1, '"', n - i - 1);
+            if (quote == nullptr)
+                throw std::runtime_error("Unterminated string literal");
+            i = static_cast<const char*>(quote) - expression + 1;
+            kind = RpnToken::LITERAL;
+            operandExpected = false;
+            break;
         }
-        else if (token == ",") 
-        {
+
+        case CC_BRACKET:
+            ++i;
+            operandExpected = c == '(' || c == '[' || c == '{';
+            kind = operandExpected ? RpnToken::LEFT_BRACKET : RpnToken::RIGHT_BRACKET;
+            break;
+
+        case CC_COMMA:
+            ++i;
+            kind = RpnToken::SEPARATOR;
+            operandExpected = true;
+            break;
+
+        default:
+            // Unary minus: merged into the following numeric literal. In infix input it is
+            // unary at the start or after an operator, bracket or comma; in RPN input it
+            // must be written directly in front of the number ("-1").
+            if (c == '-' && (rpn_input ? (i == 0 || classOf(expression[i - 1]) == CC_SPACE) : operandExpected)) {
+                size_t j = i + 1;
+                if (!rpn_input)
+                    while (j < n && classOf(expression[j]) == CC_SPACE)
+                        ++j;
+                size_t end = j < n ? scanNumber(expression, n, j) : j;
+                if (end != j) {
+                    if (!Numeric::parse(expression + j, expression + end, literal))
+                        throw std::runtime_error("Unknown token: -" + std::string(expression + j, end - j));
+                    tokens.push_back({ RpnToken::LITERAL, -1, static_cast<uint32_t>(start), static_cast<uint32_t>(end - start) });
+                    i = end;
+                    operandExpected = false;
+                    continue;
+                }
+            }
+            // Longest registered operator symbol.
+            {
+                size_t len = std::min(maxOperatorLength, n - i);
+                for (; len > 0; --len) {
+                    key.assign(expression + i, len);
+                    auto op = operatorIds.find(key);
+                    if (op != operatorIds.end()) {
+                        id = op->second;
+                        break;
+                    }
+                }
+                if (len == 0)
+                    throw std::runtime_error("Unknown token: " + std::string(1, c));
+                i += len;
+            }
+            kind = RpnToken::OPERATOR;
+            operandExpected = true;
+            break;
+        }
+        tokens.push_back({ kind, id, static_cast<uint32_t>(start), static_cast<uint32_t>(i - start) });
+    }
+
+    return tokens;
+}
+
+std::vector<RpnToken> FunctionShuntingYard::infixToRPN(const std::string& infix) const {
+    return infixToRPN(infix.data(), infix.length());
+}
+
+std::vector<RpnToken> FunctionShuntingYard::infixToRPN(const char* data, size_t length) const {
+    return infixToRPN(data, tokenize(data, length, false));
+}
+
+std::vector<RpnToken> FunctionShuntingYard::infixToRPN(const std::string& infix, const std::vector<RpnToken>& tokens) const {
+    return infixToRPN(infix.data(), tokens);
+}
+
+std::vector<RpnToken> FunctionShuntingYard::infixToRPN(const char* infix, const std::vector<RpnToken>& tokens) const {
+    std::vector<RpnToken> output;
+    output.reserve(tokens.size());
+    // Indexes into tokens of the pending operators, functions and brackets.
+    std::vector<size_t> operatorStack;
+    std::vector<int> arityStack;
+
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const RpnToken& token = tokens[i];
+
+        switch (token.kind) {
+        case RpnToken::LITERAL:
+            output.push_back(token);
+            break;
+
+        case RpnToken::VARIABLE:
+            // Any other name is a variable, bound to a slot when the expression is compiled.
+            if (i + 1 < tokens.size() && tokens[i + 1].kind == RpnToken::LEFT_BRACKET)
+                throw std::runtime_error("Unknown function: " + token.text(infix));
+            output.push_back(token);
+            break;
+
+        case RpnToken::FUNCTION:
+            operatorStack.push_back(i);
+            arityStack.push_back(0);
+            break;
+
+        case RpnToken::SEPARATOR:
             // parameter separator -> pop until left bracket
-            while (!operatorStack.empty() && !isLeftBracket(operatorStack.top())) 
+            while (!operatorStack.empty() && tokens[operatorStack.back()].kind != RpnToken::LEFT_BRACKET)
             {
-                output.push_back(operatorStack.top());
-                operatorStack.pop();
+                output.push_back(tokens[operatorStack.back()]);
+                operatorStack.pop_back();
             }
             if (!arityStack.empty()) {
-                arityStack.top()++;
+                arityStack.back()++;
             }
-        }
-        else if (isOperator(token)) {
-            while (!operatorStack.empty() &&
-                !isLeftBracket(operatorStack.top()) &&
-                !isFunction(operatorStack.top()) &&
-                (getPrecedence(operatorStack.top()) > getPrecedence(token) ||
-                    (getPrecedence(operatorStack.top()) == getPrecedence(token) &&
-                        !isRightAssociative(token)))) {
-                output.push_back(operatorStack.top());
-                operatorStack.pop();
+            break;
+
+        case RpnToken::OPERATOR:
+        {
+            const OperatorTraits& traits = operatorTraits[token.id];
+            while (!operatorStack.empty() && tokens[operatorStack.back()].kind == RpnToken::OPERATOR) {
+                const OperatorTraits& top = operatorTraits[tokens[operatorStack.back()].id];
+                if (!(top.precedence > traits.precedence ||
+                    (top.precedence == traits.precedence && !traits.rightAssociative)))
+                    break;
+                output.push_back(tokens[operatorStack.back()]);
+                operatorStack.pop_back();
             }
-            operatorStack.push(token);
-        }
-        else if (isLeftBracket(token)) {
-            operatorStack.push(token);
+            operatorStack.push_back(i);
+            break;
         }
-        else if (isRightBracket(token)) {
-            std::string opening = matchingOpening(token);
+
+        case RpnToken::LEFT_BRACKET:
+            operatorStack.push_back(i);
+            break;
+
+        case RpnToken::RIGHT_BRACKET:
+        {
+            char opening = matchingOpening(infix[token.offset]);
             // pop until matching opening bracket
-            while (!operatorStack.empty() && operatorStack.top() != opening) {
-                // if we hit a different left bracket type -> mismatched
-                if (isLeftBracket(operatorStack.top()) && operatorStack.top() != opening) {
-                    throw std::runtime_error("Mismatched parentheses/brackets/braces");
-                }
-                output.push_back(operatorStack.top());
-                operatorStack.pop();
+            while (!operatorStack.empty() && tokens[operatorStack.back()].kind != RpnToken::LEFT_BRACKET) {
+                output.push_back(tokens[operatorStack.back()]);
+                operatorStack.pop_back();
             }
-            if (!operatorStack.empty() && operatorStack.top() == opening) {
-                operatorStack.pop(); // remove the matching opening
+            // a different left bracket type or none at all -> mismatched
+            if (!operatorStack.empty() && infix[tokens[operatorStack.back()].offset] == opening) {
+                operatorStack.pop_back(); // remove the matching opening
             }
             else {
                 throw std::runtime_error("Mismatched parentheses/brackets/braces");
             }
 
             // if a function name is on top now -> it's a function call
-            if (!operatorStack.empty() && isFunction(operatorStack.top())) {
-                std::string func = operatorStack.top();
-                int params_count = getFunctionArity(func);
-                operatorStack.pop();
+            if (!operatorStack.empty() && tokens[operatorStack.back()].kind == RpnToken::FUNCTION) {
+                const RpnToken& func = tokens[operatorStack.back()];
+                int params_count = functionArities[func.id];
+                operatorStack.pop_back();
 
                 int paramCount = 1;
                 if (!arityStack.empty()) {
-                    paramCount = arityStack.top() + 1;
-                    arityStack.pop();
+                    paramCount = arityStack.back() + 1;
+                    arityStack.pop_back();
                 }
                 if (params_count == -1)
-                    output.push_back(std::to_string(paramCount));
+                    output.push_back({ RpnToken::COUNT, paramCount, 0, 0 });
                 output.push_back(func);
             }
+            break;
         }
-        else {
-            throw std::runtime_error("Unknown token: " + token);
+
+        case RpnToken::COUNT:
+            // Only produced here, for the output; tokenize never returns it.
+            throw std::runtime_error("Unexpected parameter count token in infix expression");
         }
     }
 
     while (!operatorStack.empty()) {
-        if (isLeftBracket(operatorStack.top()) || isRightBracket(operatorStack.top())) {
+        if (tokens[operatorStack.back()].kind == RpnToken::LEFT_BRACKET) {
             throw std::runtime_error("Mismatched parentheses/brackets/braces");
         }
-        output.push_back(operatorStack.top());
-        operatorStack.pop();
+        output.push_back(tokens[operatorStack.back()]);
+        operatorStack.pop_back();
     }
     return output;
 }
 
-std::string FunctionShuntingYard::evaluateRPN(const std::vector<std::string>& rpn) const 
+std::vector<RpnToken> FunctionShuntingYard::resolveRPN(const std::string& rpn) const
 {
-    std::stack<std::string> stack;
-    for (const std::string& token : rpn) {
-        if (Numeric::isNumber(token) || Numeric::isString(token)) {
-            stack.push(token);
-        }
-        else if (isOperator(token))
+    std::vector<RpnToken> tokens = tokenize(rpn, true);
+    for (const RpnToken& token : tokens) {
+        if (token.kind == RpnToken::LEFT_BRACKET || token.kind == RpnToken::RIGHT_BRACKET || token.kind == RpnToken::SEPARATOR)
+            throw std::runtime_error("Unknown token in RPN: " + token.text(rpn));
+    }
+    return tokens;
+}
+
+std::shared_ptr<const CompiledProgram> FunctionShuntingYard::compile(const std::string& source, const std::vector<RpnToken>& rpn,
+    const std::vector<std::string>& variables) const
+{
+    std::shared_ptr<CompiledProgram> program = std::make_shared<CompiledProgram>();
+    program->variables = variables;
+    program->code.reserve(rpn.size());
+    // Stack depth tracked at compile time. It becomes unknown after a variadic call
+    // whose parameter count is computed at run time.
+    size_t depth = 0;
+    bool depthKnown = true;
+
+    for (const RpnToken& token : rpn) {
+        RpnInstruction instruction;
+        switch (token.kind) {
+        case RpnToken::LITERAL:
         {
+            instruction.kind = RpnInstruction::PUSH_CONSTANT;
+            instruction.arity = 0;
+            instruction.index = static_cast<int>(program->constants.size());
+            const char* begin = token.begin(source);
+            const char* end = begin + token.length;
+            if (*begin == '"')
+                program->constants.push_back(RpnValue::String(std::string(begin, end)));
+            else if (*begin == '-' && classOf(begin[1]) == CC_SPACE)
+                program->constants.push_back(RpnValue::from_literal(literalText(source, token)));
+            else
+                program->constants.push_back(RpnValue::from_literal(begin, end));
+            break;
+        }
 
-            if (stack.size() < 2)
-                throw std::runtime_error("Invalid expression");
-            std::string t = token;
-            auto it = operators.find(token);
-            if (it == operators.end() || !it->second) {
-                throw std::runtime_error("Unknown or uninitialized operator: " + token);
+        case RpnToken::COUNT:
+            instruction.kind = RpnInstruction::PUSH_CONSTANT;
+            instruction.arity = 0;
+            instruction.index = static_cast<int>(program->constants.size());
+            program->constants.push_back(RpnValue::Integer(token.id));
+            break;
+
+        case RpnToken::OPERATOR:
+        {
+            const OperatorRegistration& registration = operators[token.id];
+            if (!registration.info) {
+                throw std::runtime_error("Unknown or uninitialized operator: " + token.text(source));
             }
-            IOperatorInfo *operator_info = it->second.get();
-            std::vector<std::string> operands;
-            for (int i = 0; i < operator_info->num_parameters(); i++)
-            {
-                operands.push_back(stack.top()); stack.pop();
+            instruction.kind = RpnInstruction::APPLY_OPERATOR;
+            instruction.arity = operatorTraits[token.id].parameters;
+            instruction.index = -1;
+            for (size_t i = 0; i < program->operators.size(); ++i)
+                if (program->operators[i].info == registration.typed)
+                    instruction.index = static_cast<int>(i);
+            if (instruction.index == -1) {
+                instruction.index = static_cast<int>(program->operators.size());
+                program->operators.push_back({ registration.name, registration.typed });
             }
-            std::string result = operator_info->calculate(operands);
-            stack.push(result);
+            if (depthKnown && depth < static_cast<size_t>(instruction.arity))
+                throw std::runtime_error("Invalid expression");
+            break;
         }
-        else
-            if (isFunction(token))
-            {
-                auto it = functions.find(to_lower(token));
-                if (it == functions.end())
-                    throw std::runtime_error("Unknown function: " + token);
-                int expectedArity = getFunctionArity(token);
-                IFunctionInfo* info = it->second.get();
-
-                if (stack.size() < expectedArity && expectedArity!= -1)
-                    throw std::runtime_error("Not enough parameters for function " + token);
-                if (expectedArity == -1)
-                {
-                    expectedArity = std::stoi(stack.top());
-                    stack.pop();
-                }
 
-                std::vector<std::string> params(expectedArity);
-                for (int i = expectedArity - 1; i >= 0; --i)
-                {
-                    params[i] = stack.top();
-                    stack.pop();
-                }
-                std::string result = info->calculate(params);
-                stack.push(result);
+        case RpnToken::FUNCTION:
+        {
+            const FunctionRegistration& registration = functions[token.id];
+            instruction.kind = RpnInstruction::CALL_FUNCTION;
+            instruction.arity = functionArities[token.id];
+            instruction.index = -1;
+            for (size_t i = 0; i < program->functions.size(); ++i)
+                if (program->functions[i].info == registration.typed)
+                    instruction.index = static_cast<int>(i);
+            if (instruction.index == -1) {
+                instruction.index = static_cast<int>(program->functions.size());
+                program->functions.push_back({ registration.name, registration.typed });
             }
-            else
-            {
-                throw std::runtime_error("Unknown token in RPN: " + token);
+            if (instruction.arity == -1) {
+                // A literal parameter count pushed right before the call is folded into the instruction.
+                if (!program->code.empty() && program->code.back().kind == RpnInstruction::PUSH_CONSTANT &&
+                    program->constants.back().kind != RpnValue::STRING) {
+                    instruction.arity = static_cast<int>(program->constants.back().as_integer());
+                    program->constants.pop_back();
+                    program->code.pop_back();
+                    --depth;
+                }
+                else {
+                    depthKnown = false;
+                }
             }
+            if (depthKnown && depth < static_cast<size_t>(instruction.arity))
+                throw std::runtime_error("Not enough parameters for function " + token.text(source));
+            break;
+        }
+
+        case RpnToken::VARIABLE:
+        {
+            const char* name = token.begin(source);
+            auto it = std::find_if(program->variables.begin(), program->variables.end(),
+                [&](const std::string& variable) { return variable.compare(0, std::string::npos, name, token.length) == 0; });
+            instruction.kind = RpnInstruction::PUSH_VARIABLE;
+            instruction.arity = 0;
+            instruction.index = static_cast<int>(it - program->variables.begin());
+            if (it == program->variables.end())
+                program->variables.emplace_back(name, token.length);
+            break;
+        }
+
+        default:
+            throw std::runtime_error("Unknown token in RPN: " + token.text(source));
+        }
+
+        if (depthKnown) {
+            depth = depth - instruction.arity + 1;
+            program->maxDepth = std::max(program->maxDepth, depth);
+        }
+        program->code.push_back(instruction);
     }
 
-    if (stack.size() != 1) throw std::runtime_error("Invalid expression");
-    return stack.top();
+    if (depthKnown && depth != 1)
+        throw std::runtime_error("Invalid expression");
+    return program;
+}
+
+std::string FunctionShuntingYard::evaluateRPN(const std::string& rpn) const 
+{
+    return CompiledExpression(compile(rpn, resolveRPN(rpn), std::vector<std::string>())).evaluate();
 }
 
-void FunctionShuntingYard::printRPN(const std::vector<std::string>& rpn) const {
+void FunctionShuntingYard::printRPN(const std::string& source, const std::vector<RpnToken>& rpn) const {
     for (size_t i = 0; i < rpn.size(); ++i) {
-        std::cout << rpn[i] << (i + 1 < rpn.size() ? " " : "");
+        std::cout << (rpn[i].kind == RpnToken::LITERAL ? literalText(source, rpn[i]) : rpn[i].text(source)) << (i + 1 < rpn.size() ? " " : "");
     }
     std::cout << std::endl;
 }
@@ -248,7 +570,7 @@ void FunctionShuntingYard::enumerateFunctions(bool (*scan_func)(std::string cons
     std::cout << "Available functions:" << std::endl;
     for (const auto& func : functions) 
     {
-        bool res = (*scan_func)(func.first, func.second.get());
+        bool res = (*scan_func)(func.name, func.info.get());
         if (res)
             break;
     }
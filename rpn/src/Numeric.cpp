@@ -23,80 +23,217 @@
 * SOFTWARE.
 *
 * ============================================================================== =*/
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
 #include "Numeric.h"
 
 
+namespace
+{
+    // Returns the value of c as a digit in base 36, or 36 if it is not a digit.
+    inline unsigned digitValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        c |= 0x20;
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 10;
+        return 36;
+    }
+
+    inline bool isDecimalDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    // Reads the digits of a radix literal; shift is log2 of the radix. Returns false if
+    // the range is empty or holds a character that is not a digit of the radix. Sets
+    // overflow if the value needs more than 64 bits.
+    bool parseRadix(const char* begin, const char* end, unsigned shift, unsigned long long& value, bool& overflow)
+    {
+        if (begin == end)
+            return false;
+        const unsigned radix = 1u << shift;
+        value = 0;
+        for (; begin != end; ++begin) {
+            unsigned digit = digitValue(*begin);
+            if (digit >= radix)
+                return false;
+            if (value >> (64 - shift))
+                overflow = true;
+            value = value << shift | digit;
+        }
+        return true;
+    }
+
+    // Powers of ten that are exact in long double (10^27 needs 64 mantissa bits, 10^22 53).
+    const long double powersOfTen[] = {
+        1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+        1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+        1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L,
+    };
+    const int mantissaBits = std::numeric_limits<long double>::digits;
+    const int maxExactPower = mantissaBits >= 64 ? 27 : 22;
+    const unsigned long long maxExactMantissa = mantissaBits >= 64 ? ~0ull : (1ull << mantissaBits);
+
+    // Compares [begin, end) with a lower case word, ignoring case.
+    bool equalsWord(const char* begin, const char* end, const char* word)
+    {
+        for (; begin != end; ++begin, ++word) {
+            if (*word == 0 || (*begin | 0x20) != *word)
+                return false;
+        }
+        return *word == 0;
+    }
+}
+
+bool Numeric::parse(const char* begin, const char* end, Literal& literal)
+{
+    const char* p = begin;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == end)
+        return false;
+
+    if (!isDecimalDigit(*p) && *p != '.') {
+        bool nan = equalsWord(p, end, "nan");
+        if (!nan && !equalsWord(p, end, "inf") && !equalsWord(p, end, "infinity"))
+            return false;
+        long double value = nan ? std::numeric_limits<long double>::quiet_NaN() : std::numeric_limits<long double>::infinity();
+        literal.integral = false;
+        literal.value = negative ? -value : value;
+        return true;
+    }
+
+    // Radix literals: a 0x, 0o or 0b prefix, otherwise an h, x, o or b suffix.
+    unsigned shift = 0;
+    const char* digits = p;
+    const char* digitsEnd = end;
+    if (end - p > 2 && p[0] == '0') {
+        char prefix = p[1] | 0x20;
+        shift = prefix == 'x' ? 4 : prefix == 'o' ? 3 : prefix == 'b' ? 1 : 0;
+        digits = p + 2;
+    }
+    if (shift == 0) {
+        char suffix = end[-1] | 0x20;
+        shift = suffix == 'h' || suffix == 'x' ? 4 : suffix == 'o' ? 3 : suffix == 'b' ? 1 : 0;
+        digits = p;
+        digitsEnd = end - 1;
+    }
+    if (shift != 0) {
+        unsigned long long bits;
+        bool overflow = false;
+        if (!parseRadix(digits, digitsEnd, shift, bits, overflow))
+            return false;
+        if (overflow)
+            throw std::runtime_error("Numeric literal does not fit in 64 bits: " + std::string(begin, end));
+        literal.integral = true;
+        literal.integer = static_cast<long long>(negative ? 0 - bits : bits);
+        literal.value = static_cast<long double>(literal.integer);
+        return true;
+    }
+
+    // Decimal: up to 19 significant digits are collected in mantissa, exponent scales them.
+    unsigned long long mantissa = 0;
+    int significant = 0;
+    long exponent = 0;
+    bool exact = true;
+    bool anyDigit = false;
+    for (; p != end && isDecimalDigit(*p); ++p) {
+        anyDigit = true;
+        unsigned digit = *p - '0';
+        if (mantissa == 0 && digit == 0)
+            continue;
+        if (significant < 19) {
+            mantissa = mantissa * 10 + digit;
+            ++significant;
+        }
+        else {
+            exact = exact && digit == 0;
+            ++exponent;
+        }
+    }
+    bool integral = true;
+    if (p != end && *p == '.') {
+        integral = false;
+        for (++p; p != end && isDecimalDigit(*p); ++p) {
+            anyDigit = true;
+            unsigned digit = *p - '0';
+            if (significant < 19 && (mantissa != 0 || digit != 0)) {
+                mantissa = mantissa * 10 + digit;
+                ++significant;
+                --exponent;
+            }
+            else if (mantissa == 0)
+                --exponent;
+            else
+                exact = exact && digit == 0;
+        }
+    }
+    if (!anyDigit)
+        return false;
+    if (p != end && (*p | 0x20) == 'e') {
+        integral = false;
+        ++p;
+        bool negativeExponent = false;
+        if (p != end && (*p == '-' || *p == '+'))
+            negativeExponent = *p++ == '-';
+        if (p == end)
+            return false;
+        long written = 0;
+        for (; p != end && isDecimalDigit(*p); ++p)
+            written = written < 100000 ? written * 10 + (*p - '0') : written;
+        exponent += negativeExponent ? -written : written;
+    }
+    if (p != end)
+        return false;
+
+    // The magnitude of the most negative integer is one more than the largest positive one.
+    if (integral && exponent == 0 && mantissa <= static_cast<unsigned long long>(std::numeric_limits<long long>::max()) + negative) {
+        literal.integral = true;
+        literal.integer = static_cast<long long>(negative ? 0 - mantissa : mantissa);
+        literal.value = static_cast<long double>(literal.integer);
+        return true;
+    }
+
+    long double value;
+    if (mantissa == 0)
+        value = 0;
+    else if (exact && mantissa <= maxExactMantissa && exponent >= -maxExactPower && exponent <= maxExactPower) {
+        // Both operands are exact, so the one rounding of the product or quotient gives
+        // the correctly rounded result.
+        value = exponent < 0 ? static_cast<long double>(mantissa) / powersOfTen[-exponent] :
+            static_cast<long double>(mantissa) * powersOfTen[exponent];
+    }
+    else {
+        // Long or extreme literals are left to the C library.
+        std::string text(begin, end);
+        value = std::strtold(text.c_str(), nullptr);
+        negative = false;
+    }
+    literal.integral = false;
+    literal.value = negative ? -value : value;
+    return true;
+}
+
 long double Numeric :: str_to_ld(std::string _token)
 /**
  * @brief Converts a string representation of a number into a long double.
  *
- * This function takes a string input and determines its numeric value. It supports
- * binary, octal, hexadecimal, and decimal formats. The function automatically detects
- * the format based on prefixes (e.g., "0b" for binary, "0o" for octal, "0x" for hexadecimal)
- * and suffixes (e.g., "b", "o", "x"). If the input is in decimal format, it is directly
- * converted to a long double.
+ * Literals accepted by Numeric::parse are converted exactly as there. Other strings are
+ * read as far as they form a decimal number, e.g. "12 USD" gives 12.
  *
  * @param _token A string representing the number to be converted.
- * @return The numeric value as a long double. Returns 0 if the input is invalid or empty.
- *
- * @note Supported formats:
- * - Binary: Prefix "0b" or suffix "b" (e.g., "0b1010", "1010b").
- * - Octal: Prefix "0o" or suffix "o" (e.g., "0o77", "77o").
- * - Hexadecimal: Prefix "0x" or suffix "x" (e.g., "0x1A", "1Ax").
- * - Decimal: No prefix or suffix (e.g., "123.45" or in form with E like 1.3E-2).
+ * @return The numeric value as a long double.
+ * @throws std::invalid_argument if the string does not start with a number.
  */
 {
-    if (_token.empty())
-        return false;
-    std::string token = _token;
-    bool bin = false;
-    bool hex = false;
-    bool oct = false;
-    char const* ch = token.c_str();
-    long double res = 0;
-    if (ch[0] == '0')
-        switch (token[1])
-        {
-        case 'b':
-        case 'B':
-            bin = true;
-            ch += 2;
-            break;
-        case 'o':
-        case 'O':
-            oct = true;
-            ch += 2;
-            break;
-        case 'x':
-        case 'X':
-            hex = true;
-            ch += 2;
-            break;
-        }
-    switch (token[token.length() - 1])
-    {
-    case 'b':
-    case 'B':
-        bin = true;
-        token.pop_back();
-        break;
-    case 'o':
-    case 'O':
-        oct = true;
-        token.pop_back();
-        break;
-    case 'x':
-    case 'X':
-        hex = true;
-        token.pop_back();
-        break;
-    }
-    int radix = hex ? 16 : oct ? 8 : bin ? 2 : 10;
-    if (radix != 10)
-        res = std::stol(ch, nullptr, radix);
-    else
-        res = std::stold(ch);
-    return res;
+    Literal literal;
+    if (parse(_token.data(), _token.data() + _token.size(), literal))
+        return literal.value;
+    return std::stold(_token);
 }
 
 bool Numeric::isString(const std::string& _token)
@@ -118,81 +255,12 @@ bool Numeric::isString(const std::string& _token)
 
 bool Numeric::isNumber(const std::string& _token)
 /**
- * @brief Checks if a string represents a valid number in binary, octal, hexadecimal, or decimal format.
- *
- * This function determines whether the input string is a valid numeric literal.
- * It supports binary (prefix "0b" or suffix "b"), octal (prefix "0o" or suffix "o"),
- * hexadecimal (prefix "0x" or suffix "x"), and decimal formats. The function
- * automatically detects the format based on the string's prefix or suffix and
- * attempts to parse the value accordingly.
+ * @brief Checks if a string is a numeric literal accepted by Numeric::parse.
  *
  * @param _token The string to check for numeric validity.
  * @return true if the string is a valid number in one of the supported formats, false otherwise.
- *
- * @note Supported formats:
- * - Binary: Prefix "0b" or suffix "b" (e.g., "0b1010", "1010b").
- * - Octal: Prefix "0o" or suffix "o" (e.g., "0o77", "77o").
- * - Hexadecimal: Prefix "0x" or suffix "x" (e.g., "0x1A", "1Ax").
- * - Decimal: No prefix or suffix (e.g., "123.45" or in form with E like 1.3E-2).
  */
 {
-    if (_token.empty())
-        return false;
-    std::string token = _token;
-    if (_token.length() == 1 && (_token[0] == '+' || _token[0] == '-'))
-        return false;
-    bool bin = false;
-    bool hex = false;
-    bool oct = false;
-    if (token[0] == '0')
-        switch (token[1])
-        {
-        case 'b':
-        case 'B':
-            bin = true;
-            break;
-        case 'o':
-        case 'O':
-            oct = true;
-            break;
-        case 'x':
-        case 'X':
-            hex = true;
-            break;
-        }
-    switch (token[token.length() - 1])
-    {
-    case 'b':
-    case 'B':
-        bin = true;
-        token.pop_back();
-        break;
-    case 'o':
-    case 'O':
-        oct = true;
-        token.pop_back();
-        break;
-    case 'x':
-    case 'X':
-        hex = true;
-        token.pop_back();
-        break;
-    }
-    int radix = hex ? 16 : oct ? 8 : bin ? 2 : 10;
-    char const* c = token.c_str();
-    char* endptr;
-    if (radix == 10)
-    {
-        long double res = std::strtold(c, &endptr);
-        (void)res;
-    }
-    else
-    {
-        long long res = std::strtoll(c, &endptr, radix);
-        (void)res;
-    }
-    if (endptr == c + token.length())
-        return true;
-
-    return false;
+    Literal literal;
+    return parse(_token.data(), _token.data() + _token.size(), literal);
 }
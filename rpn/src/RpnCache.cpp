@@ -0,0 +1,240 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <cctype>
+#include "RpnCache.h"
+#include "RpnJit.h"
+#include "RpnVm.h"
+
+
+namespace
+{
+    // Character classes for normalization, following the tokenizer of FunctionShuntingYard.
+    enum CharClass
+    {
+        WORD,       // letters, digits, '_' and '.', which form identifiers and numbers
+        SYMBOL,     // operator characters, which may combine into longer operators
+        SEPARATOR,  // brackets and commas, always tokens of their own
+        QUOTE,
+        SPACE,
+    };
+
+    CharClass classOf(char c)
+    {
+        if (std::isspace(static_cast<unsigned char>(c)))
+            return SPACE;
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.')
+            return WORD;
+        switch (c) {
+        case '(': case ')': case '[': case ']': case '{': case '}': case ',':
+            return SEPARATOR;
+        case '"':
+            return QUOTE;
+        default:
+            return SYMBOL;
+        }
+    }
+
+    // Returns whether infix whitespace between the characters before and after it can be
+    // dropped without changing the tokens. Between a word ending in e or E and a symbol it
+    // is kept, since "1E+3" is a single number.
+    bool removable(char before, char after)
+    {
+        CharClass a = classOf(before);
+        CharClass b = classOf(after);
+        if (a == SEPARATOR || b == SEPARATOR)
+            return true;
+        if (a == SYMBOL)
+            return b == WORD || b == QUOTE;
+        if (a == WORD && b == SYMBOL)
+            return before != 'e' && before != 'E';
+        return false;
+    }
+
+    // Bookkeeping per entry: list node, hash node and the second copy of the key.
+    const size_t ENTRY_OVERHEAD = 64;
+
+    size_t programBytes(const CompiledProgram& program)
+    {
+        size_t bytes = sizeof(CompiledProgram)
+            + program.code.size() * sizeof(RpnInstruction)
+            + program.constants.size() * sizeof(RpnValue)
+            + program.operators.size() * sizeof(CompiledProgram::OperatorEntry)
+            + program.functions.size() * sizeof(CompiledProgram::FunctionEntry);
+        for (const RpnValue& constant : program.constants)
+            bytes += constant.s.capacity();
+        for (const std::string& variable : program.variables)
+            bytes += sizeof(std::string) + variable.capacity();
+        if (program.bytecode)
+            bytes += sizeof(RpnBytecodeProgram) + program.bytecode->code.size() * sizeof(RpnBytecode);
+        if (program.native)
+            bytes += sizeof(RpnJit) + program.native->code_size();
+        return bytes;
+    }
+}
+
+RpnCache::RpnCache(size_t budget) : active(budget > 0)
+{
+    counters.budget = budget;
+}
+
+std::string RpnCache::normalize(const std::string& text, bool rpn)
+{
+    std::string key(1, rpn ? 'r' : 'i');
+    key.reserve(text.size() + 1);
+    bool pendingSpace = false;
+
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        if (classOf(c) == SPACE) {
+            pendingSpace = key.size() > 1;
+            continue;
+        }
+        if (pendingSpace && (rpn || !removable(key.back(), c)))
+            key += ' ';
+        pendingSpace = false;
+
+        if (c == '"') {
+            size_t end = text.find('"', i + 1);
+            if (end == std::string::npos)
+                end = text.size() - 1;
+            key.append(text, i, end - i + 1);
+            i = end;
+        }
+        else
+            key += c;
+    }
+    return key;
+}
+
+bool RpnCache::isPure(const CompiledProgram& program)
+{
+    for (const CompiledProgram::OperatorEntry& op : program.operators) {
+        if (!op.info->isPure())
+            return false;
+    }
+    for (const CompiledProgram::FunctionEntry& function : program.functions) {
+        if (!function.info->isPure())
+            return false;
+    }
+    return true;
+}
+
+bool RpnCache::findPlan(const std::string& key, CompiledExpression& plan)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find('P' + key);
+    if (it == index.end()) {
+        ++counters.planMisses;
+        return false;
+    }
+    ++counters.planHits;
+    entries.splice(entries.begin(), entries, it->second);
+    plan = it->second->plan;
+    return true;
+}
+
+bool RpnCache::findResult(const std::string& key, std::string& result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find('R' + key);
+    if (it == index.end()) {
+        ++counters.resultMisses;
+        return false;
+    }
+    ++counters.resultHits;
+    entries.splice(entries.begin(), entries, it->second);
+    result = it->second->result;
+    return true;
+}
+
+void RpnCache::storePlan(const std::string& key, const CompiledExpression& plan)
+{
+    Entry entry{ 'P' + key, PLAN, plan, std::string(), 0 };
+    entry.bytes = sizeof(Entry) + ENTRY_OVERHEAD + 2 * entry.key.capacity() + programBytes(plan.compiled_program());
+    store(std::move(entry));
+}
+
+void RpnCache::storeResult(const std::string& key, const std::string& result)
+{
+    Entry entry{ 'R' + key, RESULT, CompiledExpression(), result, 0 };
+    entry.bytes = sizeof(Entry) + ENTRY_OVERHEAD + 2 * entry.key.capacity() + entry.result.capacity();
+    store(std::move(entry));
+}
+
+void RpnCache::store(Entry entry)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entry.bytes > counters.budget)
+        return;
+
+    // Another thread may have stored the same key since the lookup missed.
+    auto it = index.find(entry.key);
+    if (it != index.end()) {
+        counters.bytes -= it->second->bytes;
+        entries.erase(it->second);
+        index.erase(it);
+    }
+    counters.bytes += entry.bytes;
+    entries.push_front(std::move(entry));
+    index.emplace(entries.front().key, entries.begin());
+    evict();
+    counters.entries = entries.size();
+}
+
+void RpnCache::evict()
+{
+    while (counters.bytes > counters.budget && !entries.empty()) {
+        Entry& last = entries.back();
+        ++(last.tier == PLAN ? counters.planEvictions : counters.resultEvictions);
+        counters.bytes -= last.bytes;
+        index.erase(last.key);
+        entries.pop_back();
+    }
+}
+
+void RpnCache::setBudget(size_t budget)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.budget = budget;
+    active = budget > 0;
+    evict();
+    counters.entries = entries.size();
+}
+
+void RpnCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    index.clear();
+    entries.clear();
+    counters.bytes = 0;
+    counters.entries = 0;
+}
+
+RpnCacheStats RpnCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
@@ -23,65 +23,203 @@
 * SOFTWARE.
 *
 * ============================================================================== =*/
+#include <algorithm>
 #include <cmath>
-#include <regex>
-#include <bitset>
 #include "RpnCalculator.h"
-#include <windows.h>
-
-#include <sstream>
+#include "RpnConstexpr.h"
 #include <cstdlib>
 #include "ExprToRpn.h"
 #include "Numeric.h"
+#include "RpnJit.h"
+#include "RpnOptimizer.h"
+#include "RpnSimd.h"
+#include "RpnThreadPool.h"
+#include "RpnVm.h"
 
 
-// Represents an arithmetic operator used in the RPN calculator.
-// This class implements the IOperatorInfo interface and provides details about the operator,
-// such as its precedence, associativity, and calculation logic.
-class ArithmeticOperator : public IOperatorInfo
+namespace
 {
-    // The type of the operator (e.g., +, -, *, /, etc.).
-    std::string operator_type;
+    // Shifts in two's complement. Counts of 64 or more shift out all bits, negative
+    // counts shift the other way.
+    long long shiftRight(long long value, long long count);
 
-    // Indicates whether the operator is right-associative.
-    bool m_isRightAssociative;
+    long long shiftLeft(long long value, long long count)
+    {
+        if (count < 0)
+            return shiftRight(value, count == LLONG_MIN ? LLONG_MAX : -count);
+        return count >= 64 ? 0 : static_cast<long long>(static_cast<unsigned long long>(value) << count);
+    }
 
-    // The precedence of the operator. Higher values indicate higher precedence.
-    int m_precedence;
+    long long shiftRight(long long value, long long count)
+    {
+        if (count < 0)
+            return shiftLeft(value, count == LLONG_MIN ? LLONG_MAX : -count);
+        // Arithmetic shift: the sign is kept.
+        if (count >= 64)
+            return value < 0 ? -1 : 0;
+        return value < 0 ? ~(~value >> count) : value >> count;
+    }
 
-public:
-    // Destructor for the ArithmeticOperator class.
-    virtual ~ArithmeticOperator()
-    {
-    }
-
-    // Constructor for the ArithmeticOperator class.
-    // Args:
-    // - op_type: The type of the operator (e.g., +, -, *, /, etc.).
-    // - _verbose: Optional verbosity level (default is 0).
-    ArithmeticOperator(std::string op_type, int _verbose = 0) : operator_type(op_type)
-    {
-        m_isRightAssociative = false;
-        m_precedence = -1;
-
-        // Set precedence and associativity based on the operator type.
-        if (op_type == "|")
-            m_precedence = 1;
-        else if (op_type == "^")
-            m_precedence = 2;
-        else if (op_type == "&")
-            m_precedence = 3;
-        if (op_type == ">>" || op_type == "<<")
-            m_precedence = 4;
-        if (op_type == "+" || op_type == "-")
-            m_precedence = 5;
-        else if (op_type == "*" || op_type == "/" || op_type == "%")
-            m_precedence = 6;
-        else if (op_type == "**")
+    // Sets power to base ** exponent by repeated squaring and returns true if the
+    // exponent is not negative and every step fits in 64 bits.
+    bool integerPower(long long base, long long exponent, long long& power)
+    {
+        if (exponent < 0)
+            return false;
+        power = 1;
+        while (exponent > 0) {
+            if ((exponent & 1) && !RpnValue::multiply_exact(power, base, power))
+                return false;
+            exponent >>= 1;
+            if (exponent > 0 && !RpnValue::multiply_exact(base, base, base))
+                return false;
+        }
+        return true;
+    }
+
+    long long modulo(long long a, long long b)
+    {
+        if (b == 0)
+            throw std::runtime_error("Division by zero");
+        // LLONG_MIN % -1 overflows in the division.
+        return b == -1 ? 0 : a % b;
+    }
+
+    // Kernels of the built-in operators. apply works on typed values: bitwise, shift and
+    // modulo operators produce 64-bit integers; +, -, * and ** keep two integer operands
+    // exact as long as the result fits in 64 bits (** for non-negative exponents); otherwise
+    // they, and /, produce floating point values. block is the same operation on one row of
+    // calculate_block, where integer operators truncate their operands to 64-bit integers.
+    struct AddKernel
+    {
+        static void apply(const RpnValue& a, const RpnValue& b, RpnValue& result) { RpnValue::add(a, b, result); }
+        static long double block(long double a, long double b) { return a + b; }
+    };
+
+    struct SubtractKernel
+    {
+        static void apply(const RpnValue& a, const RpnValue& b, RpnValue& result) { RpnValue::subtract(a, b, result); }
+        static long double block(long double a, long double b) { return a - b; }
+    };
+
+    struct MultiplyKernel
+    {
+        static void apply(const RpnValue& a, const RpnValue& b, RpnValue& result) { RpnValue::multiply(a, b, result); }
+        static long double block(long double a, long double b) { return a * b; }
+    };
+
+    struct DivideKernel
+    {
+        static void apply(const RpnValue& a, const RpnValue& b, RpnValue& result) { result.set_float(a.as_float() / b.as_float()); }
+        static long double block(long double a, long double b) { return a / b; }
+    };
+
+    struct PowerKernel
+    {
+        static void apply(const RpnValue& a, const RpnValue& b, RpnValue& result)
+        {
+            long long power;
+            if (a.kind == RpnValue::INTEGER && b.kind == RpnValue::INTEGER && integerPower(a.i, b.i, power))
+                result.set_integer(power, true);
+            else
+                result.set_float(std::pow(a.as_float(), b.as_float()));
+        }
+        static long double block(long double a, long double b) { return std::pow(a, b); }
+    };
+
+    // Operators on 64-bit integers, given as a function of two integers.
+    template <long long (*operation)(long long, long long)>
+    struct IntegerKernel
+    {
+        static void apply(const RpnValue& a, const RpnValue& b, RpnValue& result)
         {
-            m_precedence = 7;
-            m_isRightAssociative = true;
+            result.set_integer(operation(a.as_integer(), b.as_integer()));
         }
+        static long double block(long double a, long double b)
+        {
+            return static_cast<long double>(operation(static_cast<long long>(a), static_cast<long long>(b)));
+        }
+    };
+
+    long long bitwiseOr(long long a, long long b) { return a | b; }
+    long long bitwiseXor(long long a, long long b) { return a ^ b; }
+    long long bitwiseAnd(long long a, long long b) { return a & b; }
+
+    template <class Kernel>
+    void applyKernel(const RpnValue* args, RpnValue& result)
+    {
+        Kernel::apply(args[0], args[1], result);
+    }
+
+    template <class Kernel>
+    void blockKernel(const long double* a, const long double* b, size_t count, long double* result)
+    {
+        for (size_t i = 0; i < count; ++i)
+            result[i] = Kernel::block(a[i], b[i]);
+    }
+
+    // Built-in operator: its symbol, the parser properties and the kernels.
+    struct OperatorEntry
+    {
+        const char* symbol;
+        // Higher values indicate higher precedence.
+        int precedence;
+        bool rightAssociative;
+        void (*apply)(const RpnValue* args, RpnValue& result);
+        void (*block)(const long double* a, const long double* b, size_t count, long double* result);
+        RpnNativeOperation::Kind native;
+        RpnSimd::Function nativeFunction;
+    };
+
+    template <class Kernel>
+    constexpr OperatorEntry entry(const char* symbol, int precedence, bool rightAssociative,
+        RpnNativeOperation::Kind native = RpnNativeOperation::NONE, RpnSimd::Function nativeFunction = RpnSimd::FUNCTION_COUNT)
+    {
+        return OperatorEntry{ symbol, precedence, rightAssociative, applyKernel<Kernel>, blockKernel<Kernel>, native, nativeFunction };
+    }
+
+    // Built-in operators indexed by opcode, in the order RpnConstexpr::Opcode lists them.
+    enum OperatorOpcode
+    {
+        OR, XOR, AND, SHIFT_LEFT, SHIFT_RIGHT, ADD, SUBTRACT, MULTIPLY, DIVIDE, MODULO, POWER, OPERATOR_COUNT
+    };
+
+    constexpr OperatorEntry operatorTable[OPERATOR_COUNT] = {
+        entry<IntegerKernel<bitwiseOr>>("|", 1, false),
+        entry<IntegerKernel<bitwiseXor>>("^", 2, false),
+        entry<IntegerKernel<bitwiseAnd>>("&", 3, false),
+        entry<IntegerKernel<shiftLeft>>("<<", 4, false),
+        entry<IntegerKernel<shiftRight>>(">>", 4, false),
+        entry<AddKernel>("+", 5, false, RpnNativeOperation::ADD),
+        entry<SubtractKernel>("-", 5, false, RpnNativeOperation::SUBTRACT),
+        entry<MultiplyKernel>("*", 6, false, RpnNativeOperation::MULTIPLY),
+        entry<DivideKernel>("/", 6, false, RpnNativeOperation::DIVIDE),
+        entry<IntegerKernel<modulo>>("%", 6, false),
+        entry<PowerKernel>("**", 7, true, RpnNativeOperation::FUNCTION, RpnSimd::POW),
+    };
+
+    // The compile-time front end parses with the same table.
+    constexpr bool matchesConstexprTable(int opcode = 0)
+    {
+        return opcode == OPERATOR_COUNT ||
+            (operatorTable[opcode].precedence == RpnConstexpr::precedence(static_cast<RpnConstexpr::Opcode>(RpnConstexpr::OR + opcode)) &&
+             operatorTable[opcode].rightAssociative == RpnConstexpr::isRightAssociative(static_cast<RpnConstexpr::Opcode>(RpnConstexpr::OR + opcode)) &&
+             matchesConstexprTable(opcode + 1));
+    }
+    static_assert(matchesConstexprTable(), "Operator precedence differs from RpnConstexpr");
+}
+
+// Represents a built-in arithmetic operator of the RPN calculator.
+// The operator is selected by its opcode, which indexes operatorTable for the precedence,
+// associativity and the kernels, so evaluation calls the kernel of that one operator.
+class ArithmeticOperator : public ITypedOperatorInfo
+{
+    const OperatorEntry& operation;
+
+public:
+    // Constructs the operator of the given opcode.
+    ArithmeticOperator(OperatorOpcode opcode) : operation(operatorTable[opcode])
+    {
     }
 
     // Returns the number of parameters the operator takes.
@@ -94,93 +232,158 @@ public:
     // Returns whether the operator is right-associative.
     virtual bool isRightAssociative()
     {
-        return m_isRightAssociative;
+        return operation.rightAssociative;
     }
 
     // Returns the precedence of the operator.
     virtual int precedence()
     {
-        return m_precedence;
-    }
-
-    // Performs the calculation for the operator given its arguments.
-    // Args:
-    // - args: A vector of strings representing the arguments for the operator.
-    // Returns:
-    // - A string representing the result of the calculation.
-    virtual std::string calculate(const std::vector<std::string>& args)
-    {
-        long double a = Numeric::str_to_ld(args[0]);
-        long double b = Numeric::str_to_ld(args[1]);
-        std::string res = "";
-
-        // Perform the calculation based on the operator type.
-        if (operator_type == "+")
-            res = std::to_string(a + b);
-        else if (operator_type == "-")
-            res = std::to_string(b - a);
-        else if (operator_type == "*")
-            res = std::to_string(a * b);
-        else if (operator_type == "/")
-            res = std::to_string(b / a);
-        else if (operator_type == "%")
-            res = std::to_string((long long)b % (long long)a);
-        else if (operator_type == "^")
-            res = std::to_string((long long)a ^ (long long)b);
-        else if (operator_type == "&")
-            res = std::to_string((long long)a & (long long)b);
-        else if (operator_type == "|")
-            res = std::to_string((long long)a | (long long)b);
-        else if (operator_type == "<<")
-            res = std::to_string((long long)b << (long long)a);
-        else if (operator_type == ">>")
-            res = std::to_string((long long)b >> (long long)a);
-        else if (operator_type == "**")
-            res = std::to_string(std::pow(b, a));
-
-        return res;
+        return operation.precedence;
+    }
+
+    using ITypedOperatorInfo::calculate;
+
+    // Performs the calculation for the operator on typed operands.
+    virtual void calculate(const RpnValue* args, RpnValue& result)
+    {
+        operation.apply(args, result);
+    }
+
+    virtual bool supportsBlocks()
+    {
+        return true;
+    }
+
+    // Performs the calculation over a block of rows.
+    virtual void calculate_block(const long double* const* args, size_t count, long double* result)
+    {
+        operation.block(args[0], args[1], count, result);
+    }
+
+    virtual RpnNativeOperation native()
+    {
+        return RpnNativeOperation(operation.native, operation.nativeFunction);
+    }
+};
+
+// Formats the 64-bit two's complement pattern of an integer in base 2, 8 or 16, as hex,
+// oct and bin. Binary always has 64 digits, the others have no leading zeros.
+// Works on typed values, so integers are formatted exactly, without a floating point
+// round trip; floating point arguments are truncated.
+class RadixFunc : public ITypedFunctionInfo
+{
+    // Bits per digit: 1, 3 or 4.
+    int bits;
+
+public:
+    RadixFunc(int _bits) : bits(_bits)
+    {
+    }
+
+    virtual int num_parameters() const
+    {
+        return 1;
+    }
+
+    using ITypedFunctionInfo::calculate;
+
+    virtual void calculate(const RpnValue* args, int /*count*/, RpnValue& result)
+    {
+        static const char digits[] = "0123456789abcdef";
+        unsigned long long value = static_cast<unsigned long long>(args[0].as_integer());
+        char text[64];
+        char* end = text + sizeof(text);
+        char* begin = end;
+        const unsigned mask = (1u << bits) - 1;
+        do {
+            *--begin = digits[value & mask];
+            value >>= bits;
+        } while (value != 0 || (bits == 1 && begin != text));
+        result = RpnValue::String(std::string(begin, end));
     }
 };
 
-// Represents a generic function for the RPN calculator.
-// This class implements the IFunctionInfo interface and allows registration of custom functions
-// by providing a function pointer for the calculation logic and specifying the number of parameters.
-class GenericFunc : public IFunctionInfo
+// Represents a numeric function of one or two parameters for the RPN calculator.
+// Works on typed values, so calls do not format or parse strings.
+class MathFunc : public ITypedFunctionInfo
 {
-    // Pointer to the function that performs the calculation.
-    std::string(*calculate_func)(const std::vector<std::string>& args);
+    long double(*unary_func)(long double x) = nullptr;
+    long double(*binary_func)(long double x, long double y) = nullptr;
+    // Vectorized kernel used for blocks, FUNCTION_COUNT if there is none.
+    RpnSimd::Function simd_func;
 
-    // Number of parameters the function takes.
-    int n_parameters;
 public:
-    // Constructs a GenericFunc with the specified number of parameters and calculation function.
-    // Args:
-    // - parameters: The number of parameters the function takes.
-    // - p_calculate_func: Pointer to the function that performs the calculation.
-    GenericFunc(int parameters, std::string(*p_calculate_func)(const std::vector<std::string>& args))
+    // Constructs a function of one parameter.
+    MathFunc(long double(*p_unary_func)(long double x), RpnSimd::Function p_simd_func = RpnSimd::FUNCTION_COUNT)
+        : unary_func(p_unary_func), simd_func(p_simd_func)
+    {
+    }
+
+    // Constructs a function of two parameters.
+    MathFunc(long double(*p_binary_func)(long double x, long double y), RpnSimd::Function p_simd_func = RpnSimd::FUNCTION_COUNT)
+        : binary_func(p_binary_func), simd_func(p_simd_func)
     {
-        n_parameters = parameters;
-        calculate_func = p_calculate_func;
     }
 
-    // Returns the number of parameters the function takes.
     virtual int num_parameters() const
     {
-        return n_parameters;
+        return unary_func ? 1 : 2;
     }
 
-    // Performs the calculation for the function given its arguments.
-    // Args:
-    // - args: A vector of strings representing the arguments for the function.
-    // Returns:
-    // - A string representing the result of the calculation.
-    virtual std::string calculate(const std::vector<std::string>& args)
+    using ITypedFunctionInfo::calculate;
+
+    virtual void calculate(const RpnValue* args, int /*count*/, RpnValue& result)
     {
-        return calculate_func(args);
+        if (unary_func)
+            result.set_float(unary_func(args[0].as_float()));
+        else
+            result.set_float(binary_func(args[0].as_float(), args[1].as_float()));
+    }
+
+    virtual bool supportsBlocks() const
+    {
+        return true;
+    }
+
+    virtual void calculate_block(const long double* const* args, int /*count*/, size_t rows, long double* result)
+    {
+        if (simd_func != RpnSimd::FUNCTION_COUNT && RpnSimd::level() != RpnSimd::SCALAR)
+        {
+            // The vector kernels work in double precision.
+            const size_t chunk = 256;
+            double x[chunk], y[chunk];
+            RpnSimd::Kernel kernel = RpnSimd::kernel(simd_func);
+            for (size_t first = 0; first < rows; first += chunk)
+            {
+                size_t n = std::min(chunk, rows - first);
+                for (size_t i = 0; i < n; ++i)
+                    x[i] = static_cast<double>(args[0][first + i]);
+                if (binary_func)
+                    for (size_t i = 0; i < n; ++i)
+                        y[i] = static_cast<double>(args[1][first + i]);
+                kernel(x, y, n, x);
+                for (size_t i = 0; i < n; ++i)
+                    result[first + i] = x[i];
+            }
+            return;
+        }
+
+        if (unary_func)
+            for (size_t i = 0; i < rows; ++i)
+                result[i] = unary_func(args[0][i]);
+        else
+            for (size_t i = 0; i < rows; ++i)
+                result[i] = binary_func(args[0][i], args[1][i]);
+    }
+    virtual RpnNativeOperation native() const
+    {
+        if (simd_func == RpnSimd::FUNCTION_COUNT)
+            return RpnNativeOperation();
+        return RpnNativeOperation(RpnNativeOperation::FUNCTION, simd_func);
     }
 };
 
-class AverageFunc : public IFunctionInfo
+class AverageFunc : public ITypedFunctionInfo
 {
 public:
     AverageFunc()
@@ -191,100 +394,369 @@ public:
         return -1;
     }
 
-    virtual std::string calculate(const std::vector<std::string>& args)
+    using ITypedFunctionInfo::calculate;
+
+    virtual void calculate(const RpnValue* args, int count, RpnValue& result)
     {
         long double sum = 0;
-        for (std::string arg : args)
-        {
-            long double val = Numeric::str_to_ld(arg);
-            sum += val;
-        }
-        return std::to_string(sum / args.size());
+        for (int i = 0; i < count; ++i)
+            sum += args[i].as_float();
+        result.set_float(sum / count);
+    }
+
+    virtual bool supportsBlocks() const
+    {
+        return true;
+    }
+
+    virtual void calculate_block(const long double* const* args, int count, size_t rows, long double* result)
+    {
+        // Sum parameter by parameter, so each pass is a loop over contiguous rows.
+        // result may be args[0], which is read before it is overwritten.
+        for (size_t r = 0; r < rows; ++r)
+            result[r] = count > 0 ? args[0][r] : 0;
+        for (int i = 1; i < count; ++i)
+            for (size_t r = 0; r < rows; ++r)
+                result[r] += args[i][r];
+        for (size_t r = 0; r < rows; ++r)
+            result[r] /= count;
+    }
+
+    virtual RpnNativeOperation native() const
+    {
+        return RpnNativeOperation(RpnNativeOperation::AVERAGE);
     }
 
 };
 
 void RPN_API RpnCalculator::addFunction(std::string const& name, function_ptr_t functionUniquePtr)
 {
+    checkNotFrozen("add functions");
     calc->add_function(name, std::move(functionUniquePtr));
+    cache->clear();
 }
 
 void RPN_API RpnCalculator::addOperator(std::string const& name, operator_ptr_t operatorUniquePtr)
 {
+    checkNotFrozen("add operators");
     calc->add_operator(name, std::move(operatorUniquePtr));
+    cache->clear();
 }
 
 void RPN_API RpnCalculator::addStandardFunctions()
 {
-    calc->add_function("g2r", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(Numeric::str_to_ld(args[0]) * std::acos(-1.0) / 180.0); })));
-    calc->add_function("r2g", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(Numeric::str_to_ld(args[0]) * 180.0 / std::acos(-1.0)); })));
-    calc->add_function("sin", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::sin(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("asin", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::asin(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("cos", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::cos(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("acos", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::acos(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("tan", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::tan(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("atan", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::atan(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("ln", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::log(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("lg", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::log10(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("expn", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::exp(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("hex", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { std::stringstream ss; ss << std::hex << (long long)Numeric::str_to_ld(args[0]); return ss.str();    return ss.str(); })));
-    calc->add_function("oct", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { std::stringstream ss; ss << std::oct << (long long)Numeric::str_to_ld(args[0]); return ss.str();    return ss.str(); })));
-    calc->add_function("bin", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { std::stringstream ss; ss << std::bitset<64>((long long)Numeric::str_to_ld(args[0])); return ss.str();    return ss.str(); })));
-
-    calc->add_function("sqrt", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::sqrt(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("abs", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::abs(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("floor", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::floor(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("ceil", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(std::ceil(Numeric::str_to_ld(args[0]))); })));
-    calc->add_function("c2f", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string(1.8 * (Numeric::str_to_ld(args[0])) + 32); })));
-    calc->add_function("f2c", std::unique_ptr<GenericFunc>(new GenericFunc(1, [](const std::vector<std::string>& args) { return std::to_string((Numeric::str_to_ld(args[0]) - 32)/1.8); })));
-
-    calc->add_function("log", std::unique_ptr<GenericFunc>(new GenericFunc(2, [](const std::vector<std::string>& args) { return std::to_string(std::log(Numeric::str_to_ld(args[0])) / std::log(Numeric::str_to_ld(args[1]))); })));
-    calc->add_function("pow", std::unique_ptr<GenericFunc>(new GenericFunc(2, [](const std::vector<std::string>& args) { return std::to_string(std::pow(Numeric::str_to_ld(args[0]), Numeric::str_to_ld(args[1]))); })));
+    checkNotFrozen("add functions");
+    cache->clear();
+    calc->add_function("g2r", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return x * std::acos(-1.0) / 180.0; })));
+    calc->add_function("r2g", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return x * 180.0 / std::acos(-1.0); })));
+    calc->add_function("sin", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::sin(x); }, RpnSimd::SIN)));
+    calc->add_function("asin", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::asin(x); }, RpnSimd::ASIN)));
+    calc->add_function("cos", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::cos(x); }, RpnSimd::COS)));
+    calc->add_function("acos", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::acos(x); }, RpnSimd::ACOS)));
+    calc->add_function("tan", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::tan(x); }, RpnSimd::TAN)));
+    calc->add_function("atan", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::atan(x); }, RpnSimd::ATAN)));
+    calc->add_function("ln", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::log(x); }, RpnSimd::LN)));
+    calc->add_function("lg", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::log10(x); }, RpnSimd::LG)));
+    calc->add_function("expn", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::exp(x); }, RpnSimd::EXPN)));
+    calc->add_function("hex", std::unique_ptr<RadixFunc>(new RadixFunc(4)));
+    calc->add_function("oct", std::unique_ptr<RadixFunc>(new RadixFunc(3)));
+    calc->add_function("bin", std::unique_ptr<RadixFunc>(new RadixFunc(1)));
+
+    calc->add_function("sqrt", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::sqrt(x); }, RpnSimd::SQRT)));
+    calc->add_function("abs", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::abs(x); }, RpnSimd::ABS)));
+    calc->add_function("floor", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::floor(x); }, RpnSimd::FLOOR)));
+    calc->add_function("ceil", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return std::ceil(x); }, RpnSimd::CEIL)));
+    calc->add_function("c2f", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return 1.8 * x + 32; })));
+    calc->add_function("f2c", std::unique_ptr<MathFunc>(new MathFunc([](long double x) { return (x - 32)/1.8; })));
+
+    calc->add_function("log", std::unique_ptr<MathFunc>(new MathFunc([](long double x, long double y) { return std::log(x) / std::log(y); }, RpnSimd::LOG)));
+    calc->add_function("pow", std::unique_ptr<MathFunc>(new MathFunc([](long double x, long double y) { return std::pow(x, y); }, RpnSimd::POW)));
     calc->add_function("avg", std::unique_ptr<AverageFunc>(new AverageFunc()));
 }
 
 void RPN_API RpnCalculator::addStandardOperators()
 {
-    calc->add_operator("+", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("+"))));
-    calc->add_operator("-", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("-"))));
-    calc->add_operator("*", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("*"))));
-    calc->add_operator("**", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("**"))));
-    calc->add_operator("/", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("/"))));
-    calc->add_operator("%", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("%"))));
-    calc->add_operator("|", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("|"))));
-    calc->add_operator("&", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("&"))));
-    calc->add_operator("^", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("^"))));
-    calc->add_operator(">>", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string(">>"))));
-    calc->add_operator("<<", std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(std::string("<<"))));
+    checkNotFrozen("add operators");
+    cache->clear();
+    for (int opcode = 0; opcode < OPERATOR_COUNT; ++opcode)
+        calc->add_operator(operatorTable[opcode].symbol,
+            std::unique_ptr<ArithmeticOperator>(new ArithmeticOperator(static_cast<OperatorOpcode>(opcode))));
 
 }
 
 RpnCalculator::RpnCalculator(int _verbose) : verbose(_verbose)
 {
     calc = new FunctionShuntingYard();
+    cache = new RpnCache(0);
+    pool = new RpnThreadPool();
+    phaseCounters = new RpnStatsCounters();
 }
 
 RpnCalculator::~RpnCalculator()
 {
+    delete phaseCounters;
+    delete pool;
+    delete cache;
     delete calc;
 }
 
-std::string RPN_API RpnCalculator::calculate_rpn(const std::string &input_rpn) const
+std::shared_ptr<const CompiledProgram> RpnCalculator::optimize(const CompiledProgram& program) const
+{
+    std::shared_ptr<CompiledProgram> optimized;
+    if (optimization) {
+        optimized = RpnOptimizer::foldConstants(program);
+        optimized = RpnOptimizer::eliminateCommonSubexpressions(*optimized);
+        if (verbose)
+            RpnOptimizer::print(*optimized);
+    }
+    else
+        optimized = std::make_shared<CompiledProgram>(program);
+
+    for (const RpnInstruction& instruction : optimized->code) {
+        optimized->operatorApplications += instruction.kind == RpnInstruction::APPLY_OPERATOR;
+        optimized->functionCalls += instruction.kind == RpnInstruction::CALL_FUNCTION;
+    }
+
+    optimized->bytecode = RpnVm::compile(*optimized);
+    if (jit) {
+        optimized->native = RpnJit::compile(*optimized);
+        if (verbose && optimized->native)
+            std::cout << "JIT: " << optimized->native->code_size() << " bytes of native code" << std::endl;
+    }
+    return optimized;
+}
+
+void RPN_API RpnCalculator::enableJit(bool enabled)
+{
+    checkNotFrozen("change JIT settings");
+    jit = enabled;
+    cache->clear();
+}
+
+void RPN_API RpnCalculator::enableOptimization(bool enabled)
+{
+    checkNotFrozen("change optimization settings");
+    optimization = enabled;
+    cache->clear();
+}
+
+void RPN_API RpnCalculator::setResultFormat(const RpnFormat& resultFormat)
+{
+    checkNotFrozen("change the result format");
+    format = resultFormat;
+    cache->clear();
+}
+
+RpnFormat RPN_API RpnCalculator::resultFormat() const
+{
+    return format;
+}
+
+void RpnCalculator::checkNotFrozen(const char* what) const
+{
+    if (frozen)
+        throw std::runtime_error(std::string("Cannot ") + what + " after freeze()");
+}
+
+void RPN_API RpnCalculator::freeze()
+{
+    frozen = true;
+}
+
+bool RPN_API RpnCalculator::isFrozen() const
+{
+    return frozen;
+}
+
+void RPN_API RpnCalculator::setCacheBudget(size_t bytes)
+{
+    cache->setBudget(bytes);
+}
+
+RpnCacheStats RPN_API RpnCalculator::cacheStats() const
+{
+    return cache->stats();
+}
+
+void RPN_API RpnCalculator::clearCache()
+{
+    cache->clear();
+}
+
+void RPN_API RpnCalculator::enableStats(bool enabled)
+{
+#if RPN_STATS
+    phaseCounters->enable(enabled);
+#else
+    if (enabled)
+        throw std::runtime_error("Statistics are not available in this build (RPN_STATS is 0)");
+#endif
+}
+
+RpnStats RPN_API RpnCalculator::stats() const
+{
+    return phaseCounters->snapshot();
+}
+
+void RPN_API RpnCalculator::resetStats()
+{
+    phaseCounters->reset();
+}
+
+CompiledExpression RPN_API RpnCalculator::compile_rpn(const std::string &input_rpn, const std::vector<std::string> &variables) const
 {
-    std::vector<std::string> rpn = calc->tokenize(input_rpn, true);
+    std::vector<RpnToken> rpn = calc->resolveRPN(input_rpn);
     if (verbose)
-        calc->printRPN(rpn);
-    std::string res = calc->evaluateRPN(rpn);
-    return res;
+        calc->printRPN(input_rpn, rpn);
+    return CompiledExpression(optimize(*calc->compile(input_rpn, rpn, variables)));
 }
 
-std::string RPN_API RpnCalculator::calculate(const std::string &input) const
+CompiledExpression RPN_API RpnCalculator::compile(const std::string &input, const std::vector<std::string> &variables) const
 {
-    std::vector<std::string> rpn = calc->infixToRPN(input);
+    std::vector<RpnToken> rpn = calc->infixToRPN(input);
     if (verbose)
-        calc->printRPN(rpn);
-    std::string res = calc->evaluateRPN(rpn);
-    return res;
+        calc->printRPN(input, rpn);
+    return CompiledExpression(optimize(*calc->compile(input, rpn, variables)));
+}
+
+CompiledExpression RpnCalculator::compilePlan(const std::string& input, bool rpn, RpnStatsSample* sample) const
+{
+    if (!sample)
+        return rpn ? compile_rpn(input) : compile(input);
+
+    uint64_t start = RpnStatsCounters::now();
+    std::vector<RpnToken> tokens = rpn ? calc->resolveRPN(input) : calc->tokenize(input, false);
+    uint64_t tokenized = RpnStatsCounters::now();
+    sample->tokens = tokens.size();
+    sample->tokenizeNanoseconds = tokenized - start;
+
+    if (!rpn) {
+        tokens = calc->infixToRPN(input, tokens);
+        sample->parseNanoseconds = RpnStatsCounters::now() - tokenized;
+    }
+    if (verbose)
+        calc->printRPN(input, tokens);
+
+    uint64_t parsed = RpnStatsCounters::now();
+    CompiledExpression plan(optimize(*calc->compile(input, tokens, std::vector<std::string>())));
+    sample->compileNanoseconds = RpnStatsCounters::now() - parsed;
+    return plan;
+}
+
+std::string RpnCalculator::calculateCached(const std::string& input, bool rpn) const
+{
+#if RPN_STATS
+    if (phaseCounters->enabled()) {
+        RpnStatsSample sample;
+        uint64_t start = RpnStatsCounters::now();
+        try {
+            std::string result = calculateCached(input, rpn, &sample);
+            phaseCounters->record(sample, RpnStatsCounters::now() - start, false);
+            return result;
+        }
+        catch (...) {
+            phaseCounters->record(sample, RpnStatsCounters::now() - start, true);
+            throw;
+        }
+    }
+#endif
+    return calculateCached(input, rpn, nullptr);
+}
+
+std::string RpnCalculator::calculateCached(const std::string& input, bool rpn, RpnStatsSample* sample) const
+{
+    bool cached = cache->enabled();
+    std::string key;
+    std::string result;
+    CompiledExpression plan;
+    if (!cached)
+        plan = compilePlan(input, rpn, sample);
+    else {
+        key = RpnCache::normalize(input, rpn);
+        if (cache->findResult(key, result))
+            return result;
+        if (!cache->findPlan(key, plan)) {
+            plan = compilePlan(input, rpn, sample);
+            cache->storePlan(key, plan);
+        }
+    }
+
+    if (!sample)
+        result = plan.evaluate(nullptr, 0, format);
+    else {
+        uint64_t start = RpnStatsCounters::now();
+        result = plan.evaluate(nullptr, 0, format);
+        sample->evaluateNanoseconds = RpnStatsCounters::now() - start;
+        sample->operatorsApplied = plan.compiled_program().operatorApplications;
+        sample->functionCalls = plan.compiled_program().functionCalls;
+    }
+    if (!cached)
+        return result;
+    // Results of functions reading external state, e.g. Stock, must be recomputed.
+    if (RpnCache::isPure(plan.compiled_program()))
+        cache->storeResult(key, result);
+    return result;
+}
+
+std::string RPN_API RpnCalculator::calculate_rpn(const std::string &input_rpn) const
+{
+    return calculateCached(input_rpn, true);
+}
+
+std::string RPN_API RpnCalculator::calculate(const std::string &input) const
+{
+    return calculateCached(input, false);
+}
+
+void RpnCalculator::calculateBatch(const std::string* inputs, size_t count, RpnBatchResult* results, bool rpn) const
+{
+    pool->parallel_for(count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            RpnBatchResult& result = results[i];
+            try {
+                result.value = calculateCached(inputs[i], rpn);
+                result.error.clear();
+                result.failed = false;
+            }
+            catch (const std::exception& e) {
+                result.value.clear();
+                result.error = e.what();
+                result.failed = true;
+            }
+        }
+    });
+}
+
+void RPN_API RpnCalculator::calculate_many(const std::string* inputs, size_t count, RpnBatchResult* results) const
+{
+    calculateBatch(inputs, count, results, false);
+}
+
+std::vector<RpnBatchResult> RPN_API RpnCalculator::calculate_many(const std::vector<std::string> &inputs) const
+{
+    std::vector<RpnBatchResult> results(inputs.size());
+    calculateBatch(inputs.data(), inputs.size(), results.data(), false);
+    return results;
+}
+
+void RPN_API RpnCalculator::calculate_rpn_many(const std::string* inputs, size_t count, RpnBatchResult* results) const
+{
+    calculateBatch(inputs, count, results, true);
+}
+
+void RPN_API RpnCalculator::setWorkerCount(unsigned workers)
+{
+    pool->resize(workers);
+}
+
+unsigned RPN_API RpnCalculator::workerCount() const
+{
+    return pool->size();
+}
+
+const FunctionShuntingYard& RpnCalculator::engine() const
+{
+    return *calc;
 }
 
 void RPN_API RpnCalculator::enumerateFunctions(bool (*scan_func)(std::string const& name, IFunctionInfo const *)) const
@@ -0,0 +1,510 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "RpnFormat.h"
+
+namespace
+{
+    const uint64_t powersOfTen[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+        1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+        100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+        1000000000000000000ull, 10000000000000000000ull,
+    };
+    // Largest precision formatted with integer arithmetic: 10^precision must fit in 64 bits.
+    const int MAX_EXACT_PRECISION = 19;
+
+    // Unsigned 128-bit integer, enough for a 64-bit mantissa times 5^19.
+    struct Uint128
+    {
+        uint64_t high;
+        uint64_t low;
+
+        static Uint128 multiply(uint64_t a, uint64_t b)
+        {
+            const uint64_t a0 = a & 0xFFFFFFFFu, a1 = a >> 32;
+            const uint64_t b0 = b & 0xFFFFFFFFu, b1 = b >> 32;
+            const uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+            const uint64_t middle = (p00 >> 32) + (p01 & 0xFFFFFFFFu) + (p10 & 0xFFFFFFFFu);
+            return Uint128{ p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32), (middle << 32) | (p00 & 0xFFFFFFFFu) };
+        }
+
+        // Bit i, 0 <= i < 128.
+        bool bit(int i) const
+        {
+            return ((i < 64 ? low >> i : high >> (i - 64)) & 1) != 0;
+        }
+
+        // Whether any of the lowest count bits is set, 0 <= count <= 128.
+        bool anyBelow(int count) const
+        {
+            if (count <= 0)
+                return false;
+            if (count < 64)
+                return (low & ((1ull << count) - 1)) != 0;
+            if (low != 0)
+                return true;
+            return count > 64 && (count == 128 ? high : high & ((1ull << (count - 64)) - 1)) != 0;
+        }
+
+        // Shifted right by 0 <= count < 128.
+        Uint128 shiftRight(int count) const
+        {
+            if (count == 0)
+                return *this;
+            if (count < 64)
+                return Uint128{ high >> count, (low >> count) | (high << (64 - count)) };
+            return Uint128{ 0, high >> (count - 64) };
+        }
+    };
+
+    // Writes the decimal digits of value backwards, ending at end. Returns the first digit.
+    char* writeDigits(uint64_t value, char* end)
+    {
+        do {
+            *--end = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        return end;
+    }
+
+    // Replaces the decimal point of the C locale by '.' in text written by printf.
+    void fixDecimalPoint(std::string& out, size_t start)
+    {
+        const char* point = std::localeconv()->decimal_point;
+        if (!point || std::strcmp(point, ".") == 0)
+            return;
+        size_t position = out.find(point, start);
+        if (position != std::string::npos)
+            out.replace(position, std::strlen(point), ".");
+    }
+
+    void appendPrintf(std::string& out, const char* format, int precision, long double value)
+    {
+        const size_t start = out.size();
+        char buffer[512];
+        int length = std::snprintf(buffer, sizeof(buffer), format, precision, value);
+        if (length < 0)
+            return;
+        if (static_cast<size_t>(length) < sizeof(buffer))
+            out.append(buffer, length);
+        else {
+            // Fixed notation of a large value has one digit per power of ten.
+            out.resize(start + length + 1);
+            std::snprintf(&out[start], length + 1, format, precision, value);
+            out.resize(start + length);
+        }
+        fixDecimalPoint(out, start);
+    }
+
+    // Formats a finite value as "%.*Lf" with integer arithmetic. The value is m * 2^e
+    // with a 64-bit m, so value * 10^precision = m * 5^precision * 2^(e + precision),
+    // which is rounded half to even like printf. Returns false if the scaled value does
+    // not fit in 64 bits; the caller then falls back to printf.
+    bool appendFixed(long double value, int precision, std::string& out)
+    {
+        if (precision > MAX_EXACT_PRECISION)
+            return false;
+        const bool negative = std::signbit(value);
+        uint64_t scaled = 0;
+        if (value != 0) {
+            int exponent;
+            long double fraction = std::frexp(std::fabs(value), &exponent);
+            uint64_t mantissa = static_cast<uint64_t>(std::ldexp(fraction, 64));
+            exponent -= 64;
+            while ((mantissa & 1) == 0) {
+                mantissa >>= 1;
+                ++exponent;
+            }
+            uint64_t powerOfFive = 1;
+            for (int i = 0; i < precision; ++i)
+                powerOfFive *= 5;
+            const Uint128 product = Uint128::multiply(mantissa, powerOfFive);
+            const int shift = -(exponent + precision);
+            if (shift <= 0) {
+                if (product.high != 0 || -shift >= 64 || (shift < 0 && (product.low >> (64 + shift)) != 0))
+                    return false;
+                scaled = product.low << -shift;
+            }
+            else {
+                bool roundUp = false;
+                if (shift < 128) {
+                    const Uint128 quotient = product.shiftRight(shift);
+                    if (quotient.high != 0)
+                        return false;
+                    scaled = quotient.low;
+                }
+                if (shift <= 128)
+                    roundUp = product.bit(shift - 1) && (product.anyBelow(shift - 1) || (scaled & 1) != 0);
+                if (roundUp) {
+                    if (scaled == std::numeric_limits<uint64_t>::max())
+                        return false;
+                    ++scaled;
+                }
+            }
+        }
+
+        char buffer[48];
+        char* end = buffer + sizeof(buffer);
+        char* begin = end;
+        if (precision > 0) {
+            uint64_t fractionDigits = scaled % powersOfTen[precision];
+            scaled /= powersOfTen[precision];
+            for (int i = 0; i < precision; ++i) {
+                *--begin = static_cast<char>('0' + fractionDigits % 10);
+                fractionDigits /= 10;
+            }
+            *--begin = '.';
+        }
+        begin = writeDigits(scaled, begin);
+        if (negative)
+            *--begin = '-';
+        out.append(begin, end);
+        return true;
+    }
+
+    // Grisu2 by Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+    // with Integers" (PLDI 2010): the shortest digits are generated from the boundaries of
+    // the rounding interval of the double, scaled by a cached power of ten into a
+    // fixed-point range where 64-bit arithmetic suffices. The digits always read back to
+    // the same double and are the shortest such digits for all but a small fraction of
+    // values, which get at most one extra digit.
+    struct DiyFp
+    {
+        uint64_t f;
+        int e;
+
+        DiyFp operator-(const DiyFp& other) const
+        {
+            return DiyFp{ f - other.f, e };
+        }
+
+        // Product rounded to the upper 64 bits.
+        DiyFp operator*(const DiyFp& other) const
+        {
+            const Uint128 product = Uint128::multiply(f, other.f);
+            return DiyFp{ product.high + (product.low >> 63), e + other.e + 64 };
+        }
+
+        DiyFp normalize() const
+        {
+            DiyFp result = *this;
+            while ((result.f & (1ull << 63)) == 0) {
+                result.f <<= 1;
+                --result.e;
+            }
+            return result;
+        }
+    };
+
+    const int DOUBLE_MANTISSA_BITS = 52;
+    const uint64_t DOUBLE_HIDDEN_BIT = 1ull << DOUBLE_MANTISSA_BITS;
+
+    // Powers of ten 10^k for k = -348, -340, ..., 340 as normalized 64-bit mantissas.
+    struct CachedPower
+    {
+        uint64_t f;
+        short e;
+        short k;
+    };
+    const CachedPower cachedPowers[] = {
+        { 0xfa8fd5a0081c0288ull, -1220, -348 },
+        { 0xbaaee17fa23ebf76ull, -1193, -340 },
+        { 0x8b16fb203055ac76ull, -1166, -332 },
+        { 0xcf42894a5dce35eaull, -1140, -324 },
+        { 0x9a6bb0aa55653b2dull, -1113, -316 },
+        { 0xe61acf033d1a45dfull, -1087, -308 },
+        { 0xab70fe17c79ac6caull, -1060, -300 },
+        { 0xff77b1fcbebcdc4full, -1034, -292 },
+        { 0xbe5691ef416bd60cull, -1007, -284 },
+        { 0x8dd01fad907ffc3cull, -980, -276 },
+        { 0xd3515c2831559a83ull, -954, -268 },
+        { 0x9d71ac8fada6c9b5ull, -927, -260 },
+        { 0xea9c227723ee8bcbull, -901, -252 },
+        { 0xaecc49914078536dull, -874, -244 },
+        { 0x823c12795db6ce57ull, -847, -236 },
+        { 0xc21094364dfb5637ull, -821, -228 },
+        { 0x9096ea6f3848984full, -794, -220 },
+        { 0xd77485cb25823ac7ull, -768, -212 },
+        { 0xa086cfcd97bf97f4ull, -741, -204 },
+        { 0xef340a98172aace5ull, -715, -196 },
+        { 0xb23867fb2a35b28eull, -688, -188 },
+        { 0x84c8d4dfd2c63f3bull, -661, -180 },
+        { 0xc5dd44271ad3cdbaull, -635, -172 },
+        { 0x936b9fcebb25c996ull, -608, -164 },
+        { 0xdbac6c247d62a584ull, -582, -156 },
+        { 0xa3ab66580d5fdaf6ull, -555, -148 },
+        { 0xf3e2f893dec3f126ull, -529, -140 },
+        { 0xb5b5ada8aaff80b8ull, -502, -132 },
+        { 0x87625f056c7c4a8bull, -475, -124 },
+        { 0xc9bcff6034c13053ull, -449, -116 },
+        { 0x964e858c91ba2655ull, -422, -108 },
+        { 0xdff9772470297ebdull, -396, -100 },
+        { 0xa6dfbd9fb8e5b88full, -369, -92 },
+        { 0xf8a95fcf88747d94ull, -343, -84 },
+        { 0xb94470938fa89bcfull, -316, -76 },
+        { 0x8a08f0f8bf0f156bull, -289, -68 },
+        { 0xcdb02555653131b6ull, -263, -60 },
+        { 0x993fe2c6d07b7facull, -236, -52 },
+        { 0xe45c10c42a2b3b06ull, -210, -44 },
+        { 0xaa242499697392d3ull, -183, -36 },
+        { 0xfd87b5f28300ca0eull, -157, -28 },
+        { 0xbce5086492111aebull, -130, -20 },
+        { 0x8cbccc096f5088ccull, -103, -12 },
+        { 0xd1b71758e219652cull, -77, -4 },
+        { 0x9c40000000000000ull, -50, 4 },
+        { 0xe8d4a51000000000ull, -24, 12 },
+        { 0xad78ebc5ac620000ull, 3, 20 },
+        { 0x813f3978f8940984ull, 30, 28 },
+        { 0xc097ce7bc90715b3ull, 56, 36 },
+        { 0x8f7e32ce7bea5c70ull, 83, 44 },
+        { 0xd5d238a4abe98068ull, 109, 52 },
+        { 0x9f4f2726179a2245ull, 136, 60 },
+        { 0xed63a231d4c4fb27ull, 162, 68 },
+        { 0xb0de65388cc8ada8ull, 189, 76 },
+        { 0x83c7088e1aab65dbull, 216, 84 },
+        { 0xc45d1df942711d9aull, 242, 92 },
+        { 0x924d692ca61be758ull, 269, 100 },
+        { 0xda01ee641a708deaull, 295, 108 },
+        { 0xa26da3999aef774aull, 322, 116 },
+        { 0xf209787bb47d6b85ull, 348, 124 },
+        { 0xb454e4a179dd1877ull, 375, 132 },
+        { 0x865b86925b9bc5c2ull, 402, 140 },
+        { 0xc83553c5c8965d3dull, 428, 148 },
+        { 0x952ab45cfa97a0b3ull, 455, 156 },
+        { 0xde469fbd99a05fe3ull, 481, 164 },
+        { 0xa59bc234db398c25ull, 508, 172 },
+        { 0xf6c69a72a3989f5cull, 534, 180 },
+        { 0xb7dcbf5354e9beceull, 561, 188 },
+        { 0x88fcf317f22241e2ull, 588, 196 },
+        { 0xcc20ce9bd35c78a5ull, 614, 204 },
+        { 0x98165af37b2153dfull, 641, 212 },
+        { 0xe2a0b5dc971f303aull, 667, 220 },
+        { 0xa8d9d1535ce3b396ull, 694, 228 },
+        { 0xfb9b7cd9a4a7443cull, 720, 236 },
+        { 0xbb764c4ca7a44410ull, 747, 244 },
+        { 0x8bab8eefb6409c1aull, 774, 252 },
+        { 0xd01fef10a657842cull, 800, 260 },
+        { 0x9b10a4e5e9913129ull, 827, 268 },
+        { 0xe7109bfba19c0c9dull, 853, 276 },
+        { 0xac2820d9623bf429ull, 880, 284 },
+        { 0x80444b5e7aa7cf85ull, 907, 292 },
+        { 0xbf21e44003acdd2dull, 933, 300 },
+        { 0x8e679c2f5e44ff8full, 960, 308 },
+        { 0xd433179d9c8cb841ull, 986, 316 },
+        { 0x9e19db92b4e31ba9ull, 1013, 324 },
+        { 0xeb96bf6ebadf77d9ull, 1039, 332 },
+        { 0xaf87023b9bf0ee6bull, 1066, 340 },    };
+
+    // Returns a cached power c = 10^-k with binary exponent such that c * w has its
+    // exponent in [-60, -32] for a normalized w with binary exponent e.
+    DiyFp cachedPower(int e, int& k)
+    {
+        const double dk = (-61 - e) * 0.30102999566398114 + 347;
+        int index = static_cast<int>(dk);
+        if (dk - index > 0.0)
+            ++index;
+        index = (index >> 3) + 1;
+        k = -cachedPowers[index].k;
+        return DiyFp{ cachedPowers[index].f, cachedPowers[index].e };
+    }
+
+    // Moves the last digit towards w while the result stays inside the rounding interval.
+    void roundWeed(char* digits, int length, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance)
+    {
+        while (rest < distance && delta - rest >= tenKappa &&
+            (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance)) {
+            digits[length - 1]--;
+            rest += tenKappa;
+        }
+    }
+
+    // Generates the digits of high, stopping as soon as they identify a value above low.
+    // w is the value itself, delta = high - low. Sets k to the decimal exponent of the last digit.
+    int generateDigits(const DiyFp& w, const DiyFp& high, uint64_t delta, char* digits, int& k)
+    {
+        const DiyFp one{ 1ull << -high.e, high.e };
+        const uint64_t distance = (high - w).f;
+        uint32_t integral = static_cast<uint32_t>(high.f >> -one.e);
+        uint64_t fraction = high.f & (one.f - 1);
+        int kappa = 1;
+        while (kappa < 10 && integral >= powersOfTen[kappa])
+            ++kappa;
+
+        int length = 0;
+        while (kappa > 0) {
+            const uint32_t divisor = static_cast<uint32_t>(powersOfTen[kappa - 1]);
+            const uint32_t digit = integral / divisor;
+            integral %= divisor;
+            if (digit != 0 || length != 0)
+                digits[length++] = static_cast<char>('0' + digit);
+            --kappa;
+            const uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fraction;
+            if (rest <= delta) {
+                k += kappa;
+                roundWeed(digits, length, delta, rest, powersOfTen[kappa] << -one.e, distance);
+                return length;
+            }
+        }
+        for (;;) {
+            fraction *= 10;
+            delta *= 10;
+            const char digit = static_cast<char>(fraction >> -one.e);
+            if (digit != 0 || length != 0)
+                digits[length++] = static_cast<char>('0' + digit);
+            fraction &= one.f - 1;
+            --kappa;
+            if (fraction < delta) {
+                k += kappa;
+                roundWeed(digits, length, delta, fraction, one.f, -kappa < 20 ? distance * powersOfTen[-kappa] : 0);
+                return length;
+            }
+        }
+    }
+
+    // Shortest digits of a positive finite double: value = digits * 10^k.
+    // Returns the number of digits, at most 17.
+    int shortestDigits(double value, char* digits, int& k)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const int biasedExponent = static_cast<int>(bits >> DOUBLE_MANTISSA_BITS) & 0x7FF;
+        const uint64_t significand = bits & (DOUBLE_HIDDEN_BIT - 1);
+        const DiyFp v = biasedExponent != 0 ?
+            DiyFp{ significand + DOUBLE_HIDDEN_BIT, biasedExponent - 1075 } :
+            DiyFp{ significand, -1074 };
+
+        // Boundaries halfway to the neighbouring doubles; the lower one is closer when v
+        // is a power of two, as the doubles below it are twice as dense.
+        const DiyFp high = DiyFp{ (v.f << 1) + 1, v.e - 1 }.normalize();
+        DiyFp low = v.f == DOUBLE_HIDDEN_BIT && biasedExponent > 1 ?
+            DiyFp{ (v.f << 2) - 1, v.e - 2 } : DiyFp{ (v.f << 1) - 1, v.e - 1 };
+        low.f <<= low.e - high.e;
+        low.e = high.e;
+
+        const DiyFp power = cachedPower(high.e, k);
+        const DiyFp w = v.normalize() * power;
+        DiyFp scaledHigh = high * power;
+        DiyFp scaledLow = low * power;
+        // The products may be off by one unit; stay inside the interval.
+        ++scaledLow.f;
+        --scaledHigh.f;
+        return generateDigits(w, scaledHigh, scaledHigh.f - scaledLow.f, digits, k);
+    }
+
+    // Lays out digits * 10^k: plain decimal notation if the decimal point falls within
+    // 21 digits left or 6 zeros right of the digits, exponent notation otherwise.
+    void appendShortest(double value, std::string& out)
+    {
+        if (value == 0) {
+            out += std::signbit(value) ? "-0" : "0";
+            return;
+        }
+        char digits[24];
+        int k = 0;
+        const int length = shortestDigits(std::fabs(value), digits, k);
+        // Position of the decimal point relative to the first digit.
+        const int point = length + k;
+        if (value < 0)
+            out += '-';
+
+        if (k >= 0 && point <= 21) {
+            out.append(digits, length);
+            out.append(k, '0');
+        }
+        else if (point > 0 && point <= 21) {
+            out.append(digits, point);
+            out += '.';
+            out.append(digits + point, length - point);
+        }
+        else if (point > -6 && point <= 0) {
+            out += "0.";
+            out.append(-point, '0');
+            out.append(digits, length);
+        }
+        else {
+            out += digits[0];
+            if (length > 1) {
+                out += '.';
+                out.append(digits + 1, length - 1);
+            }
+            const int exponent = point - 1;
+            out += exponent < 0 ? "e-" : "e+";
+            char buffer[8];
+            char* end = buffer + sizeof(buffer);
+            out.append(writeDigits(static_cast<uint64_t>(exponent < 0 ? -exponent : exponent), end), end);
+        }
+    }
+}
+
+void RPN_API RpnFormat::appendInteger(long long value, std::string& out) const
+{
+    if (mode == SCIENTIFIC && !exactIntegers) {
+        append(static_cast<long double>(value), out);
+        return;
+    }
+    out += std::to_string(value);
+    if (mode == FIXED && !exactIntegers && precision != 0) {
+        out += '.';
+        out.append(precision < 0 ? 6 : precision, '0');
+    }
+}
+
+void RPN_API RpnFormat::append(long double value, std::string& out) const
+{
+    if (std::isnan(value)) {
+        out += "nan";
+        return;
+    }
+    if (std::isinf(value)) {
+        out += value < 0 ? "-inf" : "inf";
+        return;
+    }
+    const int digits = precision < 0 ? 6 : precision;
+    switch (mode) {
+    case SHORTEST:
+    {
+        const double rounded = static_cast<double>(value);
+        if (std::isinf(rounded))
+            appendPrintf(out, "%.*Le", std::numeric_limits<long double>::max_digits10 - 1, value);
+        else
+            appendShortest(rounded, out);
+        break;
+    }
+    case SCIENTIFIC:
+        appendPrintf(out, "%.*Le", digits, value);
+        break;
+    default:
+        if (!appendFixed(value, digits, out))
+            appendPrintf(out, "%.*Lf", digits, value);
+        break;
+    }
+}
@@ -0,0 +1,421 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include "RpnJit.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define RPN_JIT_X64
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+
+#ifdef RPN_JIT_X64
+namespace
+{
+    // General purpose registers used as the base of memory operands. rbx holds the
+    // variables and r12 the constants; both are preserved across calls in either ABI.
+    enum Base
+    {
+        RBX = 3,
+        RSP = 4,
+        R12 = 12,
+    };
+
+    // Memory operand [base + displacement].
+    struct Operand
+    {
+        Base base;
+        int displacement;
+    };
+
+    // Opcodes of the SSE2 scalar double instructions used, all with the F2 prefix.
+    enum SseOpcode
+    {
+        MOVSD_LOAD = 0x10,
+        MOVSD_STORE = 0x11,
+        SQRTSD = 0x51,
+        ADDSD = 0x58,
+        MULSD = 0x59,
+        SUBSD = 0x5C,
+        DIVSD = 0x5E,
+    };
+
+    // Size of the shadow space callers reserve for the callee in the Windows x64 ABI.
+    // Reserved on every platform to keep a single frame layout.
+    const int SHADOW_SPACE = 32;
+
+    class Assembler
+    {
+    public:
+        std::vector<unsigned char> code;
+
+        void bytes(std::initializer_list<unsigned char> values)
+        {
+            code.insert(code.end(), values);
+        }
+
+        void imm32(uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+                code.push_back(static_cast<unsigned char>(value >> (8 * i)));
+        }
+
+        void imm64(uint64_t value)
+        {
+            for (int i = 0; i < 8; ++i)
+                code.push_back(static_cast<unsigned char>(value >> (8 * i)));
+        }
+
+        // opcode xmm, [base + displacement], or movsd [base + displacement], xmm.
+        void sse(SseOpcode opcode, int xmm, Operand operand)
+        {
+            code.push_back(0xF2);
+            if (operand.base == R12)
+                code.push_back(0x41);
+            code.push_back(0x0F);
+            code.push_back(static_cast<unsigned char>(opcode));
+            code.push_back(static_cast<unsigned char>(0x80 | xmm << 3 | (operand.base & 7)));
+            if ((operand.base & 7) == RSP)
+                code.push_back(0x24);
+            imm32(static_cast<uint32_t>(operand.displacement));
+        }
+
+        void prologue(uint32_t frame)
+        {
+            bytes({ 0x53 });                    // push rbx
+            bytes({ 0x41, 0x54 });              // push r12
+            bytes({ 0x48, 0x81, 0xEC });        // sub rsp, frame
+            imm32(frame);
+#ifdef _WIN32
+            bytes({ 0x48, 0x89, 0xCB });        // mov rbx, rcx
+            bytes({ 0x49, 0x89, 0xD4 });        // mov r12, rdx
+#else
+            bytes({ 0x48, 0x89, 0xFB });        // mov rbx, rdi
+            bytes({ 0x49, 0x89, 0xF4 });        // mov r12, rsi
+#endif
+        }
+
+        void epilogue(uint32_t frame)
+        {
+            bytes({ 0x48, 0x81, 0xC4 });        // add rsp, frame
+            imm32(frame);
+            bytes({ 0x41, 0x5C });              // pop r12
+            bytes({ 0x5B });                    // pop rbx
+            bytes({ 0xC3 });                    // ret
+        }
+
+        // Calls a C function taking its arguments in xmm0 and xmm1 and returning in xmm0.
+        void call(uintptr_t target)
+        {
+            bytes({ 0x48, 0xB8 });              // mov rax, target
+            imm64(target);
+            bytes({ 0xFF, 0xD0 });              // call rax
+        }
+    };
+
+    typedef double(*UnaryFunction)(double x);
+    typedef double(*BinaryFunction)(double x, double y);
+
+    // The C library functions called for the standard math functions; nullptr where the
+    // operation is emitted inline.
+    uintptr_t libraryFunction(RpnSimd::Function function)
+    {
+        UnaryFunction unary = nullptr;
+        BinaryFunction binary = nullptr;
+        switch (function) {
+        case RpnSimd::SIN: unary = [](double x) { return std::sin(x); }; break;
+        case RpnSimd::COS: unary = [](double x) { return std::cos(x); }; break;
+        case RpnSimd::TAN: unary = [](double x) { return std::tan(x); }; break;
+        case RpnSimd::ASIN: unary = [](double x) { return std::asin(x); }; break;
+        case RpnSimd::ACOS: unary = [](double x) { return std::acos(x); }; break;
+        case RpnSimd::ATAN: unary = [](double x) { return std::atan(x); }; break;
+        case RpnSimd::LN: unary = [](double x) { return std::log(x); }; break;
+        case RpnSimd::LG: unary = [](double x) { return std::log10(x); }; break;
+        case RpnSimd::EXPN: unary = [](double x) { return std::exp(x); }; break;
+        case RpnSimd::FLOOR: unary = [](double x) { return std::floor(x); }; break;
+        case RpnSimd::CEIL: unary = [](double x) { return std::ceil(x); }; break;
+        case RpnSimd::POW: binary = [](double x, double y) { return std::pow(x, y); }; break;
+        case RpnSimd::LOG: binary = [](double x, double y) { return std::log(x) / std::log(y); }; break;
+        default: break;
+        }
+        return unary ? reinterpret_cast<uintptr_t>(unary) : reinterpret_cast<uintptr_t>(binary);
+    }
+
+    // Returns the native form of an operator or function application, or NONE if the
+    // instruction is not one or its parameter count does not fit the operation.
+    RpnNativeOperation nativeOperation(const CompiledProgram& program, const RpnInstruction& instruction)
+    {
+        RpnNativeOperation operation;
+        if (instruction.kind == RpnInstruction::APPLY_OPERATOR)
+            operation = program.operators[instruction.index].info->native();
+        else if (instruction.kind == RpnInstruction::CALL_FUNCTION)
+            operation = program.functions[instruction.index].info->native();
+
+        switch (operation.kind) {
+        case RpnNativeOperation::ADD:
+        case RpnNativeOperation::SUBTRACT:
+        case RpnNativeOperation::MULTIPLY:
+        case RpnNativeOperation::DIVIDE:
+            return instruction.arity == 2 ? operation : RpnNativeOperation();
+        case RpnNativeOperation::AVERAGE:
+            return instruction.arity >= 1 ? operation : RpnNativeOperation();
+        case RpnNativeOperation::FUNCTION:
+            if (operation.function < 0 || operation.function >= RpnSimd::FUNCTION_COUNT)
+                return RpnNativeOperation();
+            return instruction.arity == RpnSimd::arity(operation.function) ? operation : RpnNativeOperation();
+        default:
+            return RpnNativeOperation();
+        }
+    }
+
+    // Checks that every instruction can be generated and that no value of the program is an
+    // integer in the interpreter. Integer constants are accepted only where they convert to
+    // double exactly and are consumed as floating point operands; an operation of two integers
+    // that the interpreter keeps exact (+ - * **), even in a sub-expression whose value then
+    // feeds floating point arithmetic, rejects the program. Returns the maximal stack depth,
+    // or 0 if the program cannot be generated.
+    size_t nativeDepth(const CompiledProgram& program)
+    {
+        // Whether each stack entry and temporary holds an integer constant or its copy.
+        std::vector<bool> integer;
+        std::vector<bool> temporaryInteger(program.temporaries);
+        size_t maxDepth = 0;
+        const long long exactLimit = 1LL << 53;
+
+        for (const RpnInstruction& instruction : program.code) {
+            switch (instruction.kind) {
+            case RpnInstruction::PUSH_CONSTANT:
+            {
+                const RpnValue& constant = program.constants[instruction.index];
+                if (constant.kind == RpnValue::STRING)
+                    return 0;
+                if (constant.kind == RpnValue::INTEGER && (constant.i > exactLimit || constant.i < -exactLimit))
+                    return 0;
+                integer.push_back(constant.kind == RpnValue::INTEGER);
+                break;
+            }
+            case RpnInstruction::PUSH_VARIABLE:
+                integer.push_back(false);
+                break;
+            case RpnInstruction::PUSH_TEMPORARY:
+                integer.push_back(temporaryInteger[instruction.index]);
+                break;
+            case RpnInstruction::STORE_TEMPORARY:
+                if (integer.empty())
+                    return 0;
+                temporaryInteger[instruction.index] = integer.back();
+                break;
+            default:
+            {
+                const RpnNativeOperation operation = nativeOperation(program, instruction);
+                if (operation.kind == RpnNativeOperation::NONE)
+                    return 0;
+                if (integer.size() < static_cast<size_t>(instruction.arity))
+                    return 0;
+                // +, -, * and ** of two integers may give an exact integer in the interpreter.
+                const bool integerOperator = instruction.kind == RpnInstruction::APPLY_OPERATOR &&
+                    ((operation.kind >= RpnNativeOperation::ADD && operation.kind <= RpnNativeOperation::MULTIPLY) ||
+                     (operation.kind == RpnNativeOperation::FUNCTION && operation.function == RpnSimd::POW));
+                if (integerOperator && instruction.arity == 2 && integer[integer.size() - 1] && integer[integer.size() - 2])
+                    return 0;
+                integer.resize(integer.size() - instruction.arity);
+                integer.push_back(false);
+                break;
+            }
+            }
+            maxDepth = std::max(maxDepth, integer.size());
+        }
+        return integer.size() == 1 && !integer.back() ? maxDepth : 0;
+    }
+}
+#endif
+
+bool RPN_API RpnJit::available()
+{
+#ifdef RPN_JIT_X64
+    return true;
+#else
+    return false;
+#endif
+}
+
+RpnJit::~RpnJit()
+{
+#ifdef RPN_JIT_X64
+    if (memory) {
+#ifdef _WIN32
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, mapped);
+#endif
+    }
+#endif
+}
+
+std::shared_ptr<const RpnJit> RpnJit::compile(const CompiledProgram& program)
+{
+#ifdef RPN_JIT_X64
+    size_t maxDepth = nativeDepth(program);
+    if (maxDepth == 0)
+        return nullptr;
+
+    std::shared_ptr<RpnJit> jit(new RpnJit());
+    for (const RpnValue& constant : program.constants)
+        jit->constants.push_back(static_cast<double>(constant.as_float()));
+    auto addConstant = [&](double value) {
+        jit->constants.push_back(value);
+        return Operand{ R12, static_cast<int>((jit->constants.size() - 1) * sizeof(double)) };
+    };
+    uint64_t absMaskBits = 0x7FFFFFFFFFFFFFFFull;
+    double absMask;
+    std::memcpy(&absMask, &absMaskBits, sizeof(absMask));
+
+    // Frame: shadow space, then one slot per stack entry and temporary. rsp must be 16-byte
+    // aligned at calls; it is 8 modulo 16 after the return address and the two pushes.
+    size_t slots = maxDepth + program.temporaries;
+    uint32_t frame = static_cast<uint32_t>(SHADOW_SPACE + slots * sizeof(double));
+    if (frame % 16 == 0)
+        frame += 8;
+    auto slot = [](size_t index) {
+        return Operand{ RSP, static_cast<int>(SHADOW_SPACE + index * sizeof(double)) };
+    };
+
+    // Stack entries are memory operands: constants and variables are used where they are,
+    // results of operations live in the frame slot of their stack position.
+    std::vector<Operand> stack;
+    std::vector<Operand> temporaries(program.temporaries);
+    Assembler assembler;
+    assembler.prologue(frame);
+
+    for (const RpnInstruction& instruction : program.code) {
+        switch (instruction.kind) {
+        case RpnInstruction::PUSH_CONSTANT:
+            stack.push_back(Operand{ R12, static_cast<int>(instruction.index * sizeof(double)) });
+            continue;
+
+        case RpnInstruction::PUSH_VARIABLE:
+            stack.push_back(Operand{ RBX, static_cast<int>(instruction.index * sizeof(double)) });
+            continue;
+
+        case RpnInstruction::PUSH_TEMPORARY:
+            stack.push_back(temporaries[instruction.index]);
+            continue;
+
+        case RpnInstruction::STORE_TEMPORARY:
+            // Frame slots of the stack are reused, so results are copied out of them.
+            if (stack.back().base == RSP) {
+                temporaries[instruction.index] = slot(maxDepth + instruction.index);
+                assembler.sse(MOVSD_LOAD, 0, stack.back());
+                assembler.sse(MOVSD_STORE, 0, temporaries[instruction.index]);
+            }
+            else
+                temporaries[instruction.index] = stack.back();
+            continue;
+
+        default:
+            break;
+        }
+
+        RpnNativeOperation operation = nativeOperation(program, instruction);
+        size_t base = stack.size() - instruction.arity;
+        const Operand* args = stack.data() + base;
+        switch (operation.kind) {
+        case RpnNativeOperation::ADD:
+        case RpnNativeOperation::SUBTRACT:
+        case RpnNativeOperation::MULTIPLY:
+        case RpnNativeOperation::DIVIDE:
+        {
+            const SseOpcode opcodes[] = { ADDSD, SUBSD, MULSD, DIVSD };
+            assembler.sse(MOVSD_LOAD, 0, args[0]);
+            assembler.sse(opcodes[operation.kind - RpnNativeOperation::ADD], 0, args[1]);
+            break;
+        }
+        case RpnNativeOperation::AVERAGE:
+            // Same order of additions as AverageFunc, starting from 0.
+            assembler.bytes({ 0x66, 0x0F, 0x57, 0xC0 });        // xorpd xmm0, xmm0
+            for (int i = 0; i < instruction.arity; ++i)
+                assembler.sse(ADDSD, 0, args[i]);
+            assembler.sse(DIVSD, 0, addConstant(instruction.arity));
+            break;
+        default:
+            if (operation.function == RpnSimd::SQRT)
+                assembler.sse(SQRTSD, 0, args[0]);
+            else if (operation.function == RpnSimd::ABS) {
+                assembler.sse(MOVSD_LOAD, 0, args[0]);
+                assembler.sse(MOVSD_LOAD, 1, addConstant(absMask));
+                assembler.bytes({ 0x66, 0x0F, 0x54, 0xC1 });    // andpd xmm0, xmm1
+            }
+            else {
+                assembler.sse(MOVSD_LOAD, 0, args[0]);
+                if (instruction.arity == 2)
+                    assembler.sse(MOVSD_LOAD, 1, args[1]);
+                assembler.call(libraryFunction(operation.function));
+            }
+            break;
+        }
+        stack.resize(base);
+        stack.push_back(slot(base));
+        assembler.sse(MOVSD_STORE, 0, stack.back());
+    }
+
+    assembler.sse(MOVSD_LOAD, 0, stack.back());
+    assembler.epilogue(frame);
+
+    // Write the code, then make the page executable and no longer writable.
+    jit->size = assembler.code.size();
+    jit->mapped = (jit->size + 4095) & ~static_cast<size_t>(4095);
+#ifdef _WIN32
+    jit->memory = VirtualAlloc(nullptr, jit->mapped, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!jit->memory)
+        return nullptr;
+    std::memcpy(jit->memory, assembler.code.data(), jit->size);
+    DWORD protection;
+    if (!VirtualProtect(jit->memory, jit->mapped, PAGE_EXECUTE_READ, &protection))
+        return nullptr;
+    FlushInstructionCache(GetCurrentProcess(), jit->memory, jit->size);
+#else
+    void* memory = mmap(nullptr, jit->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return nullptr;
+    jit->memory = memory;
+    std::memcpy(jit->memory, assembler.code.data(), jit->size);
+    if (mprotect(jit->memory, jit->mapped, PROT_READ | PROT_EXEC) != 0)
+        return nullptr;
+#endif
+    jit->entry = reinterpret_cast<Entry>(jit->memory);
+    return jit;
+#else
+    return nullptr;
+#endif
+}
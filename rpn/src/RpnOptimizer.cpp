@@ -0,0 +1,318 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include "RpnOptimizer.h"
+
+
+std::shared_ptr<CompiledProgram> RpnOptimizer::foldConstants(const CompiledProgram& program)
+{
+    std::shared_ptr<CompiledProgram> folded = std::make_shared<CompiledProgram>();
+    folded->variables = program.variables;
+    folded->operators = program.operators;
+    folded->functions = program.functions;
+
+    // For every stack entry, whether it holds a constant. A constant entry is always produced
+    // by a single PUSH_CONSTANT, so the operands of a foldable instruction are the last
+    // instructions emitted so far.
+    std::vector<bool> isConstant;
+    // Cleared after a variadic call whose parameter count is only known at run time.
+    bool tracking = true;
+    size_t depth = 0;
+    RpnValue result;
+
+    for (const RpnInstruction& instruction : program.code) {
+        RpnInstruction out = instruction;
+        size_t arity = instruction.arity < 0 ? 0 : static_cast<size_t>(instruction.arity);
+        bool pushesConstant = false;
+
+        switch (instruction.kind) {
+        case RpnInstruction::PUSH_CONSTANT:
+            out.index = static_cast<int>(folded->constants.size());
+            folded->constants.push_back(program.constants[instruction.index]);
+            pushesConstant = true;
+            break;
+
+        case RpnInstruction::PUSH_VARIABLE:
+        case RpnInstruction::STORE_TEMPORARY:
+        case RpnInstruction::PUSH_TEMPORARY:
+            // Not foldable. Temporaries only appear after sub-expression elimination.
+            break;
+
+        case RpnInstruction::APPLY_OPERATOR:
+        case RpnInstruction::CALL_FUNCTION:
+        {
+            if (!tracking || instruction.arity < 0 || isConstant.size() < arity)
+                break;
+            bool pure = instruction.kind == RpnInstruction::APPLY_OPERATOR ?
+                program.operators[instruction.index].info->isPure() :
+                program.functions[instruction.index].info->isPure();
+            if (!pure || !std::all_of(isConstant.end() - arity, isConstant.end(), [](bool c) { return c; }))
+                break;
+
+            size_t base = folded->constants.size() - arity;
+            try {
+                if (instruction.kind == RpnInstruction::APPLY_OPERATOR)
+                    program.operators[instruction.index].info->calculate(folded->constants.data() + base, result);
+                else
+                    program.functions[instruction.index].info->calculate(folded->constants.data() + base, static_cast<int>(arity), result);
+            }
+            catch (const std::exception&) {
+                // Leave the error to be reported when the expression is evaluated.
+                break;
+            }
+            folded->code.resize(folded->code.size() - arity);
+            folded->constants.resize(base);
+            isConstant.resize(isConstant.size() - arity);
+            depth -= arity;
+
+            out.kind = RpnInstruction::PUSH_CONSTANT;
+            out.arity = 0;
+            out.index = static_cast<int>(base);
+            folded->constants.push_back(std::move(result));
+            pushesConstant = true;
+            arity = 0;
+            break;
+        }
+        }
+
+        if (instruction.arity < 0 && instruction.kind == RpnInstruction::CALL_FUNCTION)
+            tracking = false;
+        if (tracking) {
+            isConstant.resize(isConstant.size() - arity);
+            isConstant.push_back(pushesConstant);
+            depth = depth - arity + 1;
+            folded->maxDepth = std::max(folded->maxDepth, depth);
+        }
+        folded->code.push_back(out);
+    }
+
+    if (!tracking)
+        folded->maxDepth = std::max(folded->maxDepth, program.maxDepth);
+    return folded;
+}
+
+namespace
+{
+    // Node of the expression DAG. Equal pure sub-expressions share one node.
+    struct DagNode
+    {
+        size_t uses = 0;
+        int temporary = -1;
+    };
+
+    bool isApplication(const RpnInstruction& instruction)
+    {
+        return instruction.kind == RpnInstruction::APPLY_OPERATOR || instruction.kind == RpnInstruction::CALL_FUNCTION;
+    }
+
+    // Appends words that identify a constant by its exact value to a value numbering key.
+    void appendConstantKey(std::vector<int>& key, const RpnValue& value)
+    {
+        // Integers that print differently are different constants.
+        key.push_back(value.kind | (value.arithmetic ? 0x100 : 0));
+        switch (value.kind) {
+        case RpnValue::INTEGER:
+        {
+            unsigned long long bits = static_cast<unsigned long long>(value.i);
+            key.push_back(static_cast<int>(bits & 0xFFFFFFFFu));
+            key.push_back(static_cast<int>(bits >> 32));
+            break;
+        }
+        case RpnValue::FLOAT:
+        {
+            // Sign, exponent and mantissa describe the value without the padding bytes
+            // that long double may have in memory.
+            int exponent = 0;
+            unsigned long long mantissa = 0;
+            int sign = std::signbit(value.f) ? 1 : 0;
+            if (std::isfinite(value.f))
+                mantissa = static_cast<unsigned long long>(std::ldexp(std::fabs(std::frexp(value.f, &exponent)), 64));
+            else
+                sign |= std::isnan(value.f) ? 4 : 2;
+            key.push_back(sign);
+            key.push_back(exponent);
+            key.push_back(static_cast<int>(mantissa & 0xFFFFFFFFu));
+            key.push_back(static_cast<int>(mantissa >> 32));
+            break;
+        }
+        case RpnValue::STRING:
+            key.insert(key.end(), value.s.begin(), value.s.end());
+            break;
+        }
+    }
+
+    size_t hashKey(const int* key, size_t length)
+    {
+        unsigned long long hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; ++i)
+            hash = (hash ^ static_cast<unsigned>(key[i])) * 1099511628211ull;
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+}
+
+std::shared_ptr<CompiledProgram> RpnOptimizer::eliminateCommonSubexpressions(const CompiledProgram& program)
+{
+    std::shared_ptr<CompiledProgram> optimized = std::make_shared<CompiledProgram>(program);
+
+    // Value numbering: a pure node is identified by its instruction kind, the table index
+    // and its operand nodes. Constants are identified by their value, not their index.
+    // The keys of all nodes are stored back to back in one array and found through an
+    // open addressing table, so numbering an instruction allocates nothing.
+    std::vector<DagNode> nodes;
+    std::vector<int> keys;
+    std::vector<size_t> keyStarts(1, 0);
+    size_t capacity = 16;
+    while (capacity < program.code.size() * 2)
+        capacity *= 2;
+    std::vector<int> table(capacity, -1);
+    std::vector<int> instructionNodes;
+    std::vector<int> stack;
+    nodes.reserve(program.code.size());
+    instructionNodes.reserve(program.code.size());
+
+    for (const RpnInstruction& instruction : program.code) {
+        if (instruction.arity < 0 || stack.size() < static_cast<size_t>(instruction.arity))
+            return optimized;
+
+        size_t keyStart = keys.size();
+        keys.push_back(instruction.kind);
+        keys.push_back(instruction.index);
+        keys.insert(keys.end(), stack.end() - instruction.arity, stack.end());
+        stack.resize(stack.size() - instruction.arity);
+
+        bool pure;
+        switch (instruction.kind) {
+        case RpnInstruction::PUSH_CONSTANT:
+            keys.pop_back();
+            appendConstantKey(keys, program.constants[instruction.index]);
+            pure = true;
+            break;
+        case RpnInstruction::PUSH_VARIABLE:
+            pure = true;
+            break;
+        case RpnInstruction::APPLY_OPERATOR:
+            pure = program.operators[instruction.index].info->isPure();
+            break;
+        case RpnInstruction::CALL_FUNCTION:
+            pure = program.functions[instruction.index].info->isPure();
+            break;
+        default:
+            return optimized;
+        }
+
+        int node = static_cast<int>(nodes.size());
+        if (pure) {
+            const size_t keyLength = keys.size() - keyStart;
+            for (size_t slot = hashKey(&keys[keyStart], keyLength) & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+                int candidate = table[slot];
+                if (candidate < 0) {
+                    table[slot] = node;
+                    break;
+                }
+                size_t candidateStart = keyStarts[candidate];
+                if (keyStarts[candidate + 1] - candidateStart == keyLength &&
+                    std::equal(keys.begin() + keyStart, keys.end(), keys.begin() + candidateStart)) {
+                    node = candidate;
+                    break;
+                }
+            }
+        }
+        if (node == static_cast<int>(nodes.size())) {
+            nodes.emplace_back();
+            keyStarts.push_back(keys.size());
+            for (int i = 0; i < instruction.arity; ++i)
+                ++nodes[keys[keyStart + 2 + i]].uses;
+        }
+        else
+            keys.resize(keyStart);
+        instructionNodes.push_back(node);
+        stack.push_back(node);
+    }
+    if (stack.size() != 1)
+        return optimized;
+
+    // Emit the program again. The code of a stack entry is contiguous and starts at
+    // starts[entry]; when an entry turns out to be a repeated sub-expression, its code is
+    // dropped and replaced by a read of the temporary holding its value.
+    optimized->code.clear();
+    std::vector<size_t> starts;
+    for (size_t i = 0; i < program.code.size(); ++i) {
+        const RpnInstruction& instruction = program.code[i];
+        DagNode& node = nodes[instructionNodes[i]];
+        size_t start = instruction.arity > 0 ? starts[starts.size() - instruction.arity] : optimized->code.size();
+        starts.resize(starts.size() - instruction.arity);
+        starts.push_back(start);
+
+        if (node.temporary >= 0) {
+            optimized->code.resize(start);
+            optimized->code.push_back(RpnInstruction{ RpnInstruction::PUSH_TEMPORARY, 0, node.temporary });
+            continue;
+        }
+        optimized->code.push_back(instruction);
+        if (node.uses > 1 && isApplication(instruction)) {
+            node.temporary = static_cast<int>(optimized->temporaries++);
+            optimized->code.push_back(RpnInstruction{ RpnInstruction::STORE_TEMPORARY, 0, node.temporary });
+        }
+    }
+
+    optimized->nodesSaved = std::count_if(program.code.begin(), program.code.end(), isApplication) -
+        std::count_if(optimized->code.begin(), optimized->code.end(), isApplication);
+    return optimized;
+}
+
+void RpnOptimizer::print(const CompiledProgram& program)
+{
+    for (size_t i = 0; i < program.code.size(); ++i) {
+        const RpnInstruction& instruction = program.code[i];
+        switch (instruction.kind) {
+        case RpnInstruction::PUSH_CONSTANT:
+            std::cout << program.constants[instruction.index].to_literal();
+            break;
+        case RpnInstruction::PUSH_VARIABLE:
+            std::cout << program.variables[instruction.index];
+            break;
+        case RpnInstruction::APPLY_OPERATOR:
+            std::cout << program.operators[instruction.index].name;
+            break;
+        case RpnInstruction::CALL_FUNCTION:
+            std::cout << program.functions[instruction.index].name;
+            if (program.functions[instruction.index].info->num_parameters() == -1 && instruction.arity != -1)
+                std::cout << "/" << instruction.arity;
+            break;
+        case RpnInstruction::STORE_TEMPORARY:
+            std::cout << "=$" << instruction.index;
+            break;
+        case RpnInstruction::PUSH_TEMPORARY:
+            std::cout << "$" << instruction.index;
+            break;
+        }
+        std::cout << (i + 1 < program.code.size() ? " " : "");
+    }
+    std::cout << std::endl;
+}
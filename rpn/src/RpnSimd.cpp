@@ -0,0 +1,221 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <atomic>
+#include <cmath>
+#include "RpnSimd.h"
+#include "RpnSimdKernels.h"
+
+#ifdef RPN_SIMD_X86
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    // Instruction set traits for SSE2, see RpnSimdKernels.h.
+    struct Sse2
+    {
+        typedef __m128d V;
+        static const size_t width = 2;
+
+        static V load(const double* p) { return _mm_loadu_pd(p); }
+        static void store(double* p, V v) { _mm_storeu_pd(p, v); }
+        static V set(double d) { return _mm_set1_pd(d); }
+
+        static V add(V a, V b) { return _mm_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+        static V div(V a, V b) { return _mm_div_pd(a, b); }
+        static V sqrt(V a) { return _mm_sqrt_pd(a); }
+        static V min(V a, V b) { return _mm_min_pd(a, b); }
+        static V max(V a, V b) { return _mm_max_pd(a, b); }
+
+        static V band(V a, V b) { return _mm_and_pd(a, b); }
+        static V bor(V a, V b) { return _mm_or_pd(a, b); }
+        static V bxor(V a, V b) { return _mm_xor_pd(a, b); }
+        static V bandnot(V a, V b) { return _mm_andnot_pd(b, a); }
+
+        static V lt(V a, V b) { return _mm_cmplt_pd(a, b); }
+        static V le(V a, V b) { return _mm_cmple_pd(a, b); }
+        static V eq(V a, V b) { return _mm_cmpeq_pd(a, b); }
+        static bool all(V mask) { return _mm_movemask_pd(mask) == 3; }
+
+        // SSE2 has no rounding instruction: adding and subtracting 2^52 rounds |x| to an
+        // integer, which is then corrected towards minus infinity. |x| >= 2^52 is integral.
+        static V floor(V x)
+        {
+            const V two52 = set(4503599627370496.0);
+            V ax = _mm_andnot_pd(set(-0.0), x);
+            V r = _mm_sub_pd(_mm_add_pd(ax, two52), two52);
+            r = _mm_or_pd(r, _mm_and_pd(x, set(-0.0)));
+            r = _mm_sub_pd(r, _mm_and_pd(_mm_cmpgt_pd(r, x), set(1)));
+            V small = _mm_cmplt_pd(ax, two52);
+            return _mm_or_pd(_mm_and_pd(small, r), _mm_andnot_pd(small, x));
+        }
+
+        static V ceil(V x)
+        {
+            return _mm_xor_pd(floor(_mm_xor_pd(x, set(-0.0))), set(-0.0));
+        }
+
+        // Adding and subtracting 2^52 + 2^51 rounds to the nearest integer.
+        static V round(V x)
+        {
+            const V magic = set(6755399441055744.0);
+            return _mm_sub_pd(_mm_add_pd(x, magic), magic);
+        }
+
+        static V bitMask(V q, int bit)
+        {
+            const V two52 = set(4503599627370496.0);
+            __m128i mask = _mm_set1_epi64x(1LL << bit);
+            __m128i bits = _mm_and_si128(_mm_castpd_si128(_mm_add_pd(q, two52)), mask);
+            // Only the low half of each lane can differ; spread its comparison to the lane.
+            __m128i equal = _mm_cmpeq_epi32(bits, mask);
+            return _mm_castsi128_pd(_mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 2, 0, 0)));
+        }
+
+        // Adding 2^52 + 2^51 to an integral double leaves the integer in the low mantissa bits.
+        static V pow2(V n)
+        {
+            const V magic = set(6755399441055744.0);
+            __m128i bits = _mm_sub_epi64(_mm_castpd_si128(_mm_add_pd(n, magic)), _mm_castpd_si128(magic));
+            return _mm_castsi128_pd(_mm_slli_epi64(_mm_add_epi64(bits, _mm_set1_epi64x(1023)), 52));
+        }
+
+        static V exponent(V x)
+        {
+            const V two52 = set(4503599627370496.0);
+            __m128i field = _mm_srli_epi64(_mm_castpd_si128(x), 52);
+            V biased = _mm_sub_pd(_mm_or_pd(_mm_castsi128_pd(field), two52), two52);
+            return _mm_sub_pd(biased, set(1022));
+        }
+
+        static V mantissa(V x)
+        {
+            const V mask = _mm_castsi128_pd(_mm_set1_epi64x(0x000fffffffffffffLL));
+            return _mm_or_pd(_mm_and_pd(x, mask), set(0.5));
+        }
+    };
+}
+
+const RpnSimd::Kernel rpnSse2Kernels[RpnSimd::FUNCTION_COUNT] = RPN_SIMD_KERNEL_TABLE(Sse2);
+#endif
+
+namespace
+{
+    template <double(*F)(double)>
+    void scalarUnary(const double* x, const double*, size_t count, double* result)
+    {
+        for (size_t i = 0; i < count; ++i)
+            result[i] = F(x[i]);
+    }
+
+    template <double(*F)(double, double)>
+    void scalarBinary(const double* x, const double* y, size_t count, double* result)
+    {
+        for (size_t i = 0; i < count; ++i)
+            result[i] = F(x[i], y[i]);
+    }
+
+    double lg(double x)
+    {
+        return std::log10(x);
+    }
+
+    double logBase(double x, double base)
+    {
+        return std::log(x) / std::log(base);
+    }
+
+    // Reference implementations, the same C library calls the scalar evaluator makes.
+    const RpnSimd::Kernel scalarKernels[RpnSimd::FUNCTION_COUNT] = {
+        scalarUnary< ::sin>, scalarUnary< ::cos>, scalarUnary< ::tan>,
+        scalarUnary< ::asin>, scalarUnary< ::acos>, scalarUnary< ::atan>,
+        scalarUnary< ::log>, scalarUnary<lg>, scalarUnary< ::exp>,
+        scalarUnary< ::sqrt>, scalarUnary< ::fabs>, scalarUnary< ::floor>, scalarUnary< ::ceil>,
+        scalarBinary< ::pow>, scalarBinary<logBase>,
+    };
+
+    RpnSimd::Level detectLevel()
+    {
+#if !defined(RPN_SIMD_X86)
+        return RpnSimd::SCALAR;
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return RpnSimd::SSE2;
+        __cpuid(info, 1);
+        // AVX needs the OS to save the YMM registers (OSXSAVE and XCR0 bits 1 and 2).
+        const int osxsave = 1 << 27, avx = 1 << 28;
+        if ((info[2] & (osxsave | avx)) != (osxsave | avx) || (_xgetbv(0) & 6) != 6)
+            return RpnSimd::SSE2;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) ? RpnSimd::AVX2 : RpnSimd::SSE2;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? RpnSimd::AVX2 : RpnSimd::SSE2;
+#endif
+    }
+
+    std::atomic<int>& currentLevel()
+    {
+        static std::atomic<int> level(RpnSimd::detect());
+        return level;
+    }
+}
+
+RpnSimd::Level RPN_API RpnSimd::detect()
+{
+    static const Level detected = detectLevel();
+    return detected;
+}
+
+RpnSimd::Level RPN_API RpnSimd::level()
+{
+    return static_cast<Level>(currentLevel().load(std::memory_order_relaxed));
+}
+
+void RPN_API RpnSimd::setLevel(Level level)
+{
+    currentLevel().store(level < detect() ? level : detect(), std::memory_order_relaxed);
+}
+
+RpnSimd::Kernel RPN_API RpnSimd::kernel(Function function, Level level)
+{
+    switch (level < detect() ? level : detect()) {
+#ifdef RPN_SIMD_X86
+    case AVX2:
+        return rpnAvx2Kernels[function];
+    case SSE2:
+        return rpnSse2Kernels[function];
+#endif
+    default:
+        return scalarKernels[function];
+    }
+}
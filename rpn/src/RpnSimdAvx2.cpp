@@ -0,0 +1,119 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+// AVX2 kernels of RpnSimd, only called after RpnSimd::detect() found AVX2. GCC and Clang
+// compile the functions defined after the pragma below for AVX2; MSVC emits the AVX2
+// intrinsics without /arch:AVX2, so the rest of the file stays SSE2. Every header with
+// inline functions that other translation units could share, the standard library's in
+// particular, is included before the pragma, so their copies here are not AVX2 code.
+#include <cmath>
+#include <cstddef>
+#include "RpnSimd.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC target("avx2")
+#elif defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#endif
+
+#include "RpnSimdKernels.h"
+
+#ifdef RPN_SIMD_X86
+
+namespace
+{
+    // Instruction set traits for AVX2, see RpnSimdKernels.h.
+    struct Avx2
+    {
+        typedef __m256d V;
+        static const size_t width = 4;
+
+        static V load(const double* p) { return _mm256_loadu_pd(p); }
+        static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+        static V set(double d) { return _mm256_set1_pd(d); }
+
+        static V add(V a, V b) { return _mm256_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+        static V div(V a, V b) { return _mm256_div_pd(a, b); }
+        static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+        static V min(V a, V b) { return _mm256_min_pd(a, b); }
+        static V max(V a, V b) { return _mm256_max_pd(a, b); }
+        static V floor(V a) { return _mm256_floor_pd(a); }
+        static V ceil(V a) { return _mm256_ceil_pd(a); }
+        static V round(V a) { return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+        static V bitMask(V q, int bit)
+        {
+            const V two52 = set(4503599627370496.0);
+            __m256i mask = _mm256_set1_epi64x(1LL << bit);
+            __m256i bits = _mm256_and_si256(_mm256_castpd_si256(_mm256_add_pd(q, two52)), mask);
+            return _mm256_castsi256_pd(_mm256_cmpeq_epi64(bits, mask));
+        }
+
+        static V band(V a, V b) { return _mm256_and_pd(a, b); }
+        static V bor(V a, V b) { return _mm256_or_pd(a, b); }
+        static V bxor(V a, V b) { return _mm256_xor_pd(a, b); }
+        static V bandnot(V a, V b) { return _mm256_andnot_pd(b, a); }
+
+        static V lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static V le(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static V eq(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+        static bool all(V mask) { return _mm256_movemask_pd(mask) == 15; }
+
+        // Adding 2^52 + 2^51 to an integral double leaves the integer in the low mantissa bits.
+        static V pow2(V n)
+        {
+            const V magic = set(6755399441055744.0);
+            __m256i bits = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, magic)), _mm256_castpd_si256(magic));
+            return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52));
+        }
+
+        static V exponent(V x)
+        {
+            const V two52 = set(4503599627370496.0);
+            __m256i field = _mm256_srli_epi64(_mm256_castpd_si256(x), 52);
+            V biased = _mm256_sub_pd(_mm256_or_pd(_mm256_castsi256_pd(field), two52), two52);
+            return _mm256_sub_pd(biased, set(1022));
+        }
+
+        static V mantissa(V x)
+        {
+            const V mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x000fffffffffffffLL));
+            return _mm256_or_pd(_mm256_and_pd(x, mask), set(0.5));
+        }
+    };
+}
+
+const RpnSimd::Kernel rpnAvx2Kernels[RpnSimd::FUNCTION_COUNT] = RPN_SIMD_KERNEL_TABLE(Avx2);
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
@@ -0,0 +1,533 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+// Vectorized math kernels shared by the SSE2 and AVX2 implementations of RpnSimd.
+//
+// Every algorithm is a template over an instruction set traits class S providing:
+//   V                         vector of S::width doubles; comparisons return lane masks in a V
+//   load, store, set          memory access and broadcast
+//   add, sub, mul, div, sqrt, min, max, floor, ceil
+//   round(x)                  x rounded to the nearest integer, for |x| < 2^51
+//   bitMask(q, bit)           lane mask of bit of q, for integral q in [0, 2^51)
+//   band, bor, bxor, bandnot  bitwise operations, bandnot(a, b) = a & ~b
+//   lt, le, gt, eq            lane masks
+//   all, any                  test lane masks
+//   pow2(n)                   2^n for integral n in [-1022, 1023]
+//   exponent(x), mantissa(x)  frexp: x = mantissa * 2^exponent, mantissa in [0.5, 1)
+// This header is included only by the translation units that instantiate the traits, each
+// compiled for its instruction set, so no instantiation is shared between them. For the same
+// reason the kernels call no inline functions of the standard library, such as
+// std::numeric_limits, whose out-of-line copies the linker could pick from either unit.
+// The polynomial approximations and argument reductions follow the Cephes library.
+#include <cmath>
+#include <cstddef>
+#include "RpnSimd.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define RPN_SIMD_X86 1
+#endif
+
+// Kernel tables of the instruction set specific translation units, indexed by RpnSimd::Function.
+extern const RpnSimd::Kernel rpnSse2Kernels[RpnSimd::FUNCTION_COUNT];
+extern const RpnSimd::Kernel rpnAvx2Kernels[RpnSimd::FUNCTION_COUNT];
+
+namespace RpnSimdKernels
+{
+    const double SIGN_BIT = -0.0;
+    const double POSITIVE_INFINITY = HUGE_VAL;
+    const double QUIET_NAN = NAN;
+    const double MIN_NORMAL = 2.2250738585072014E-308;      // 2^-1022
+    const double PIO2 = 1.57079632679489661923;
+    const double PIO4 = 7.85398163397448309616E-1;
+    const double TWO_OVER_PI = 6.36619772367581343076E-1;
+    const double MOREBITS = 6.123233995736765886130E-17;
+    const double TRIG_LIMIT = 1048576.0;            // 2^20, bound of the Cody-Waite reduction
+    // pi/4 = DP1 + DP2 + DP3, with few enough bits in DP1 and DP2 that q * DP1 and q * DP2
+    // are exact for q below 2^21.
+    const double DP1 = 7.85398125648498535156E-1;
+    const double DP2 = 3.77489470793079817668E-8;
+    const double DP3 = 2.69515142907905952645E-15;
+
+    const double SIN_COEFFICIENTS[] = {
+        1.58962301576546568060E-10, -2.50507477628578072866E-8, 2.75573136213857245213E-6,
+        -1.98412698295895385996E-4, 8.33333333332211858878E-3, -1.66666666666666307295E-1,
+    };
+    const double COS_COEFFICIENTS[] = {
+        -1.13585365213876817300E-11, 2.08757008419747316778E-9, -2.75573141792967388112E-7,
+        2.48015872888517045348E-5, -1.38888888888730564116E-3, 4.16666666666665929218E-2,
+    };
+    const double TAN_P[] = {
+        -1.30936939181383777646E4, 1.15351664838587416140E6, -1.79565251976484877988E7,
+    };
+    const double TAN_Q[] = {
+        1.36812963470692954678E4, -1.32089234440210967447E6, 2.50083801823357915839E7, -5.38695755929454629881E7,
+    };
+    const double ATAN_P[] = {
+        -8.750608600031904122785E-1, -1.615753718733365076637E1, -7.500855792314704667340E1,
+        -1.228866684490136173410E2, -6.485021904942025371773E1,
+    };
+    const double ATAN_Q[] = {
+        2.485846490142306297962E1, 1.650270098316988542046E2, 4.328810604912902668951E2,
+        4.853903996359136964868E2, 1.945506571482613964425E2,
+    };
+    const double T3P8 = 2.41421356237309504880;     // tan(3pi/8)
+    const double ASIN_P[] = {
+        4.253011369004428248960E-3, -6.019598008014123785661E-1, 5.444622390564711410273E0,
+        -1.626247967210700244449E1, 1.956261983317594739197E1, -8.198089802484824371615E0,
+    };
+    const double ASIN_Q[] = {
+        -1.474091372988853791896E1, 7.049610280856842141659E1, -1.471791292232726029859E2,
+        1.395105614657485689735E2, -4.918853881490881290097E1,
+    };
+    const double ASIN_R[] = {
+        2.967721961301243206100E-3, -5.634242780008963776856E-1, 6.968710824104713396794E0,
+        -2.556901049652824852289E1, 2.853665548261061424989E1,
+    };
+    const double ASIN_S[] = {
+        -2.194779531642920639778E1, 1.470656354026814941758E2, -3.838770957603691357202E2,
+        3.424398657913078477438E2,
+    };
+    const double EXP_P[] = {
+        1.26177193074810590878E-4, 3.02994407707441961300E-2, 9.99999999999999999910E-1,
+    };
+    const double EXP_Q[] = {
+        3.00198505138664455042E-6, 2.52448340349684104192E-3, 2.27265548208155028766E-1,
+        2.00000000000000000009E0,
+    };
+    const double LOG2E = 1.4426950408889634073599;
+    const double EXP_C1 = 6.93145751953125E-1;      // ln 2 = EXP_C1 + EXP_C2
+    const double EXP_C2 = 1.42860682030941723212E-6;
+    const double MAXLOG = 7.09782712893383996843E2;
+    const double MINLOG = -7.451332191019412076235E2;
+    const double LOG_P[] = {
+        1.01875663804580931796E-4, 4.97494994976747001425E-1, 4.70579119878881725854E0,
+        1.44989225341610930846E1, 1.79368678507819816313E1, 7.70838733755885391666E0,
+    };
+    const double LOG_Q[] = {
+        1.12873587189167450590E1, 4.52279145837532221105E1, 8.29875266912776603211E1,
+        7.11544750618563894466E1, 2.31251620126765340583E1,
+    };
+    const double SQRTH = 0.70710678118654752440;
+    const double LOG_C1 = 0.693359375;              // ln 2 = LOG_C1 - LOG_C2
+    const double LOG_C2 = 2.121944400546905827679E-4;
+    const double L102A = 3.0078125E-1;              // log10(2) = L102A + L102B
+    const double L102B = 2.48745663981195213739E-4;
+    const double L10EA = 4.3359375E-1;              // log10(e) = L10EA + L10EB
+    const double L10EB = 7.00731903251827651129E-4;
+
+    // Evaluates the polynomial c[0]*x^(N-1) + ... + c[N-1].
+    template <class S, size_t N>
+    typename S::V polevl(typename S::V x, const double (&c)[N])
+    {
+        typename S::V r = S::set(c[0]);
+        for (size_t i = 1; i < N; ++i)
+            r = S::add(S::mul(r, x), S::set(c[i]));
+        return r;
+    }
+
+    // Evaluates the polynomial x^N + c[0]*x^(N-1) + ... + c[N-1].
+    template <class S, size_t N>
+    typename S::V p1evl(typename S::V x, const double (&c)[N])
+    {
+        typename S::V r = S::add(x, S::set(c[0]));
+        for (size_t i = 1; i < N; ++i)
+            r = S::add(S::mul(r, x), S::set(c[i]));
+        return r;
+    }
+
+    template <class S>
+    typename S::V abs(typename S::V x)
+    {
+        return S::bandnot(x, S::set(SIGN_BIT));
+    }
+
+    template <class S>
+    typename S::V select(typename S::V mask, typename S::V a, typename S::V b)
+    {
+        return S::bor(S::band(mask, a), S::bandnot(b, mask));
+    }
+
+    // Applies a C library function lane by lane.
+    template <class S>
+    typename S::V mapLanes(typename S::V x, double(*f)(double))
+    {
+        double lanes[S::width];
+        S::store(lanes, x);
+        for (size_t i = 0; i < S::width; ++i)
+            lanes[i] = f(lanes[i]);
+        return S::load(lanes);
+    }
+
+    template <class S>
+    typename S::V mapLanes(typename S::V x, typename S::V y, double(*f)(double, double))
+    {
+        double xs[S::width], ys[S::width];
+        S::store(xs, x);
+        S::store(ys, y);
+        for (size_t i = 0; i < S::width; ++i)
+            xs[i] = f(xs[i], ys[i]);
+        return S::load(xs);
+    }
+
+    // Reduces |x| modulo pi/2: returns z in [-pi/4, pi/4] and the quadrant q such that
+    // |x| = q * pi/2 + z. Exact for |x| <= TRIG_LIMIT.
+    template <class S>
+    typename S::V reduce(typename S::V ax, typename S::V& q)
+    {
+        typedef typename S::V V;
+        q = S::round(S::mul(ax, S::set(TWO_OVER_PI)));
+        V z = S::sub(ax, S::mul(q, S::set(2 * DP1)));
+        z = S::sub(z, S::mul(q, S::set(2 * DP2)));
+        return S::sub(z, S::mul(q, S::set(2 * DP3)));
+    }
+
+    template <class S>
+    typename S::V sinPolynomial(typename S::V z, typename S::V zz)
+    {
+        return S::add(z, S::mul(S::mul(z, zz), polevl<S>(zz, SIN_COEFFICIENTS)));
+    }
+
+    template <class S>
+    typename S::V cosPolynomial(typename S::V zz)
+    {
+        typedef typename S::V V;
+        V r = S::sub(S::set(1), S::mul(zz, S::set(0.5)));
+        return S::add(r, S::mul(S::mul(zz, zz), polevl<S>(zz, COS_COEFFICIENTS)));
+    }
+
+    template <class S>
+    typename S::V sin(typename S::V x)
+    {
+        typedef typename S::V V;
+        V ax = abs<S>(x);
+        if (!S::all(S::le(ax, S::set(TRIG_LIMIT))))
+            return mapLanes<S>(x, ::sin);
+        V q;
+        V z = reduce<S>(ax, q);
+        V zz = S::mul(z, z);
+        // Odd quadrants use the cosine polynomial; quadrants 2 and 3 are negative.
+        V r = select<S>(S::bitMask(q, 0), cosPolynomial<S>(zz), sinPolynomial<S>(z, zz));
+        V sign = S::bxor(S::band(x, S::set(SIGN_BIT)), S::band(S::bitMask(q, 1), S::set(SIGN_BIT)));
+        return S::bxor(r, sign);
+    }
+
+    template <class S>
+    typename S::V cos(typename S::V x)
+    {
+        typedef typename S::V V;
+        V ax = abs<S>(x);
+        if (!S::all(S::le(ax, S::set(TRIG_LIMIT))))
+            return mapLanes<S>(x, ::cos);
+        V q;
+        V z = reduce<S>(ax, q);
+        V zz = S::mul(z, z);
+        // Odd quadrants use the sine polynomial; quadrants 1 and 2 are negative.
+        V odd = S::bitMask(q, 0);
+        V r = select<S>(odd, sinPolynomial<S>(z, zz), cosPolynomial<S>(zz));
+        V negative = S::bxor(odd, S::bitMask(q, 1));
+        return S::bxor(r, S::band(negative, S::set(SIGN_BIT)));
+    }
+
+    template <class S>
+    typename S::V tan(typename S::V x)
+    {
+        typedef typename S::V V;
+        V ax = abs<S>(x);
+        if (!S::all(S::le(ax, S::set(TRIG_LIMIT))))
+            return mapLanes<S>(x, ::tan);
+        V q;
+        V z = reduce<S>(ax, q);
+        V zz = S::mul(z, z);
+        V r = S::div(S::mul(zz, polevl<S>(zz, TAN_P)), p1evl<S>(zz, TAN_Q));
+        r = S::add(z, S::mul(z, r));
+        // In odd quadrants tan(x) = -cot(z).
+        r = select<S>(S::bitMask(q, 0), S::div(S::set(-1), r), r);
+        return S::bxor(r, S::band(x, S::set(SIGN_BIT)));
+    }
+
+    template <class S>
+    typename S::V atan(typename S::V x)
+    {
+        typedef typename S::V V;
+        V ax = abs<S>(x);
+        V big = S::lt(S::set(T3P8), ax);
+        V middle = S::bandnot(S::lt(S::set(0.66), ax), big);
+        V xr = select<S>(big, S::div(S::set(-1), ax),
+            select<S>(middle, S::div(S::sub(ax, S::set(1)), S::add(ax, S::set(1))), ax));
+        V base = S::bor(S::band(big, S::set(PIO2)), S::band(middle, S::set(PIO4)));
+        V more = S::bor(S::band(big, S::set(MOREBITS)), S::band(middle, S::set(0.5 * MOREBITS)));
+        V z = S::mul(xr, xr);
+        z = S::div(S::mul(z, polevl<S>(z, ATAN_P)), p1evl<S>(z, ATAN_Q));
+        z = S::add(S::mul(xr, z), xr);
+        V r = S::add(base, S::add(z, more));
+        return S::bxor(r, S::band(x, S::set(SIGN_BIT)));
+    }
+
+    template <class S>
+    typename S::V asin(typename S::V x)
+    {
+        typedef typename S::V V;
+        V a = abs<S>(x);
+        // Near 1: asin(a) = pi/2 - 2 asin(sqrt((1 - a) / 2)).
+        V zz = S::sub(S::set(1), a);
+        V p = S::div(S::mul(zz, polevl<S>(zz, ASIN_R)), p1evl<S>(zz, ASIN_S));
+        zz = S::sqrt(S::add(zz, zz));
+        V high = S::sub(S::set(PIO4), zz);
+        high = S::sub(high, S::sub(S::mul(zz, p), S::set(MOREBITS)));
+        high = S::add(high, S::set(PIO4));
+        V s = S::mul(a, a);
+        V low = S::div(S::mul(s, polevl<S>(s, ASIN_P)), p1evl<S>(s, ASIN_Q));
+        low = S::add(S::mul(a, low), a);
+        V r = select<S>(S::lt(S::set(0.625), a), high, low);
+        return S::bxor(r, S::band(x, S::set(SIGN_BIT)));
+    }
+
+    template <class S>
+    typename S::V acos(typename S::V x)
+    {
+        typedef typename S::V V;
+        V lower = S::lt(x, S::set(-0.5));
+        V upper = S::lt(S::set(0.5), x);
+        V outer = S::bor(lower, upper);
+        V t = select<S>(outer, S::sqrt(S::mul(S::set(0.5), S::sub(S::set(1), abs<S>(x)))), x);
+        V a = asin<S>(t);
+        V middle = S::add(S::add(S::sub(S::set(PIO4), a), S::set(MOREBITS)), S::set(PIO4));
+        V twice = S::add(a, a);
+        return select<S>(lower, S::sub(S::set(2 * PIO2), twice), select<S>(upper, twice, middle));
+    }
+
+    // exp(hi + lo) for |lo| much smaller than |hi|, without handling of special values.
+    template <class S>
+    typename S::V expCore(typename S::V hi, typename S::V lo)
+    {
+        typedef typename S::V V;
+        V x = S::min(S::max(hi, S::set(MINLOG)), S::set(MAXLOG));
+        V n = S::round(S::mul(x, S::set(LOG2E)));
+        x = S::sub(x, S::mul(n, S::set(EXP_C1)));
+        x = S::sub(x, S::mul(n, S::set(EXP_C2)));
+        x = S::add(x, lo);
+        V xx = S::mul(x, x);
+        V p = S::mul(x, polevl<S>(xx, EXP_P));
+        x = S::div(p, S::sub(polevl<S>(xx, EXP_Q), p));
+        x = S::add(S::set(1), S::add(x, x));
+        // Scale in two steps, so that results down to the smallest subnormal are rounded once.
+        V n1 = S::round(S::mul(n, S::set(0.5)));
+        return S::mul(S::mul(x, S::pow2(n1)), S::pow2(S::sub(n, n1)));
+    }
+
+    // Results of exp for arguments outside [MINLOG, MAXLOG] and NaN.
+    template <class S>
+    typename S::V expSpecial(typename S::V x, typename S::V r)
+    {
+        r = select<S>(S::lt(S::set(MAXLOG), x), S::set(POSITIVE_INFINITY), r);
+        r = select<S>(S::lt(x, S::set(MINLOG)), S::set(0), r);
+        return select<S>(S::eq(x, x), r, x);
+    }
+
+    template <class S>
+    typename S::V exp(typename S::V x)
+    {
+        return expSpecial<S>(x, expCore<S>(x, S::set(0)));
+    }
+
+    // Splits ln(x) for positive finite x: ln(x) = e * ln 2 + ln(1 + m) with m in
+    // [sqrt(1/2) - 1, sqrt(2) - 1), and ln(1 + m) = m - m^2 / 2 + c.
+    template <class S>
+    void logParts(typename S::V x, typename S::V& e, typename S::V& m, typename S::V& c)
+    {
+        typedef typename S::V V;
+        V tiny = S::lt(x, S::set(MIN_NORMAL));
+        x = select<S>(tiny, S::mul(x, S::set(18014398509481984.0)), x);    // 2^54
+        e = S::sub(S::exponent(x), S::band(tiny, S::set(54)));
+        m = S::mantissa(x);
+        V small = S::lt(m, S::set(SQRTH));
+        e = S::sub(e, S::band(small, S::set(1)));
+        m = S::sub(select<S>(small, S::add(m, m), m), S::set(1));
+        c = S::mul(S::mul(m, S::mul(m, m)), S::div(polevl<S>(m, LOG_P), p1evl<S>(m, LOG_Q)));
+    }
+
+    // Results of ln and lg for non-positive, infinite and NaN arguments.
+    template <class S>
+    typename S::V logSpecial(typename S::V x, typename S::V r)
+    {
+        r = select<S>(S::eq(x, S::set(POSITIVE_INFINITY)), x, r);
+        r = select<S>(S::eq(x, S::set(0)), S::set(-POSITIVE_INFINITY), r);
+        r = select<S>(S::lt(x, S::set(0)), S::set(QUIET_NAN), r);
+        return select<S>(S::eq(x, x), r, x);
+    }
+
+    template <class S>
+    typename S::V ln(typename S::V x)
+    {
+        typedef typename S::V V;
+        V e, m, c;
+        logParts<S>(x, e, m, c);
+        V y = S::sub(c, S::mul(S::mul(m, m), S::set(0.5)));
+        y = S::sub(y, S::mul(e, S::set(LOG_C2)));
+        V r = S::add(S::add(m, y), S::mul(e, S::set(LOG_C1)));
+        return logSpecial<S>(x, r);
+    }
+
+    template <class S>
+    typename S::V lg(typename S::V x)
+    {
+        typedef typename S::V V;
+        V e, m, c;
+        logParts<S>(x, e, m, c);
+        V y = S::sub(c, S::mul(S::mul(m, m), S::set(0.5)));
+        V r = S::mul(y, S::set(L10EB));
+        r = S::add(r, S::mul(m, S::set(L10EB)));
+        r = S::add(r, S::mul(e, S::set(L102B)));
+        r = S::add(r, S::mul(y, S::set(L10EA)));
+        r = S::add(r, S::mul(m, S::set(L10EA)));
+        r = S::add(r, S::mul(e, S::set(L102A)));
+        return logSpecial<S>(x, r);
+    }
+
+    template <class S>
+    typename S::V log(typename S::V x, typename S::V base)
+    {
+        return S::div(ln<S>(x), ln<S>(base));
+    }
+
+    // Sum a + b as s + err exactly.
+    template <class S>
+    typename S::V twoSum(typename S::V a, typename S::V b, typename S::V& err)
+    {
+        typedef typename S::V V;
+        V s = S::add(a, b);
+        V bb = S::sub(s, a);
+        err = S::add(S::sub(a, S::sub(s, bb)), S::sub(b, bb));
+        return s;
+    }
+
+    // Product a * b as p + err exactly (Dekker), for |a|, |b| below 2^995.
+    template <class S>
+    typename S::V twoProduct(typename S::V a, typename S::V b, typename S::V& err)
+    {
+        typedef typename S::V V;
+        const V split = S::set(134217729.0);    // 2^27 + 1
+        V p = S::mul(a, b);
+        V ca = S::mul(a, split);
+        V ah = S::sub(ca, S::sub(ca, a));
+        V al = S::sub(a, ah);
+        V cb = S::mul(b, split);
+        V bh = S::sub(cb, S::sub(cb, b));
+        V bl = S::sub(b, bh);
+        err = S::add(S::add(S::add(S::sub(S::mul(ah, bh), p), S::mul(ah, bl)), S::mul(al, bh)), S::mul(al, bl));
+        return p;
+    }
+
+    // pow(x, y) = exp(y ln x), with ln x and the product carried in double-double.
+    template <class S>
+    typename S::V pow(typename S::V x, typename S::V y)
+    {
+        typedef typename S::V V;
+        V fast = S::band(S::lt(S::set(0), x), S::lt(x, S::set(POSITIVE_INFINITY)));
+        fast = S::band(fast, S::lt(abs<S>(y), S::set(1e290)));
+        if (!S::all(fast))
+            return mapLanes<S>(x, y, ::pow);
+
+        // ln x = hi + lo: the quadratic term is split exactly, only the small cubic term
+        // and e * LOG_C2 carry rounding errors.
+        V e, m, c, zl, err1, err2, err3;
+        logParts<S>(x, e, m, c);
+        V zh = twoProduct<S>(m, m, zl);
+        V a = twoSum<S>(m, S::mul(zh, S::set(-0.5)), err1);
+        V b = S::sub(S::sub(c, S::mul(zl, S::set(0.5))), S::mul(e, S::set(LOG_C2)));
+        V low = twoSum<S>(a, b, err2);
+        V hi = twoSum<S>(S::mul(e, S::set(LOG_C1)), low, err3);
+        V lo = S::add(S::add(err1, err2), err3);
+        V perr;
+        V t = twoProduct<S>(y, hi, perr);
+        V tlo = S::add(perr, S::mul(y, lo));
+        return expSpecial<S>(S::add(t, tlo), expCore<S>(t, tlo));
+    }
+
+    // Runs a vector function over arrays, padding the last partial vector.
+    template <class S, typename S::V(*F)(typename S::V)>
+    void unary(const double* x, const double*, size_t count, double* result)
+    {
+        size_t i = 0;
+        for (; i + S::width <= count; i += S::width)
+            S::store(result + i, F(S::load(x + i)));
+        if (i < count) {
+            double lanes[S::width] = {};
+            for (size_t k = 0; i + k < count; ++k)
+                lanes[k] = x[i + k];
+            S::store(lanes, F(S::load(lanes)));
+            for (size_t k = 0; i + k < count; ++k)
+                result[i + k] = lanes[k];
+        }
+    }
+
+    template <class S, typename S::V(*F)(typename S::V, typename S::V)>
+    void binary(const double* x, const double* y, size_t count, double* result)
+    {
+        size_t i = 0;
+        for (; i + S::width <= count; i += S::width)
+            S::store(result + i, F(S::load(x + i), S::load(y + i)));
+        if (i < count) {
+            double xs[S::width] = {}, ys[S::width] = {};
+            for (size_t k = 0; i + k < count; ++k) {
+                xs[k] = x[i + k];
+                ys[k] = y[i + k];
+            }
+            S::store(xs, F(S::load(xs), S::load(ys)));
+            for (size_t k = 0; i + k < count; ++k)
+                result[i + k] = xs[k];
+        }
+    }
+
+    template <class S>
+    typename S::V sqrt(typename S::V x)
+    {
+        return S::sqrt(x);
+    }
+
+    template <class S>
+    typename S::V floor(typename S::V x)
+    {
+        return S::floor(x);
+    }
+
+    template <class S>
+    typename S::V ceil(typename S::V x)
+    {
+        return S::ceil(x);
+    }
+}
+
+// Initializer of the kernel table of traits S, in RpnSimd::Function order.
+#define RPN_SIMD_KERNEL_TABLE(S) { \
+    RpnSimdKernels::unary<S, RpnSimdKernels::sin<S> >, RpnSimdKernels::unary<S, RpnSimdKernels::cos<S> >, \
+    RpnSimdKernels::unary<S, RpnSimdKernels::tan<S> >, RpnSimdKernels::unary<S, RpnSimdKernels::asin<S> >, \
+    RpnSimdKernels::unary<S, RpnSimdKernels::acos<S> >, RpnSimdKernels::unary<S, RpnSimdKernels::atan<S> >, \
+    RpnSimdKernels::unary<S, RpnSimdKernels::ln<S> >, RpnSimdKernels::unary<S, RpnSimdKernels::lg<S> >, \
+    RpnSimdKernels::unary<S, RpnSimdKernels::exp<S> >, RpnSimdKernels::unary<S, RpnSimdKernels::sqrt<S> >, \
+    RpnSimdKernels::unary<S, RpnSimdKernels::abs<S> >, RpnSimdKernels::unary<S, RpnSimdKernels::floor<S> >, \
+    RpnSimdKernels::unary<S, RpnSimdKernels::ceil<S> >, RpnSimdKernels::binary<S, RpnSimdKernels::pow<S> >, \
+    RpnSimdKernels::binary<S, RpnSimdKernels::log<S> > }
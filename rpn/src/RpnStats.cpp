@@ -0,0 +1,109 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "RpnStats.h"
+
+
+namespace
+{
+    void add(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        if (value)
+            counter.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t load(const std::atomic<uint64_t>& counter)
+    {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    // Index of the latency bucket of a duration: the number of significant bits.
+    size_t bucket(uint64_t nanoseconds)
+    {
+        size_t bits = 0;
+        while (nanoseconds && bits + 1 < RPN_LATENCY_BUCKETS) {
+            nanoseconds >>= 1;
+            ++bits;
+        }
+        return bits;
+    }
+}
+
+RpnStatsCounters::RpnStatsCounters() : active(false)
+{
+    reset();
+}
+
+void RpnStatsCounters::enable(bool enabled)
+{
+    active.store(enabled, std::memory_order_relaxed);
+}
+
+void RpnStatsCounters::record(const RpnStatsSample& sample, uint64_t nanoseconds, bool failed)
+{
+    add(expressions, 1);
+    add(errors, failed ? 1 : 0);
+    add(tokenizeNanoseconds, sample.tokenizeNanoseconds);
+    add(parseNanoseconds, sample.parseNanoseconds);
+    add(compileNanoseconds, sample.compileNanoseconds);
+    add(evaluateNanoseconds, sample.evaluateNanoseconds);
+    add(totalNanoseconds, nanoseconds);
+    add(tokens, sample.tokens);
+    add(operatorsApplied, sample.operatorsApplied);
+    add(functionCalls, sample.functionCalls);
+    add(latency[bucket(nanoseconds)], 1);
+
+    uint64_t slowest = load(maxNanoseconds);
+    while (nanoseconds > slowest && !maxNanoseconds.compare_exchange_weak(slowest, nanoseconds, std::memory_order_relaxed))
+        ;
+}
+
+RpnStats RpnStatsCounters::snapshot() const
+{
+    RpnStats stats;
+    stats.expressions = load(expressions);
+    stats.errors = load(errors);
+    stats.tokenizeNanoseconds = load(tokenizeNanoseconds);
+    stats.parseNanoseconds = load(parseNanoseconds);
+    stats.compileNanoseconds = load(compileNanoseconds);
+    stats.evaluateNanoseconds = load(evaluateNanoseconds);
+    stats.totalNanoseconds = load(totalNanoseconds);
+    stats.maxNanoseconds = load(maxNanoseconds);
+    stats.tokens = load(tokens);
+    stats.operatorsApplied = load(operatorsApplied);
+    stats.functionCalls = load(functionCalls);
+    for (size_t i = 0; i < RPN_LATENCY_BUCKETS; ++i)
+        stats.latency[i] = load(latency[i]);
+    return stats;
+}
+
+void RpnStatsCounters::reset()
+{
+    for (Counter* counter : { &expressions, &errors, &tokenizeNanoseconds, &parseNanoseconds, &compileNanoseconds,
+        &evaluateNanoseconds, &totalNanoseconds, &maxNanoseconds, &tokens, &operatorsApplied, &functionCalls })
+        counter->store(0, std::memory_order_relaxed);
+    for (Counter& counter : latency)
+        counter.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,201 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <algorithm>
+#include "RpnThreadPool.h"
+
+namespace
+{
+    // A participant takes this fraction of its remaining share at a time.
+    const size_t CHUNK_DIVISOR = 16;
+}
+
+RpnThreadPool::RpnThreadPool(unsigned workers) : requested(workers), failed(false)
+{
+}
+
+RpnThreadPool::~RpnThreadPool()
+{
+    stop();
+}
+
+void RpnThreadPool::resize(unsigned workers)
+{
+    std::lock_guard<std::mutex> lock(loopMutex);
+    requested = workers;
+}
+
+unsigned RpnThreadPool::size() const
+{
+    unsigned workers = requested;
+    if (workers == 0)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    return workers;
+}
+
+void RpnThreadPool::start()
+{
+    participants = size();
+    shares.reset(new Share[participants]);
+    for (unsigned i = 1; i < participants; ++i)
+        threads.emplace_back(&RpnThreadPool::run, this, i, generation);
+}
+
+void RpnThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+    stopping = false;
+}
+
+void RpnThreadPool::run(unsigned self, size_t seen)
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    for (;;) {
+        wake.wait(lock, [&]() { return stopping || generation != seen; });
+        if (stopping)
+            return;
+        seen = generation;
+        lock.unlock();
+        work(self);
+        lock.lock();
+        if (--busy == 0)
+            done.notify_one();
+    }
+}
+
+void RpnThreadPool::parallel_for(size_t count, const std::function<void(size_t, size_t)>& body)
+{
+    std::lock_guard<std::mutex> loopLock(loopMutex);
+    if (!shares || participants != size()) {
+        stop();
+        start();
+    }
+    if (participants == 1 || count < 2) {
+        if (count)
+            body(0, count);
+        return;
+    }
+
+    for (unsigned i = 0; i < participants; ++i) {
+        std::lock_guard<std::mutex> lock(shares[i].mutex);
+        shares[i].begin = count * i / participants;
+        shares[i].end = count * (i + 1) / participants;
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        current = &body;
+        failed = false;
+        busy = participants - 1;
+        ++generation;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    std::exception_ptr thrown;
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        done.wait(lock, [&]() { return busy == 0; });
+        current = nullptr;
+        std::swap(thrown, error);
+    }
+    if (thrown)
+        std::rethrow_exception(thrown);
+}
+
+void RpnThreadPool::work(unsigned self)
+{
+    size_t begin, end;
+    while (!failed) {
+        if (!take(self, begin, end)) {
+            if (!steal(self))
+                return;
+            continue;
+        }
+        try {
+            (*current)(begin, end);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (!error)
+                error = std::current_exception();
+            failed = true;
+        }
+    }
+}
+
+bool RpnThreadPool::take(unsigned self, size_t& begin, size_t& end)
+{
+    Share& share = shares[self];
+    std::lock_guard<std::mutex> lock(share.mutex);
+    size_t remaining = share.end - share.begin;
+    if (remaining == 0)
+        return false;
+    begin = share.begin;
+    end = begin + std::max<size_t>(1, remaining / CHUNK_DIVISOR);
+    share.begin = end;
+    return true;
+}
+
+bool RpnThreadPool::steal(unsigned self)
+{
+    for (;;) {
+        // The share with most work left loses its back half.
+        unsigned victim = self;
+        size_t largest = 0;
+        for (unsigned i = 0; i < participants; ++i) {
+            std::lock_guard<std::mutex> lock(shares[i].mutex);
+            size_t remaining = shares[i].end - shares[i].begin;
+            if (remaining > largest) {
+                largest = remaining;
+                victim = i;
+            }
+        }
+        if (largest == 0)
+            return false;
+
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> lock(shares[victim].mutex);
+            size_t remaining = shares[victim].end - shares[victim].begin;
+            if (remaining == 0)
+                continue;   // taken meanwhile, look again
+            end = shares[victim].end;
+            begin = shares[victim].begin + remaining / 2;
+            shares[victim].end = begin;
+        }
+        std::lock_guard<std::mutex> lock(shares[self].mutex);
+        shares[self].begin = begin;
+        shares[self].end = end;
+        return true;
+    }
+}
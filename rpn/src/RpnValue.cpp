@@ -0,0 +1,133 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <cctype>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include "RpnValue.h"
+#include "RpnDef.h"
+#include "Numeric.h"
+
+
+long double RPN_API RpnValue::parse_float() const
+{
+    return Numeric::str_to_ld(s);
+}
+
+std::string RPN_API RpnValue::to_string() const
+{
+    return to_string(RpnFormat());
+}
+
+std::string RPN_API RpnValue::to_string(const RpnFormat& format) const
+{
+    switch (kind) {
+    case FLOAT:
+        return format.format(f);
+    case INTEGER:
+    {
+        if (!arithmetic || format.exactIntegers)
+            return std::to_string(i);
+        std::string text;
+        format.appendInteger(i, text);
+        return text;
+    }
+    default:
+        return s;
+    }
+}
+
+std::string RPN_API RpnValue::to_literal() const
+{
+    if (kind == INTEGER)
+        return std::to_string(i);
+    if (kind != FLOAT)
+        return s;
+    char literal[64];
+    std::snprintf(literal, sizeof(literal), "%.*Lg", std::numeric_limits<long double>::max_digits10, f);
+    return literal;
+}
+
+RpnValue RPN_API RpnValue::from_literal(const std::string& token)
+{
+    if (Numeric::isString(token))
+        return String(token);
+    return from_literal(token.data(), token.data() + token.size());
+}
+
+RpnValue RPN_API RpnValue::from_literal(const char* begin, const char* end)
+{
+    Numeric::Literal literal;
+    if (!Numeric::parse(begin, end, literal))
+        throw std::runtime_error("Invalid numeric literal: " + std::string(begin, end));
+    return literal.integral ? Integer(literal.integer) : Float(literal.value);
+}
+
+static RpnValue from_argument(const std::string& arg)
+{
+    Numeric::Literal literal;
+    if (!Numeric::parse(arg.data(), arg.data() + arg.size(), literal))
+        return RpnValue::String(arg);
+    return literal.integral ? RpnValue::Integer(literal.integer) : RpnValue::Float(literal.value);
+}
+
+std::string ITypedOperatorInfo::calculate(const std::vector<std::string>& args)
+{
+    // String operands come top of stack first, typed operands in source order.
+    std::vector<RpnValue> operands;
+    for (auto it = args.rbegin(); it != args.rend(); ++it)
+        operands.push_back(from_argument(*it));
+    RpnValue result;
+    calculate(operands.data(), result);
+    return result.to_string();
+}
+
+std::string ITypedFunctionInfo::calculate(const std::vector<std::string>& args)
+{
+    std::vector<RpnValue> params;
+    for (const std::string& arg : args)
+        params.push_back(from_argument(arg));
+    RpnValue result;
+    calculate(params.data(), static_cast<int>(params.size()), result);
+    return result.to_string();
+}
+
+void StringOperatorAdapter::calculate(const RpnValue* args, RpnValue& result)
+{
+    // The string interface receives the operands top of stack first.
+    std::vector<std::string> operands;
+    for (int i = target->num_parameters(); i > 0; --i)
+        operands.push_back(args[i - 1].to_literal());
+    result = RpnValue::String(target->calculate(operands));
+}
+
+void StringFunctionAdapter::calculate(const RpnValue* args, int count, RpnValue& result)
+{
+    std::vector<std::string> params;
+    for (int i = 0; i < count; ++i)
+        params.push_back(args[i].to_literal());
+    result = RpnValue::String(target->calculate(params));
+}
@@ -0,0 +1,311 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include "RpnVm.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RPN_VM_THREADED
+#endif
+
+
+namespace
+{
+    // Registers of one run. The constants are copied in; small files live on the native stack.
+    class RegisterFile
+    {
+        static const size_t INLINE_COUNT = 16;
+
+        typename std::aligned_storage<sizeof(RpnValue), alignof(RpnValue)>::type inlineStorage[INLINE_COUNT];
+        std::unique_ptr<RpnValue[]> heapStorage;
+        RpnValue* registers;
+        size_t count;
+
+    public:
+        RegisterFile(const RpnBytecodeProgram& bytecode, const std::vector<RpnValue>& constants) : count(bytecode.registerCount)
+        {
+            if (count > INLINE_COUNT) {
+                heapStorage.reset(new RpnValue[count]);
+                registers = heapStorage.get();
+                std::copy(constants.begin(), constants.end(), registers);
+                return;
+            }
+            registers = reinterpret_cast<RpnValue*>(inlineStorage);
+            size_t i = 0;
+            for (; i < constants.size(); ++i)
+                new (registers + i) RpnValue(constants[i]);
+            for (; i < count; ++i)
+                new (registers + i) RpnValue();
+        }
+
+        ~RegisterFile()
+        {
+            if (!heapStorage) {
+                for (size_t i = 0; i < count; ++i)
+                    registers[i].~RpnValue();
+            }
+        }
+
+        RegisterFile(const RegisterFile&) = delete;
+        RegisterFile& operator=(const RegisterFile&) = delete;
+
+        RpnValue* data()
+        {
+            return registers;
+        }
+    };
+
+    // Copies a value, without touching the string member for numbers.
+    inline void assign(RpnValue& target, const RpnValue& source)
+    {
+        if (source.kind == RpnValue::FLOAT)
+            target.set_float(source.f);
+        else if (source.kind == RpnValue::INTEGER)
+            target.set_integer(source.i, source.arithmetic);
+        else
+            target = source;
+    }
+}
+
+std::shared_ptr<const RpnBytecodeProgram> RPN_API RpnVm::compile(const CompiledProgram& program)
+{
+    std::shared_ptr<RpnBytecodeProgram> bytecode = std::make_shared<RpnBytecodeProgram>();
+    size_t variableBase = program.constants.size();
+    size_t temporaryBase = variableBase + program.variables.size();
+    size_t stackBase = temporaryBase + program.temporaries;
+    size_t registerCount = stackBase + program.maxDepth;
+    if (registerCount > 65536 || program.operators.size() > 65536 || program.functions.size() > 65536)
+        return nullptr;
+    bytecode->registerCount = registerCount;
+    bytecode->variableBase = variableBase;
+
+    auto emit = [&](RpnBytecode::Opcode opcode, size_t target, size_t a, size_t b) {
+        bytecode->code.push_back(RpnBytecode{ opcode, static_cast<uint16_t>(target), static_cast<uint16_t>(a), static_cast<uint16_t>(b) });
+    };
+
+    // Register holding each stack entry and temporary. Results of operations are written
+    // to the register of their stack position.
+    std::vector<size_t> stack;
+    std::vector<size_t> temporaries(program.temporaries);
+
+    for (const RpnInstruction& instruction : program.code) {
+        switch (instruction.kind) {
+        case RpnInstruction::PUSH_CONSTANT:
+            stack.push_back(instruction.index);
+            continue;
+
+        case RpnInstruction::PUSH_VARIABLE:
+            stack.push_back(variableBase + instruction.index);
+            continue;
+
+        case RpnInstruction::PUSH_TEMPORARY:
+            stack.push_back(temporaries[instruction.index]);
+            continue;
+
+        case RpnInstruction::STORE_TEMPORARY:
+            if (stack.empty())
+                return nullptr;
+            // Stack registers are reused, so values are copied out of them.
+            if (stack.back() >= stackBase) {
+                temporaries[instruction.index] = temporaryBase + instruction.index;
+                emit(RpnBytecode::MOVE, temporaries[instruction.index], stack.back(), 0);
+            }
+            else
+                temporaries[instruction.index] = stack.back();
+            continue;
+
+        default:
+            break;
+        }
+
+        if (instruction.arity < 0 || stack.size() < static_cast<size_t>(instruction.arity))
+            return nullptr;
+        size_t base = stack.size() - instruction.arity;
+        size_t target = stackBase + base;
+        bool isOperator = instruction.kind == RpnInstruction::APPLY_OPERATOR;
+        RpnNativeOperation operation = isOperator ? program.operators[instruction.index].info->native()
+            : program.functions[instruction.index].info->native();
+
+        if (instruction.arity == 2 && operation.kind >= RpnNativeOperation::ADD && operation.kind <= RpnNativeOperation::DIVIDE) {
+            RpnBytecode::Opcode opcode = static_cast<RpnBytecode::Opcode>(RpnBytecode::ADD + (operation.kind - RpnNativeOperation::ADD));
+            emit(opcode, target, stack[base], stack[base + 1]);
+        }
+        else {
+            // Operators and functions take their operands from consecutive registers.
+            // A stack entry is either in its own register or outside the stack registers,
+            // so the moves do not overwrite operands still to be moved.
+            for (size_t i = base; i < stack.size(); ++i) {
+                if (stack[i] != stackBase + i)
+                    emit(RpnBytecode::MOVE, stackBase + i, stack[i], 0);
+            }
+            emit(isOperator ? RpnBytecode::APPLY_OPERATOR : RpnBytecode::CALL_FUNCTION, target, instruction.index, instruction.arity);
+        }
+        stack.resize(base);
+        stack.push_back(target);
+    }
+
+    if (stack.size() != 1)
+        return nullptr;
+    emit(RpnBytecode::RETURN, 0, stack.back(), 0);
+    return bytecode;
+}
+
+RpnValue RPN_API RpnVm::run(const CompiledProgram& program, const long double* values)
+{
+    const RpnBytecodeProgram& bytecode = *program.bytecode;
+    RegisterFile registers(bytecode, program.constants);
+    RpnValue* r = registers.data();
+    for (size_t i = 0; i < program.variables.size(); ++i)
+        r[bytecode.variableBase + i].set_float(values[i]);
+
+    const RpnBytecode* ip = bytecode.code.data();
+    RpnValue result;
+
+    // Every handler ends with VM_NEXT. With threaded dispatch the switch is entered once and
+    // each handler jumps straight to the next one, which gives the branch predictor one
+    // indirect jump per handler instead of a single shared one.
+#ifdef RPN_VM_THREADED
+    static void* const labels[] = { &&label_MOVE, &&label_ADD, &&label_SUBTRACT, &&label_MULTIPLY,
+        &&label_DIVIDE, &&label_APPLY_OPERATOR, &&label_CALL_FUNCTION, &&label_RETURN };
+    static_assert(sizeof(labels) / sizeof(labels[0]) == RpnBytecode::OPCODE_COUNT, "Every opcode needs a label");
+#define VM_CASE(opcode) case RpnBytecode::opcode: label_##opcode:
+#define VM_NEXT() ++ip; goto *labels[ip->opcode]
+#else
+#define VM_CASE(opcode) case RpnBytecode::opcode:
+#define VM_NEXT() ++ip; continue
+#endif
+
+    for (;;) {
+        switch (ip->opcode) {
+        VM_CASE(MOVE)
+            assign(r[ip->target], r[ip->a]);
+            VM_NEXT();
+
+        VM_CASE(ADD)
+            RpnValue::add(r[ip->a], r[ip->b], r[ip->target]);
+            VM_NEXT();
+
+        VM_CASE(SUBTRACT)
+            RpnValue::subtract(r[ip->a], r[ip->b], r[ip->target]);
+            VM_NEXT();
+
+        VM_CASE(MULTIPLY)
+            RpnValue::multiply(r[ip->a], r[ip->b], r[ip->target]);
+            VM_NEXT();
+
+        VM_CASE(DIVIDE)
+            r[ip->target].set_float(r[ip->a].as_float() / r[ip->b].as_float());
+            VM_NEXT();
+
+        VM_CASE(APPLY_OPERATOR)
+            program.operators[ip->a].info->calculate(r + ip->target, result);
+            assign(r[ip->target], result);
+            VM_NEXT();
+
+        VM_CASE(CALL_FUNCTION)
+            program.functions[ip->a].info->calculate(r + ip->target, ip->b, result);
+            assign(r[ip->target], result);
+            VM_NEXT();
+
+        VM_CASE(RETURN)
+            return std::move(r[ip->a]);
+
+        default:
+            throw std::runtime_error("Invalid expression");
+        }
+    }
+#undef VM_CASE
+#undef VM_NEXT
+}
+
+RpnValue RPN_API RpnVm::interpret(const CompiledProgram& program, const long double* values)
+{
+    std::vector<RpnValue> stack;
+    stack.reserve(program.maxDepth);
+    std::vector<RpnValue> temporaries(program.temporaries);
+    RpnValue result;
+
+    for (const RpnInstruction& instruction : program.code) {
+        switch (instruction.kind) {
+        case RpnInstruction::PUSH_CONSTANT:
+            stack.push_back(program.constants[instruction.index]);
+            break;
+
+        case RpnInstruction::PUSH_VARIABLE:
+            stack.push_back(RpnValue::Float(values[instruction.index]));
+            break;
+
+        case RpnInstruction::APPLY_OPERATOR:
+        {
+            const CompiledProgram::OperatorEntry& op = program.operators[instruction.index];
+            size_t arity = static_cast<size_t>(instruction.arity);
+            if (stack.size() < arity)
+                throw std::runtime_error("Invalid expression");
+            size_t base = stack.size() - arity;
+            op.info->calculate(stack.data() + base, result);
+            stack.resize(base);
+            stack.push_back(std::move(result));
+            break;
+        }
+
+        case RpnInstruction::CALL_FUNCTION:
+        {
+            const CompiledProgram::FunctionEntry& function = program.functions[instruction.index];
+            size_t arity;
+            if (instruction.arity == -1) {
+                if (stack.empty())
+                    throw std::runtime_error("Not enough parameters for function " + function.name);
+                arity = static_cast<size_t>(stack.back().as_integer());
+                stack.pop_back();
+            }
+            else
+                arity = static_cast<size_t>(instruction.arity);
+            if (stack.size() < arity)
+                throw std::runtime_error("Not enough parameters for function " + function.name);
+            // Functions receive their parameters in source order.
+            size_t base = stack.size() - arity;
+            function.info->calculate(stack.data() + base, static_cast<int>(arity), result);
+            stack.resize(base);
+            stack.push_back(std::move(result));
+            break;
+        }
+
+        case RpnInstruction::STORE_TEMPORARY:
+            temporaries[instruction.index] = stack.back();
+            break;
+
+        case RpnInstruction::PUSH_TEMPORARY:
+            stack.push_back(temporaries[instruction.index]);
+            break;
+        }
+    }
+
+    if (stack.size() != 1)
+        throw std::runtime_error("Invalid expression");
+    return std::move(stack.back());
+}